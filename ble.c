@@ -36,12 +36,14 @@
 #include <stdbool.h>
 #include <string.h>
 
-#include "src/shared/mainloop.h"
 #include "gdbus.h"
 #include "bleClient.h"
+#include "bleMetrics.h"
+#include "bleTrace.h"
+#include "bleProbes.h"
 
 // Forward declarations.
-static void bleState (int event);
+static void bleState (bluez_client_t *client, int event);
 
 // States for establishing communication with remote BLE device.
 enum {
@@ -56,6 +58,19 @@ enum {
     STATE_ROCK_N_ROLL
 };
 
+// Names of the above states, as exported by the metrics socket.
+static const char *const stateNames[] = {
+    "init",
+    "controller_off",
+    "controller_on",
+    "scan",
+    "scan_stopped",
+    "connecting",
+    "connected",
+    "acquire_notify",
+    "rock_n_roll"
+};
+
 // Events passed into bleState()
 enum {
     CLIENT_READY = 1,
@@ -68,37 +83,30 @@ enum {
     DEVICE_DISCONNECTED
 };
 
-DBusConnection *dbus_conn;
-static GMainLoop *mainLoop;
-
-extern GDBusProxy   adapter,
-                    device;
-        
-
-void quit(void)
+// Application state, one per client.  Reached from the client callbacks
+// through bluez_client_get_user_data().
+struct ble_app
 {
-    if (!mainLoop)
-            return;
-
-    g_main_loop_quit(mainLoop);
-}
+    int currentState;
+    int called;
+};
 
 // Notification received, do something productive with it.  This is what all
 // the other support code is meant to achieve.
-static void notification(int value)
+static void notification(bluez_client_t *client, int value)
 {
-    static int called = 0;
-    static uint32_t led[] = {0xFF000080, 0x00FF0080, 0x0000FF80}; // Red, green blue
+    struct ble_app *app = bluez_client_get_user_data(client);
+    static const uint32_t led[] = {0xFF000080, 0x00FF0080, 0x0000FF80}; // Red, green blue
     
-    fprintf(stderr, "Notification: %d\n", value);
+    BLE_TRACE(TRACE_DEBUG, "notification", NULL, value, app->called);
     
     if (0 == value)
-        bluez_write_attribute(led[called/2]);
+        bluez_write_attribute(client, led[app->called/2]);
 
-    if (++called < 6)
+    if (++app->called < 6)
         return;
     fprintf(stderr, "Exiting program.\n");
-    quit();
+    bluez_client_quit(client);
 }
 
 // This function is called only from the following interfaces:
@@ -107,68 +115,83 @@ static void notification(int value)
 //  Device1                  /org/bluez/hci0/dev_00_A0_50_3E_47_9D (RSSI, Connected, ServicesResolved)
 //  GattCharacteristic1      /org/bluez/hci0/dev_00_A0_50_3E_47_9D/service0011/service000c/char000d (NotifyAcquired)
 //
-static void propertyChanged(const char *interface, const char *name, int value)
+static void propertyChanged(bluez_client_t *client, const char *interface,
+                            const char *name, const struct bluez_property_value *old,
+                            const struct bluez_property_value *value)
 {
-    gboolean yes = (TRUE == value);
+    gboolean yes = (DBUS_TYPE_BOOLEAN == value->type && value->value.bool_val);
     
-    fprintf(stderr, "propertyChanged(): on interface %s: %s%s\n", interface,
-        name, (-1 == value) ? "" : ((TRUE == value) ? ": yes" : ": no"));
+    // Property names are unique across the three interfaces, so the name
+    // alone identifies the event.  Only real changes get here.
+    BLE_TRACE(TRACE_DEBUG, "propertyChanged", name, value->type, yes);
 
     if (!strcmp(interface, "org.bluez.Device1"))
     {
         // If Bluez daemon is telling us it has resolved our remote BLE
         // device's services,  we can now successfully enable notifications.
         if (!strcmp(name, "ServicesResolved")  &&  yes)
-                bleState(DEVICE_READY);
+                bleState(client, DEVICE_READY);
 
-        // Scan has detected the remote BLE device's advertisement
-        if (!strcmp(name, "RSSI"))
-            bleState(DEVICE_DETECTED);
+        // Scan has detected the remote BLE device's advertisement.  RSSI
+        // is invalidated when the device goes out of range.
+        if (!strcmp(name, "RSSI") && DBUS_TYPE_INVALID != value->type)
+            bleState(client, DEVICE_DETECTED);
         
         // Device has disconnected.
         if (!strcmp(name, "Connected") &&  !yes)
-            bleState(DEVICE_DISCONNECTED);
+            bleState(client, DEVICE_DISCONNECTED);
     }
     else if (!strcmp(interface, "org.bluez.Adapter1"))
     {
         // Controller is just powered on, move to scanning state.
         if (!strcmp(name, "Powered")  && yes)
-            bleState(POWER_ON);
+            bleState(client, POWER_ON);
 
         // Device found and scanning now stopped.  Move to connecting state.
         // Change state when "Discovering" changes to "no"
         else if (!strcmp(name, "Discovering") && !yes)
-            bleState(SCAN_STOPPED);
+            bleState(client, SCAN_STOPPED);
     }
     else if (!strcmp(interface, "org.bluez.GattCharacteristic1"))
     {
         // Controller is just powered on, move to scanning state.
         if (!strcmp(name, "NotifyAcquired")  && yes)
-            bleState(NOTIFY_ACQUIRED);
+            bleState(client, NOTIFY_ACQUIRED);
     }
 }
 
-static void client_ready(GDBusClient *client, void *user_data)
+static void client_ready(bluez_client_t *client)
 {
     // Controller proxy is initialized.  Start the process to establish
     // communication with the external BLE device.
-    bleState(CLIENT_READY);
+    bleState(client, CLIENT_READY);
 }
 
 // State machine to step through the procedure to establish a connection
 // with our desired BLE device and to receive notifications from it.
-static void bleState(int event)
+static void bleStateMachine(bluez_client_t *client, int event)
 {
-    static int currentState = STATE_INIT;
-    DBusMessageIter iter;
-    dbus_bool_t yes;
+    struct ble_app *app = bluez_client_get_user_data(client);
+    gboolean yes;
     
     while (1)
     {
         if (DEVICE_DISCONNECTED == event)
-            currentState = STATE_CONTROLLER_ON;
+        {
+            app->currentState = STATE_CONTROLLER_ON;
+            bluez_metrics_inc(METRIC_RECONNECTS);
+            event = 0;
+        }
 
-        switch (currentState)
+        // Adapter powered on again after being restarted, by the
+        // notification watchdog for one.  Start over.
+        if (POWER_ON == event && app->currentState > STATE_CONTROLLER_OFF)
+        {
+            app->currentState = STATE_CONTROLLER_OFF;
+            event = 0;
+        }
+
+        switch (app->currentState)
         {
             // No idea what state we're in.
             case STATE_INIT:
@@ -176,7 +199,7 @@ static void bleState(int event)
                 if (event != CLIENT_READY)
                     return;
 
-                currentState = STATE_CONTROLLER_OFF;
+                app->currentState = STATE_CONTROLLER_OFF;
 
                 // Back through the loop to the next state...
                 break;
@@ -184,19 +207,20 @@ static void bleState(int event)
             // Assume we are starting from scratch, so first query the
             // controller to see if it is powered up.
             case STATE_CONTROLLER_OFF:
-                if (bluez_read_property_boolean(&adapter, "Powered", &yes) != 0)
+                if (bluez_read_property_boolean(bluez_client_get_proxy(client, BLUEZ_PROXY_ADAPTER),
+                                                "Powered", &yes) != 0)
                     return;
 
                 // Controller is off, power it up now.
                 if (!yes)
                 {
-                    bluez_power_on();
+                    bluez_power_on(client);
                     return;
                 }
 
                 // Controller is up, next step is to discover the
                 // remote BLE device.
-                currentState = STATE_CONTROLLER_ON;
+                app->currentState = STATE_CONTROLLER_ON;
 
                 // Back through the loop to the next state...
                 break;
@@ -206,18 +230,19 @@ static void bleState(int event)
                 // running this program.  Check to see if it is connected.
                 // If our BLE device is not in the database, this function call
                 // returns non-zero and sets 'yes' to FALSE.
-                bluez_read_property_boolean(&device, "Connected", &yes);
+                bluez_read_property_boolean(bluez_client_get_proxy(client, BLUEZ_PROXY_DEVICE),
+                                                "Connected", &yes);
 
                 // Our BLE device is either not connected, or it is not in the Bluez
                 // daemon's database.  Either way, start scanning.
                 if (!yes)
                 {
-                    currentState = STATE_SCAN;
-                    bluez_scan(TRUE);
+                    app->currentState = STATE_SCAN;
+                    bluez_scan(client, TRUE);
                     return;
                 }
 
-                currentState = STATE_CONNECTED;
+                app->currentState = STATE_CONNECTED;
 
                 // Back through the loop to the next state...
                 break;
@@ -227,8 +252,8 @@ static void bleState(int event)
                 if (event != DEVICE_DETECTED)
                     return;
 
-                bluez_scan(FALSE); // this should probably be queued for the main loop to do...  check out g_idle_add()
-                currentState = STATE_SCAN_STOPPED;
+                bluez_scan(client, FALSE); // this should probably be queued for the main loop to do...  check out g_idle_add()
+                app->currentState = STATE_SCAN_STOPPED;
 
                 // Exit until propertyChanged() detects that discovery is
                 // stopped.
@@ -239,9 +264,9 @@ static void bleState(int event)
                 if (event != SCAN_STOPPED)
                     return;
 
-                fprintf(stderr, "Attempting to connect...\n");
-                if (TRUE == bluez_connect())
-                    currentState = STATE_CONNECTING;
+                BLE_TRACE(TRACE_INFO, "connect", NULL, 0, 0);
+                if (TRUE == bluez_connect(client))
+                    app->currentState = STATE_CONNECTING;
 
                 return;
 
@@ -249,20 +274,20 @@ static void bleState(int event)
                 if (event != DEVICE_READY)
                     return;
 
-                currentState = STATE_CONNECTED;
+                app->currentState = STATE_CONNECTED;
 
                 // Back through the loop to the next state...
                 break;
 
             case STATE_CONNECTED:
-                bluez_acquire_notify(notification);
+                bluez_acquire_notify(client, notification);
                 
-                currentState = STATE_ACQUIRE_NOTIFY;
+                app->currentState = STATE_ACQUIRE_NOTIFY;
                 return;
 
             case STATE_ACQUIRE_NOTIFY:
                 if (NOTIFY_ACQUIRED == event)
-                    currentState = STATE_ROCK_N_ROLL;
+                    app->currentState = STATE_ROCK_N_ROLL;
                 return;
 
             default:
@@ -271,33 +296,72 @@ static void bleState(int event)
     }
 }
 
+// Every state machine event passes through here, so time spent in each
+// state can be accounted for.
+static void bleState(bluez_client_t *client, int event)
+{
+    struct ble_app *app = bluez_client_get_user_data(client);
+    int oldState = app->currentState;
+
+    bleStateMachine(client, event);
+
+    if (app->currentState != oldState)
+        BLE_PROBE3(state_transition, oldState, app->currentState, event);
+
+    bluez_metrics_state(app->currentState);
+}
+
 int main(void)
 {
-    mainLoop = g_main_loop_new(NULL, FALSE);
-        
-    dbus_conn = g_dbus_setup_bus(DBUS_BUS_SYSTEM, NULL, NULL);
+    struct ble_app app = { .currentState = STATE_INIT };
+    struct bluez_metrics_server *metrics = NULL;
+    bluez_client_t *client;
+
+    // NULL binds the client to the default main context; additional
+    // clients on other threads would each be given a context of their own.
+    client = bluez_client_new(NULL, &app);
+
+    if (bluez_client_init(client, DBUS_BUS_SYSTEM, BLUEZ_SERVICE, BLUEZ_PATH,
+                          client_ready) == FALSE)
+    {
+        fprintf(stderr, "Unable to connect to the system bus.\n");
+        bluez_client_free(client);
+        return 1;
+    }
+
+    bluez_set_property_change_fn(client, propertyChanged);
+
+    // Hot-path events go to the flight recorder rather than stderr.  Send
+    // SIGUSR1 to dump it.
+    bluez_trace_install(NULL, STDERR_FILENO);
 
-    bluez_client_init(dbus_conn, BLUEZ_SERVICE, BLUEZ_PATH, client_ready);
+    // One line of JSON timing each step of startup, written when the first
+    // notification arrives.
+    bluez_set_startup_report(client, STDERR_FILENO);
 
-    bluez_set_property_change_fn(propertyChanged);
+    // Recover if notifications stop without the device disconnecting.
+    // Defaults throughout: the expected gap is learnt from the traffic.
+    static const struct bluez_watchdog watchdog = { 0 };
+    bluez_set_watchdog(client, &watchdog);
+
+    // Export metrics if a socket path is given, for example
+    // BLE_METRICS_SOCKET=/run/ble/metrics.sock
+    bluez_metrics_set_state_names(stateNames, G_N_ELEMENTS(stateNames));
+    bluez_metrics_state(app.currentState);
+    if (getenv("BLE_METRICS_SOCKET") != NULL)
+        metrics = bluez_metrics_serve(NULL, getenv("BLE_METRICS_SOCKET"));
 
     // Program does not return from this call until the main loop exits
-    // due to a call to g_main_loop_quit().
-    g_main_loop_run(mainLoop);
-
-    g_main_loop_unref(mainLoop);
-    mainLoop = NULL;
-
-    // Shut down notification input pipe, disconnect from DBus watches, and
-    // cancel and free any DBus messaging in progress.
-    bluez_client_exit();
-
-    // After calls into the BlueZ "helper libraries" the reference count on
-    // the DBus connection to the system bus is hopelessly unbalanced,
-    // finishing with 5 or 6 left over.  This doesn't seem to do any long term
-    // harm to the system, however, since after exiting the program and
-    // restarting the reference count does not accumulate.
-    dbus_connection_unref(dbus_conn);
+    // due to a call to bluez_client_quit().
+    bluez_client_run(client);
+
+    // Shut down notification input pipe, disconnect from DBus watches,
+    // cancel and free any DBus messaging in progress, and close the
+    // client's private connection to the system bus.
+    bluez_client_exit(client);
+    bluez_client_free(client);
+
+    bluez_metrics_server_free(metrics);
 
     return 0;
 }
@@ -0,0 +1,360 @@
+//
+// bleAggregate.c
+//
+// Created  10/18/2026
+//
+// Sliding window statistics, see bleAggregate.h.  Each source has a ring
+// of its values in arrival order.  Alongside it:
+//
+//    - two monotonic deques, whose fronts are the window's min and max.
+//      A value is pushed once and popped at most once from each.
+//    - the mean and sum of squared deviations, updated with Welford's
+//      method as values enter and inverted as they leave.
+//    - a fixed-bin histogram, read for percentiles only when a summary
+//      is made.
+//
+// Values leave the window when they are older than the window length, or
+// when the ring is full.  Everything runs on the client's thread.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleDecode.h"
+#include "bleAggregate.h"
+
+// Largest number of records one payload can decode into, for int8 fields
+// in a maximum-length attribute value.
+#define AGGREGATE_MAX_RECORDS 512
+
+struct agg_deque
+{
+    uint64_t *seq;
+    double *value;
+    size_t head;
+    size_t count;
+};
+
+struct agg_series
+{
+    int source;
+
+    gint64 *time;
+    double *value;
+    size_t head;
+    size_t count;
+    uint64_t nextSeq;           // sequence number of the next value
+
+    struct agg_deque min;
+    struct agg_deque max;
+
+    double mean;
+    double m2;
+
+    uint32_t *bins;
+};
+
+struct bluez_aggregate
+{
+    bluez_client_t *client;
+    struct bluez_aggregate_config config;
+    SummaryCallback cb;
+    void *user_data;
+
+    GHashTable *series;         // source to series
+    GSource *timer;
+
+    float scratch[BLUEZ_DECODE_MAX_FIELDS][AGGREGATE_MAX_RECORDS];
+};
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Series.
+
+static struct agg_series *series_new(struct bluez_aggregate *agg, int source)
+{
+    struct agg_series *s = g_new0(struct agg_series, 1);
+    size_t cap = agg->config.capacity;
+
+    s->source = source;
+    s->time = g_new(gint64, cap);
+    s->value = g_new(double, cap);
+    s->min.seq = g_new(uint64_t, cap);
+    s->min.value = g_new(double, cap);
+    s->max.seq = g_new(uint64_t, cap);
+    s->max.value = g_new(double, cap);
+    s->bins = g_new0(uint32_t, agg->config.bins);
+
+    return s;
+}
+
+static void series_free(gpointer data)
+{
+    struct agg_series *s = data;
+
+    g_free(s->time);
+    g_free(s->value);
+    g_free(s->min.seq);
+    g_free(s->min.value);
+    g_free(s->max.seq);
+    g_free(s->max.value);
+    g_free(s->bins);
+    g_free(s);
+}
+
+static int bin_of(const struct bluez_aggregate_config *config, double v)
+{
+    double x = (v - config->lo) * config->bins / (config->hi - config->lo);
+
+    // Clamped before the cast, which is undefined outside int's range.
+    // NaN fails both comparisons in CLAMP and would come through.
+    if (x != x)
+        return 0;
+
+    return (int)CLAMP(x, 0, config->bins - 1);
+}
+
+// Pushes onto the back of a deque, first popping every value that can no
+// longer be the extreme: those not below 'v' for the min deque ('less'),
+// those not above it for the max deque.
+static void deque_push(struct agg_deque *d, size_t cap, uint64_t seq, double v, gboolean less)
+{
+    size_t back;
+
+    while (d->count > 0)
+    {
+        back = (d->head + d->count - 1) % cap;
+        if (less ? d->value[back] < v : d->value[back] > v)
+            break;
+        d->count--;
+    }
+
+    back = (d->head + d->count) % cap;
+    d->seq[back] = seq;
+    d->value[back] = v;
+    d->count++;
+}
+
+static void deque_expire(struct agg_deque *d, size_t cap, uint64_t seq)
+{
+    if (d->count > 0 && d->seq[d->head] == seq)
+    {
+        d->head = (d->head + 1) % cap;
+        d->count--;
+    }
+}
+
+static void series_evict(struct bluez_aggregate *agg, struct agg_series *s)
+{
+    size_t cap = agg->config.capacity;
+    uint64_t seq = s->nextSeq - s->count;
+    double v = s->value[s->head], d;
+
+    s->head = (s->head + 1) % cap;
+    s->count--;
+
+    if (s->count == 0)
+        s->mean = s->m2 = 0;
+    else
+    {
+        d = v - s->mean;
+        s->mean -= d / s->count;
+        s->m2 = MAX(s->m2 - d * (v - s->mean), 0);
+    }
+
+    deque_expire(&s->min, cap, seq);
+    deque_expire(&s->max, cap, seq);
+    s->bins[bin_of(&agg->config, v)]--;
+}
+
+static void series_expire(struct bluez_aggregate *agg, struct agg_series *s, gint64 now)
+{
+    gint64 oldest = now - (gint64)agg->config.window * 1000;
+
+    while (s->count > 0 && s->time[s->head] < oldest)
+        series_evict(agg, s);
+}
+
+static void series_push(struct bluez_aggregate *agg, struct agg_series *s, gint64 t, double v)
+{
+    size_t cap = agg->config.capacity;
+    uint64_t seq;
+    double d;
+
+    if (s->count == cap)
+        series_evict(agg, s);
+
+    seq = s->nextSeq++;
+    s->time[(s->head + s->count) % cap] = t;
+    s->value[(s->head + s->count) % cap] = v;
+    s->count++;
+
+    d = v - s->mean;
+    s->mean += d / s->count;
+    s->m2 += d * (v - s->mean);
+
+    deque_push(&s->min, cap, seq, v, TRUE);
+    deque_push(&s->max, cap, seq, v, FALSE);
+    s->bins[bin_of(&agg->config, v)]++;
+}
+
+// Midpoint of the bin holding the 'q' quantile.
+static double series_quantile(const struct bluez_aggregate *agg, const struct agg_series *s,
+                              double q)
+{
+    const struct bluez_aggregate_config *config = &agg->config;
+    double width = (config->hi - config->lo) / config->bins;
+    size_t rank = (size_t)(q * (s->count - 1)), seen = 0;
+    int i;
+
+    for (i = 0; i < config->bins - 1; i++)
+    {
+        seen += s->bins[i];
+        if (seen > rank)
+            break;
+    }
+
+    return config->lo + (i + 0.5) * width;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Sink and timer.
+
+static void aggregate_sample(bluez_client_t *client, const struct bluez_sample *sample,
+                             void *user_data)
+{
+    struct bluez_aggregate *agg = user_data;
+    struct agg_series *s;
+    struct bluez_soa soa;
+    size_t i, n;
+
+    if (sample->len == 0)
+        return;
+
+    s = g_hash_table_lookup(agg->series, GINT_TO_POINTER(sample->source));
+    if (s == NULL)
+    {
+        s = series_new(agg, sample->source);
+        g_hash_table_insert(agg->series, GINT_TO_POINTER(sample->source), s);
+    }
+
+    if (agg->config.decoder == NULL)
+    {
+        series_push(agg, s, sample->timestamp, sample->data[0]);
+        return;
+    }
+
+    memset(&soa, 0, sizeof(soa));
+    for (i = 0; i < BLUEZ_DECODE_MAX_FIELDS; i++)
+        soa.field[i] = agg->scratch[i];
+    soa.capacity = AGGREGATE_MAX_RECORDS;
+
+    n = bluez_decode(agg->config.decoder, sample->data, sample->len, &soa);
+    for (i = 0; i < n; i++)
+        series_push(agg, s, sample->timestamp, agg->scratch[agg->config.field][i]);
+}
+
+static gboolean aggregate_emit(gpointer user_data)
+{
+    struct bluez_aggregate *agg = user_data;
+    struct bluez_summary summary;
+    struct agg_series *s;
+    GHashTableIter iter;
+    gpointer value;
+    gint64 now = g_get_monotonic_time();
+
+    g_hash_table_iter_init(&iter, agg->series);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+    {
+        s = value;
+        series_expire(agg, s, now);
+
+        if (s->count == 0)
+            continue;
+
+        summary.source = s->source;
+        summary.timestamp = now;
+        summary.count = s->count;
+        summary.min = s->min.value[s->min.head];
+        summary.max = s->max.value[s->max.head];
+        summary.mean = s->mean;
+        summary.variance = s->count > 1 ? s->m2 / (s->count - 1) : 0;
+        summary.p50 = series_quantile(agg, s, 0.50);
+        summary.p90 = series_quantile(agg, s, 0.90);
+        summary.p99 = series_quantile(agg, s, 0.99);
+
+        agg->cb(agg->client, &summary, agg->user_data);
+    }
+
+    return TRUE;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Public interface.
+
+// Starts aggregating the client's samples.  NULL selects a 10 second
+// window summarized every second, of up to 4096 values per source, with
+// percentiles over [0, 256), which suits the first byte of a payload.
+struct bluez_aggregate *bluez_aggregate_new(bluez_client_t *client,
+                                            const struct bluez_aggregate_config *config,
+                                            SummaryCallback cb, void *user_data)
+{
+    static const struct bluez_aggregate_config defaults = {
+        .window = 10000, .period = 1000, .capacity = 4096,
+        .lo = 0, .hi = 256, .bins = 256
+    };
+    struct bluez_aggregate *agg;
+
+    if (client == NULL || cb == NULL)
+        return NULL;
+
+    if (config == NULL)
+        config = &defaults;
+
+    if (config->window < 1 || config->period < 1 || config->capacity < 1 ||
+        config->bins < 1 || config->hi <= config->lo ||
+        (config->decoder != NULL &&
+         (config->field < 0 || config->field >= config->decoder->schema.fields)))
+    {
+        fprintf(stderr, "Invalid aggregation settings\n");
+        return NULL;
+    }
+
+    agg = g_new0(struct bluez_aggregate, 1);
+    agg->client = client;
+    agg->config = *config;
+    agg->cb = cb;
+    agg->user_data = user_data;
+    agg->series = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, series_free);
+
+    if (bluez_add_sample_sink(client, aggregate_sample, agg) == FALSE)
+    {
+        fprintf(stderr, "No sample sink left for aggregation\n");
+        g_hash_table_destroy(agg->series);
+        g_free(agg);
+        return NULL;
+    }
+
+    agg->timer = g_timeout_source_new(config->period);
+    g_source_set_callback(agg->timer, aggregate_emit, agg, NULL);
+    g_source_attach(agg->timer, bluez_client_get_context(client));
+
+    return agg;
+}
+
+void bluez_aggregate_free(struct bluez_aggregate *agg)
+{
+    if (agg == NULL)
+        return;
+
+    bluez_remove_sample_sink(agg->client, aggregate_sample, agg);
+
+    g_source_destroy(agg->timer);
+    g_source_unref(agg->timer);
+
+    g_hash_table_destroy(agg->series);
+    g_free(agg);
+}
@@ -0,0 +1,59 @@
+//
+// bleAggregate.h
+//
+// Created  10/18/2026
+//
+// Rolling statistics over notification and polled values.  An aggregator
+// attaches to a client as a sample sink, keeps a sliding time window of
+// values per source, and hands a summary of each window to a callback at
+// a fixed period: count, min, max, mean, variance and percentiles.  Each
+// value costs O(1) to add and to expire.  Include after bleClient.h.
+
+#ifndef BLE_AGGREGATE_H
+#define BLE_AGGREGATE_H
+
+#include <stddef.h>
+
+struct bluez_aggregate;
+struct bluez_decoder;
+
+// Where values come from, and how long they are kept.  Without a decoder,
+// each payload gives one value, its first byte.  With one, each record
+// gives one value, its field 'field'.  Percentiles come from a histogram
+// of 'bins' equal bins over [lo, hi); values outside it count in the
+// first or last bin.
+struct bluez_aggregate_config
+{
+    int window;                 // ms
+    int period;                 // ms between summaries
+    size_t capacity;            // most values held per window and source
+    double lo;
+    double hi;
+    int bins;
+    const struct bluez_decoder *decoder;
+    int field;
+};
+
+struct bluez_summary
+{
+    int source;                 // as in struct bluez_sample
+    gint64 timestamp;           // g_get_monotonic_time() at the end of the window
+    size_t count;
+    double min;
+    double max;
+    double mean;
+    double variance;
+    double p50;
+    double p90;
+    double p99;
+};
+
+typedef void (* SummaryCallback) (bluez_client_t *client, const struct bluez_summary *summary,
+                                  void *user_data);
+
+void                        bluez_aggregate_free    (struct bluez_aggregate *agg);
+struct bluez_aggregate *    bluez_aggregate_new     (bluez_client_t *client,
+                                                     const struct bluez_aggregate_config *config,
+                                                     SummaryCallback cb, void *user_data);
+
+#endif // BLE_AGGREGATE_H
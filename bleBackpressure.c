@@ -0,0 +1,459 @@
+//
+// bleBackpressure.c
+//
+// Created  10/18/2026
+//
+// Bounded buffering of notifications between the AcquireNotify socket and
+// the application.  Without it, notifications are delivered as they are
+// read, so a slow callback leaves them queued in the socket until
+// bluetoothd starts dropping them, uncounted.  With it, the socket is
+// drained into a ring as soon as it is readable, and a separate source
+// delivers from the ring in batches.  When the ring is full, the policy
+// decides what gives:
+//
+//    BLUEZ_BP_DROP_OLDEST   the oldest buffered notification is dropped
+//    BLUEZ_BP_DROP_NEWEST   the notification just read is dropped
+//    BLUEZ_BP_BLOCK         the socket is not read again until the buffer
+//                           has drained to the low watermark.  On the
+//                           io_uring backend, notifications received
+//                           before the receive is cancelled are parked,
+//                           not dropped.
+//    BLUEZ_BP_SPILL         notifications are appended to an unlinked file
+//                           and read back in order as the ring drains
+//
+// The watermark callback is called when the number buffered, in the ring
+// and spilled, reaches the high watermark, and again when it falls back
+// to the low one.  Every notification read is counted exactly once as
+// delivered, dropped or still buffered.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleClientPrivate.h"
+#include "bleMetrics.h"
+
+// Largest notification buffered, the maximum length of an attribute value.
+#define BP_ENTRY_MAX    512
+
+// Notifications delivered per dispatch of the drain source, so that reads
+// from the socket are not held off for long.
+#define BP_DRAIN_BATCH  32
+
+struct bp_entry
+{
+    gint64 timestamp;
+    uint16_t len;
+    uint8_t data[BP_ENTRY_MAX];
+};
+
+// Spilled notifications are stored as this header followed by the data.
+struct bp_spill_header
+{
+    gint64 timestamp;
+    uint32_t len;
+};
+
+// Notification received after reading stopped, still in its io_uring
+// receive buffer.
+struct bp_parked
+{
+    gint64 timestamp;
+    const uint8_t *data;
+    size_t len;
+};
+
+struct bp_source
+{
+    GSource source;
+    struct notify_buffer *buffer;
+};
+
+struct notify_buffer
+{
+    bluez_client_t *client;
+    struct bluez_backpressure config;
+    WatermarkCallback watermark;
+    void *user_data;
+
+    struct bp_entry *ring;
+    size_t head;
+    size_t count;
+    gboolean high;              // high watermark reached, low not yet
+    GSource *drain;
+
+    int spillFd;
+    off_t spillRead;
+    off_t spillWrite;
+    size_t spillCount;
+
+    // Receives completed under BLUEZ_BP_BLOCK after the io_uring receive
+    // was cancelled, oldest first from 'parkedHead'.
+    struct bp_parked *parked;
+    size_t parkedHead;
+    size_t parkedCount;
+    size_t parkedSize;
+
+    struct bluez_backpressure_stats stats;
+};
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Ring and spill file.
+
+static size_t buffered(const struct notify_buffer *b)
+{
+    return b->count + b->spillCount + b->parkedCount;
+}
+
+static void ring_put(struct notify_buffer *b, gint64 timestamp, const uint8_t *data, size_t len)
+{
+    struct bp_entry *e = &b->ring[(b->head + b->count) % b->config.capacity];
+
+    e->timestamp = timestamp;
+    e->len = len;
+    memcpy(e->data, data, len);
+    b->count++;
+}
+
+static void ring_drop_oldest(struct notify_buffer *b)
+{
+    b->head = (b->head + 1) % b->config.capacity;
+    b->count--;
+    b->stats.droppedOldest++;
+    bluez_metrics_inc(METRIC_NOTIFY_DROPPED);
+}
+
+static gboolean spill_open(struct notify_buffer *b)
+{
+    char *path;
+
+    if (b->spillFd >= 0)
+        return TRUE;
+
+    path = g_build_filename(b->config.spillDir ? b->config.spillDir : g_get_tmp_dir(),
+                            "ble-spill-XXXXXX", NULL);
+    b->spillFd = mkstemp(path);
+    if (b->spillFd < 0)
+        fprintf(stderr, "Unable to create spill file %s: %s\n", path, strerror(errno));
+    else
+        unlink(path);
+
+    g_free(path);
+
+    return b->spillFd >= 0;
+}
+
+static gboolean spill_write(struct notify_buffer *b, gint64 timestamp, const uint8_t *data,
+                            size_t len)
+{
+    struct bp_spill_header header = { timestamp, len };
+    struct iovec iov[2] = {
+        { &header, sizeof(header) },
+        { (void *)data, len }
+    };
+
+    if ((size_t)b->spillWrite + sizeof(header) + len > b->config.spillMax ||
+        spill_open(b) == FALSE)
+        return FALSE;
+
+    if (pwritev(b->spillFd, iov, 2, b->spillWrite) != (ssize_t)(sizeof(header) + len))
+        return FALSE;
+
+    b->spillWrite += sizeof(header) + len;
+    b->spillCount++;
+    b->stats.spilled++;
+
+    return TRUE;
+}
+
+// Moves spilled notifications back into the ring while it has room.
+static void spill_refill(struct notify_buffer *b)
+{
+    struct bp_spill_header header;
+    uint8_t data[BP_ENTRY_MAX];
+
+    while (b->spillCount > 0 && b->count < b->config.capacity)
+    {
+        if (pread(b->spillFd, &header, sizeof(header), b->spillRead) != sizeof(header) ||
+            header.len > BP_ENTRY_MAX ||
+            pread(b->spillFd, data, header.len,
+                  b->spillRead + sizeof(header)) != (ssize_t)header.len)
+        {
+            // The file is unreadable, so whatever is left in it is lost.
+            fprintf(stderr, "Spill file read failed, %zu notifications lost\n", b->spillCount);
+            b->stats.spillDropped += b->spillCount;
+            bluez_metrics_add(METRIC_NOTIFY_DROPPED, b->spillCount);
+            b->spillCount = 0;
+            break;
+        }
+
+        b->spillRead += sizeof(header) + header.len;
+        b->spillCount--;
+        ring_put(b, header.timestamp, data, header.len);
+    }
+
+    if (b->spillCount == 0 && b->spillWrite > 0)
+    {
+        if (ftruncate(b->spillFd, 0) < 0)
+            fprintf(stderr, "Unable to truncate spill file: %s\n", strerror(errno));
+        b->spillRead = b->spillWrite = 0;
+    }
+}
+
+// Moves parked notifications into the ring while it has room, handing
+// their buffers back to io_uring.
+static void park_refill(struct notify_buffer *b)
+{
+    struct bp_parked *p;
+
+    while (b->parkedCount > 0 && b->count < b->config.capacity)
+    {
+        p = &b->parked[b->parkedHead++];
+        ring_put(b, p->timestamp, p->data, MIN(p->len, BP_ENTRY_MAX));
+        uring_release_buffer(b->client->uring, p->data);
+        b->parkedCount--;
+    }
+
+    if (b->parkedCount == 0)
+        b->parkedHead = 0;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Watermarks and delivery.
+
+static void check_watermarks(struct notify_buffer *b)
+{
+    size_t n = buffered(b);
+
+    if (b->high == FALSE && n >= b->config.high)
+    {
+        b->high = TRUE;
+        if (b->watermark != NULL)
+            b->watermark(b->client, TRUE, n, b->user_data);
+    }
+    else if (b->high == TRUE && n <= b->config.low)
+    {
+        b->high = FALSE;
+        if (b->watermark != NULL)
+            b->watermark(b->client, FALSE, n, b->user_data);
+    }
+}
+
+static gboolean drain_dispatch(GSource *source, GSourceFunc callback, gpointer user_data)
+{
+    struct notify_buffer *b = ((struct bp_source *)source)->buffer;
+    struct bp_entry *e;
+    int i;
+
+    for (i = 0; i < BP_DRAIN_BATCH && b->count > 0; i++)
+    {
+        // Delivered in place.  Nothing is pushed while a callback runs,
+        // since reads happen on this thread too.
+        e = &b->ring[b->head];
+        bluez_deliver_sample(b->client, BLUEZ_SOURCE_NOTIFY, e->timestamp, e->data, e->len);
+
+        b->head = (b->head + 1) % b->config.capacity;
+        b->count--;
+        b->stats.delivered++;
+    }
+
+    spill_refill(b);
+    park_refill(b);
+    check_watermarks(b);
+
+    if (buffered(b) <= b->config.low)
+        notify_io_resume(b->client);
+
+    if (b->count == 0)
+        g_source_set_ready_time(source, -1);
+
+    return TRUE;
+}
+
+static GSourceFuncs drain_source_funcs = {
+    .dispatch = drain_dispatch
+};
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Interface to the notification pipe.
+
+// TRUE if the pipe should not be read for now.  The caller stops watching
+// it until notify_io_resume().
+gboolean notify_buffer_blocked(bluez_client_t *client)
+{
+    struct notify_buffer *b = client->notifyBuffer;
+
+    if (b->config.policy != BLUEZ_BP_BLOCK || b->count < b->config.capacity)
+        return FALSE;
+
+    b->stats.pauses++;
+    return TRUE;
+}
+
+// Buffers one notification read from the pipe.
+void notify_buffer_push(bluez_client_t *client, gint64 timestamp, const uint8_t *data, size_t len)
+{
+    struct notify_buffer *b = client->notifyBuffer;
+
+    b->stats.received++;
+    len = MIN(len, BP_ENTRY_MAX);
+
+    switch (b->config.policy)
+    {
+        case BLUEZ_BP_DROP_OLDEST:
+            if (b->count == b->config.capacity)
+                ring_drop_oldest(b);
+            ring_put(b, timestamp, data, len);
+            break;
+
+        case BLUEZ_BP_SPILL:
+            // Once anything is spilled, everything after it goes to the
+            // file too, so that order is kept.
+            if (b->count < b->config.capacity && b->spillCount == 0)
+                ring_put(b, timestamp, data, len);
+            else if (spill_write(b, timestamp, data, len) == FALSE)
+            {
+                b->stats.spillDropped++;
+                bluez_metrics_inc(METRIC_NOTIFY_DROPPED);
+            }
+            break;
+
+        default:
+            // BLUEZ_BP_BLOCK reads only while there is room, so this drops
+            // only for BLUEZ_BP_DROP_NEWEST.
+            if (b->count < b->config.capacity)
+                ring_put(b, timestamp, data, len);
+            else
+            {
+                b->stats.droppedNewest++;
+                bluez_metrics_inc(METRIC_NOTIFY_DROPPED);
+            }
+            break;
+    }
+
+    check_watermarks(b);
+    g_source_set_ready_time(b->drain, 0);
+}
+
+// Keeps a notification completed by the io_uring receive after it was
+// cancelled under BLUEZ_BP_BLOCK, until there is room in the ring.  It
+// stays in its receive buffer meanwhile, so at most as many are parked
+// as io_uring has buffers, and none are dropped.
+void notify_buffer_park(bluez_client_t *client, gint64 timestamp, const uint8_t *data, size_t len)
+{
+    struct notify_buffer *b = client->notifyBuffer;
+    struct bp_parked *p;
+
+    b->stats.received++;
+
+    if (b->parkedHead + b->parkedCount == b->parkedSize)
+    {
+        b->parkedSize = MAX(b->parkedSize * 2, 16);
+        b->parked = g_renew(struct bp_parked, b->parked, b->parkedSize);
+    }
+
+    p = &b->parked[b->parkedHead + b->parkedCount++];
+    p->timestamp = timestamp;
+    p->data = data;
+    p->len = len;
+    uring_hold_buffer(client->uring);
+
+    check_watermarks(b);
+}
+
+void notify_buffer_free(bluez_client_t *client)
+{
+    struct notify_buffer *b = client->notifyBuffer;
+
+    if (b == NULL)
+        return;
+
+    for (; b->parkedCount > 0; b->parkedCount--)
+        uring_release_buffer(client->uring, b->parked[b->parkedHead++].data);
+    g_free(b->parked);
+
+    g_source_destroy(b->drain);
+    g_source_unref(b->drain);
+
+    if (b->spillFd >= 0)
+        close(b->spillFd);
+
+    g_free(b->ring);
+    g_free(b);
+    client->notifyBuffer = NULL;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Public interface.
+
+// Buffers notifications as described at the top of this file.  NULL
+// turns buffering off, dropping anything still buffered, and notifications
+// are then delivered as they are read.  'high' defaults to 3/4 of the
+// capacity when zero, and 'low' to 1/4 when it is not below 'high'.
+// Returns FALSE if the settings are invalid.  Not to be called from the
+// notification callback or a sample sink.
+gboolean bluez_set_backpressure(bluez_client_t *client, const struct bluez_backpressure *config,
+                                WatermarkCallback watermark, void *user_data)
+{
+    struct notify_buffer *b;
+
+    notify_buffer_free(client);
+    notify_io_resume(client);
+
+    if (config == NULL)
+        return TRUE;
+
+    if (config->policy < BLUEZ_BP_DROP_OLDEST || config->policy > BLUEZ_BP_SPILL ||
+        config->capacity < 1)
+        return FALSE;
+
+    b = g_new0(struct notify_buffer, 1);
+    b->client = client;
+    b->config = *config;
+    b->watermark = watermark;
+    b->user_data = user_data;
+    b->spillFd = -1;
+
+    if (b->config.high == 0 || b->config.high > b->config.capacity)
+        b->config.high = MAX(b->config.capacity * 3 / 4, 1);
+    if (b->config.low >= b->config.high)
+        b->config.low = b->config.high / 3;
+    if (b->config.policy == BLUEZ_BP_SPILL && b->config.spillMax == 0)
+        b->config.spillMax = 64 * 1024 * 1024;
+
+    b->ring = g_try_new(struct bp_entry, b->config.capacity);
+    if (b->ring == NULL)
+    {
+        g_free(b);
+        return FALSE;
+    }
+
+    b->drain = g_source_new(&drain_source_funcs, sizeof(struct bp_source));
+    ((struct bp_source *)b->drain)->buffer = b;
+    g_source_attach(b->drain, client->context);
+
+    client->notifyBuffer = b;
+
+    return TRUE;
+}
+
+// Copies the buffer's counters.  All zero while buffering is off.
+void bluez_get_backpressure_stats(bluez_client_t *client, struct bluez_backpressure_stats *stats)
+{
+    struct notify_buffer *b = client->notifyBuffer;
+
+    memset(stats, 0, sizeof(*stats));
+    if (b == NULL)
+        return;
+
+    *stats = b->stats;
+    stats->buffered = buffered(b);
+}
@@ -0,0 +1,274 @@
+//
+// bleBench.c
+//
+// Created  10/18/2026
+//
+// End-to-end benchmark of the client against bleMock.  Goes through the
+// same flow as the example program (power on, scan, connect, acquire
+// notify) on the session bus, then measures the following:
+//
+//    - time from start to the first notification
+//    - sustained notifications per second, once notifications are flowing
+//    - write round-trip latency, one WriteValue at a time while
+//      notifications keep arriving
+//
+// Normally run through "make bench", which starts a private bus with
+// dbus-run-session and starts the mock on it.
+//
+// Usage:
+//    bleBench [-t measurement seconds] [-w writes]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+
+// Gives up if the mock has not delivered a notification by then.
+#define BENCH_STARTUP_TIMEOUT   30
+
+enum {
+    BENCH_INIT = 0,
+    BENCH_POWERING,
+    BENCH_SCAN,
+    BENCH_SCAN_STOPPING,
+    BENCH_CONNECTING,
+    BENCH_ACQUIRING,
+    BENCH_RUNNING,
+    BENCH_DONE
+};
+
+struct bench
+{
+    int state;
+    int seconds;
+    int writes;
+
+    gint64 start;
+    gint64 firstNotification;
+    gint64 windowStart;
+    uint64_t notifications;
+    uint64_t windowNotifications;
+
+    gint64 writeStart;
+    gint64 *writeRtt;
+    int writesDone;
+    int writeErrors;
+};
+
+static void bench_scan(bluez_client_t *client)
+{
+    struct bench *bench = bluez_client_get_user_data(client);
+
+    bench->state = BENCH_SCAN;
+    bluez_scan(client, TRUE);
+}
+
+static void write_next(bluez_client_t *client);
+
+static void write_done(bluez_client_t *client, int status, const uint8_t *data,
+                       size_t len, void *user_data)
+{
+    struct bench *bench = user_data;
+
+    if (status < 0)
+        bench->writeErrors++;
+    else
+        bench->writeRtt[bench->writesDone++] = g_get_monotonic_time() - bench->writeStart;
+
+    write_next(client);
+}
+
+static void write_next(bluez_client_t *client)
+{
+    struct bench *bench = bluez_client_get_user_data(client);
+    static const uint8_t value[4] = { 0xFF, 0x00, 0x00, 0x80 };
+
+    if (bench->writesDone + bench->writeErrors >= bench->writes)
+        return;
+
+    bench->writeStart = g_get_monotonic_time();
+    if (bluez_submit_write(client, BLUEZ_PROXY_CHARACTERISTIC_WR, value, sizeof(value),
+                           write_done, bench) == FALSE)
+        bench->writeErrors++;
+}
+
+static void notification(bluez_client_t *client, int value)
+{
+    struct bench *bench = bluez_client_get_user_data(client);
+
+    bench->notifications++;
+
+    if (0 == bench->firstNotification)
+    {
+        bench->firstNotification = g_get_monotonic_time();
+        bench->windowStart = bench->firstNotification;
+        bench->state = BENCH_RUNNING;
+        write_next(client);
+        return;
+    }
+
+    bench->windowNotifications++;
+}
+
+static void property_changed(bluez_client_t *client, const char *interface,
+                             const char *name, const struct bluez_property_value *old,
+                             const struct bluez_property_value *value)
+{
+    struct bench *bench = bluez_client_get_user_data(client);
+    gboolean yes = (DBUS_TYPE_BOOLEAN == value->type && value->value.bool_val);
+
+    if (BENCH_POWERING == bench->state && !strcmp(name, "Powered") && yes)
+        bench_scan(client);
+    else if (BENCH_SCAN == bench->state && !strcmp(name, "RSSI") &&
+             value->type != DBUS_TYPE_INVALID)
+    {
+        bench->state = BENCH_SCAN_STOPPING;
+        bluez_scan(client, FALSE);
+    }
+    else if (BENCH_SCAN_STOPPING == bench->state && !strcmp(name, "Discovering") && !yes)
+    {
+        if (bluez_connect(client) == TRUE)
+            bench->state = BENCH_CONNECTING;
+    }
+    else if (BENCH_CONNECTING == bench->state && !strcmp(name, "ServicesResolved") && yes)
+    {
+        bench->state = BENCH_ACQUIRING;
+        bluez_acquire_notify(client, notification);
+    }
+    else if (!strcmp(name, "Connected") && !yes && bench->state != BENCH_DONE)
+    {
+        // Disconnect injected by the mock, go round again.
+        bench_scan(client);
+    }
+}
+
+static void client_ready(bluez_client_t *client)
+{
+    struct bench *bench = bluez_client_get_user_data(client);
+    gboolean yes = FALSE;
+
+    bluez_read_property_boolean(bluez_client_get_proxy(client, BLUEZ_PROXY_ADAPTER),
+                                "Powered", &yes);
+
+    if (yes)
+        bench_scan(client);
+    else
+    {
+        bench->state = BENCH_POWERING;
+        bluez_power_on(client);
+    }
+}
+
+// Stops the run once the measurement window is over and the writes are
+// done, or when startup takes too long.
+static gboolean bench_check(gpointer user_data)
+{
+    bluez_client_t *client = user_data;
+    struct bench *bench = bluez_client_get_user_data(client);
+    gint64 now = g_get_monotonic_time();
+
+    if (0 == bench->firstNotification)
+    {
+        if (now - bench->start < BENCH_STARTUP_TIMEOUT * G_USEC_PER_SEC)
+            return TRUE;
+
+        fprintf(stderr, "bleBench: no notification after %d s\n", BENCH_STARTUP_TIMEOUT);
+    }
+    else if (now - bench->windowStart < bench->seconds * G_USEC_PER_SEC ||
+             bench->writesDone + bench->writeErrors < bench->writes)
+        return TRUE;
+
+    bench->state = BENCH_DONE;
+    bluez_client_quit(client);
+
+    return FALSE;
+}
+
+static int compare_rtt(const void *a, const void *b)
+{
+    gint64 x = *(const gint64 *)a, y = *(const gint64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void report(struct bench *bench, gint64 end)
+{
+    double window = (end - bench->windowStart) / 1e6;
+    int n = bench->writesDone;
+
+    printf("time_to_first_notification_ms %.3f\n",
+           (bench->firstNotification - bench->start) / 1e3);
+    printf("notifications %llu\n", (unsigned long long)bench->notifications);
+    printf("notifications_per_second %.1f\n",
+           window > 0 ? bench->windowNotifications / window : 0.0);
+
+    qsort(bench->writeRtt, n, sizeof(gint64), compare_rtt);
+    printf("writes %d\n", n);
+    printf("write_errors %d\n", bench->writeErrors);
+    if (n > 0)
+    {
+        printf("write_rtt_us_p50 %lld\n", (long long)bench->writeRtt[n / 2]);
+        printf("write_rtt_us_p99 %lld\n", (long long)bench->writeRtt[(n * 99) / 100]);
+        printf("write_rtt_us_max %lld\n", (long long)bench->writeRtt[n - 1]);
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: bleBench [-t measurement seconds] [-w writes]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct bench bench = { .state = BENCH_INIT, .seconds = 5, .writes = 200 };
+    bluez_client_t *client;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:w:")) != -1)
+    {
+        switch (opt)
+        {
+            case 't': bench.seconds = atoi(optarg); break;
+            case 'w': bench.writes = atoi(optarg); break;
+            default:  usage();
+        }
+    }
+
+    if (bench.seconds < 1 || bench.writes < 0)
+        usage();
+
+    bench.writeRtt = g_new0(gint64, bench.writes + 1);
+    bench.start = g_get_monotonic_time();
+
+    client = bluez_client_new(NULL, &bench);
+
+    if (bluez_client_init(client, DBUS_BUS_SESSION, BLUEZ_SERVICE, BLUEZ_PATH,
+                          client_ready) == FALSE)
+    {
+        fprintf(stderr, "bleBench: unable to connect to the session bus\n");
+        bluez_client_free(client);
+        return 1;
+    }
+
+    bluez_set_property_change_fn(client, property_changed);
+    g_timeout_add(100, bench_check, client);
+
+    bluez_client_run(client);
+
+    if (bench.firstNotification != 0)
+        report(&bench, g_get_monotonic_time());
+
+    bluez_client_exit(client);
+    bluez_client_free(client);
+    g_free(bench.writeRtt);
+
+    return bench.firstNotification != 0 ? 0 : 1;
+}
@@ -54,13 +54,25 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <glib.h>
+#include <glib-unix.h>
 #include <dbus/dbus.h>
 
 #include "gdbus/gdbus.h"
 #include "bleClient.h"
+#include "bleClientPrivate.h"
+#include "bleMetrics.h"
+#include "bleProbes.h"
+#include "bleTransport.h"
 
 #define METHOD_CALL_TIMEOUT (300 * 1000)
 
@@ -68,183 +80,268 @@
 #define DBUS_INTERFACE_OBJECT_MANAGER DBUS_INTERFACE_DBUS ".ObjectManager"
 #endif
 
-#define MAX_BLUEZ_PATH 64
-#define MAX_BLUEZ_INTERFACE 32
-#define MAX_PROPERTIES 4
-#define MAX_PROXIES 3
-
 #define error(fmt...)
 
-extern DBusConnection *dbus_conn;
-
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // Forward declarations.
 
 gboolean            bluez_dbus_msg_recurse  (DBusMessageIter *iter, DBusMessageIter *sub,
                                              int type, void *value);
-static void         bluez_add_property      (GDBusProxy *proxy, const char *name,
-                                             DBusMessageIter *iter, gboolean send_changed);
-static void         bluez_discovery_filter  (void);
+static void         bluez_discovery_filter  (bluez_client_t *client);
+static void         bluez_mirror_add        (GDBusClient *client, const char *path,
+                                             const char *interface, GDBusProxy *proxy);
+static void         bluez_mirror_remove     (GDBusClient *client, const char *path,
+                                             const char *interface);
 static GDBusProxy * bluez_screen_interface  (GDBusClient *client, const char *path,
                                              const char *interface, DBusMessageIter *iter);
-static gboolean     bluez_screen_uuid       (DBusMessageIter *iter, const char *uuidWanted);
-
-struct GDBusClient
-{
-	DBusConnection *dbus_conn;
-	char *service_name;
-	char *base_path;
-	char *root_path;
-	guint watch;
-	guint added_watch;
-	guint removed_watch;
-	DBusPendingCall *pending_call;
-	DBusPendingCall *get_objects_call;
-	gboolean connected;
-	GDBusProxyFunction proxy_added;
-	GDBusClientFunction ready;
-        PropertyCallback propertyCallback;
-};
 
-struct prop_entry
+// Properties captured for each supported interface, terminated by "".
+static const char *const adapter_properties[] = { "Powered", "Discovering", "" };
+static const char *const device_properties[] = { "RSSI", "Connected", "ServicesResolved", "" };
+static const char *const characteristicRd_properties[] = { "NotifyAcquired", "" };
+static const char *const characteristicWr_properties[] = { "" };
+
+static const char *const *const proxy_properties[BLUEZ_PROXY_COUNT] =
 {
-	char *name;
-	int type;
-	DBusMessage *msg;
+    [BLUEZ_PROXY_ADAPTER] = adapter_properties,
+    [BLUEZ_PROXY_DEVICE] = device_properties,
+    [BLUEZ_PROXY_CHARACTERISTIC_RD] = characteristicRd_properties,
+    [BLUEZ_PROXY_CHARACTERISTIC_WR] = characteristicWr_properties
 };
 
-struct GDBusProxy 
-{
-	GDBusClient *client;
-	char obj_path[MAX_BLUEZ_PATH];
-	char interface[MAX_BLUEZ_INTERFACE];
-        struct prop_entry property[MAX_PROPERTIES];  // leave room for properties in structure
-	guint watch;
-	GDBusPropertyFunction prop_func;
-	void *prop_data;
-	GDBusProxyFunction removed_func;
-	void *removed_data;
-	gboolean pending;
-};
+//-----------------------------------------------------------------------------
+// Functions extracted from Bluez module client/gatt.c.  Support for writing
+// attributes removed.
 
-// Statically allocated proxies for all supported interfaces.
-GDBusProxy adapter =
-{
-    .property[0].name = "Powered",
-    .property[1].name = "Discovering",
-    .property[2].name = ""
-},
-device =
+static void notify_io_close(struct pipe_io *notify_io)
 {
-    .property[0].name = "RSSI",
-    .property[1].name = "Connected",
-    .property[2].name = "ServicesResolved",
-    .property[3].name = ""
-},
-characteristicRd =
-{
-    .property[0].name = "NotifyAcquired",
-    .property[1].name = ""
-},
-characteristicWr =
+	if (notify_io->source)
+        {
+            g_source_destroy(notify_io->source);
+            g_source_unref(notify_io->source);
+            notify_io->source = NULL;
+            close(notify_io->fd);
+	}
+        else if (notify_io->op)
+        {
+            uring_cancel(notify_io->client->uring, notify_io->op);
+            notify_io->op = NULL;
+            close(notify_io->fd);
+        }
+        else if (notify_io->paused)
+            close(notify_io->fd);
+
+        notify_io->paused = FALSE;
+}
+
+static void notify_io_destroy(struct pipe_io *notify_io)
 {
-    .property[0].name = ""
-};
+	if (notify_io->client != NULL && notify_io->client->framing != NULL)
+		framing_reset(notify_io->client);
+
+	notify_io_close(notify_io);
+	memset(notify_io, 0, sizeof(*notify_io));
+}
 
-// Statically allocated client structure for a single client.
-GDBusClient btClient =
+static bool pipe_hup(struct pipe_io *notify_io)
 {
-    .service_name = BLUEZ_SERVICE,
-    .base_path = BLUEZ_PATH,
-    .root_path = ROOT_PATH,
-    .connected = FALSE
-};
+    fprintf(stderr, "Notify closed\n");
 
-//-----------------------------------------------------------------------------
-// Functions extracted from Bluez module client/gatt.c.  Support for writing
-// attributes removed.
+    if (notify_io->client->watchdog)
+        watchdog_stop(notify_io->client);
 
-#include "src/shared/io.h"
-#include <unistd.h>
+    notify_io_destroy(notify_io);
 
-struct chrc {
-	char *path;
-	struct io *notify_io;
-};
+    return false;
+}
 
-struct pipe_io {
-	GDBusProxy *proxy;
-	struct io *io;
-	uint16_t mtu;
-        NotificationCallback cb;
-};
+// Stops watching the pipe, leaving it open, until notify_io_resume().
+static bool pipe_pause(struct pipe_io *notify_io)
+{
+	if (notify_io->source)
+	{
+		g_source_destroy(notify_io->source);
+		g_source_unref(notify_io->source);
+		notify_io->source = NULL;
+	}
+	if (notify_io->op)
+	{
+		uring_cancel(notify_io->client->uring, notify_io->op);
+		notify_io->op = NULL;
+	}
+	notify_io->paused = TRUE;
 
-static struct pipe_io notify_io;
+	return false;
+}
 
-static void notify_io_destroy(void)
+// Delivers one notification, or hands it to the notification buffer.
+static void notify_io_deliver(bluez_client_t *client, const uint8_t *buf, size_t len)
 {
-	io_destroy(notify_io.io);
-	memset(&notify_io, 0, sizeof(notify_io));
+	struct pipe_io *notify_io = &client->notify_io;
+
+	BLE_PROBE3(notify_receive, notify_io->proxy->obj_path, len, notify_io->fd);
+
+	bluez_metrics_inc(METRIC_NOTIFICATIONS);
+	bluez_metrics_add(METRIC_NOTIFICATION_BYTES, len);
+
+	startup_end(client, STARTUP_FIRST_NOTIFICATION);
+
+	if (client->watchdog)
+		watchdog_feed(client);
+
+	if (client->notifyBuffer == NULL)
+		bluez_deliver_sample(client, BLUEZ_SOURCE_NOTIFY, g_get_monotonic_time(),
+					buf, len);
+	else if (notify_io->paused && client->uring != NULL)
+		notify_buffer_park(client, g_get_monotonic_time(), buf, len);
+	else
+		notify_buffer_push(client, g_get_monotonic_time(), buf, len);
 }
 
-static bool pipe_read(struct io *io, void *user_data)
+// Reads up to 'max' notifications and delivers them, or hands them to the
+// notification buffer if there is one.  '*count' is set to the number
+// read.  Returns FALSE if the pipe should no longer be watched.
+gboolean notify_io_read(bluez_client_t *client, int max, int *count)
 {
-	struct chrc *chrc = user_data;
+	struct pipe_io *notify_io = &client->notify_io;
 	uint8_t buf[512];
-	int fd = io_get_fd(io);
 	ssize_t bytes_read;
 
-	if (io != notify_io.io && !chrc)
-		return true;
+	for (*count = 0; *count < max; (*count)++)
+	{
+		if (client->notifyBuffer != NULL && notify_buffer_blocked(client))
+			return pipe_pause(notify_io);
+
+		bytes_read = read(notify_io->fd, buf, sizeof(buf));
+		if (bytes_read < 0)
+		{
+			if (errno == EAGAIN || errno == EINTR)
+				return true;
+
+			bluez_metrics_inc(METRIC_NOTIFY_READ_ERRORS);
+			return false;
+		}
 
-	bytes_read = read(fd, buf, sizeof(buf));
-	if (bytes_read < 0)
-		return false;
+		// End of file, the remote end of the pipe is gone.
+		if (bytes_read == 0)
+			return pipe_hup(notify_io);
 
-        if (notify_io.cb != NULL)
-            (notify_io.cb)((int)buf[0]);
+		notify_io_deliver(client, buf, bytes_read);
+	}
 
 	return true;
 }
 
-static bool pipe_hup(struct io *io, void *user_data)
+// Reads one notification per wakeup and delivers it.  With a notification
+// buffer, reads as many as are waiting, up to NOTIFY_READ_BATCH, into the
+// buffer instead.  With batched wakeups, leaves them in the pipe for the
+// wakeup timer to read.
+static bool pipe_read(struct pipe_io *notify_io)
 {
-    struct chrc *chrc = user_data;
+	bluez_client_t *client = notify_io->client;
+	int count;
 
-    if (chrc) 
-    {
-        fprintf(stderr, "Attribute %s Notify pipe closed\n", chrc->path);
+	bluez_metrics_inc(METRIC_WAKEUPS);
 
-        io_destroy(chrc->notify_io);
-        chrc->notify_io = NULL;
+	if (client->wakeup != NULL && wakeup_hold(client))
+		return pipe_pause(notify_io);
 
-        return false;
-    }
+	return notify_io_read(client, client->notifyBuffer != NULL ? NOTIFY_READ_BATCH : 1,
+				&count);
+}
 
-    fprintf(stderr, "%s closed\n", io == notify_io.io ? "Notify" : "Write");
+// The original io-glib.c watch attaches to the global default context, so
+// the notification pipe is watched by a unix fd source on the client's own
+// context instead.
+static gboolean pipe_event(gint fd, GIOCondition cond, gpointer user_data)
+{
+	struct pipe_io *notify_io = user_data;
 
-    notify_io_destroy();
+	if (cond & G_IO_IN)
+		return pipe_read(notify_io);
 
-    return false;
+	if (cond & (G_IO_HUP | G_IO_ERR | G_IO_NVAL))
+		return pipe_hup(notify_io);
+
+	return TRUE;
+}
+
+// Completion of the io_uring receive on the notification socket.  Called
+// with notifications already received even after the receive is
+// cancelled.  Under BLUEZ_BP_BLOCK those are parked by the notification
+// buffer rather than dropped.
+static void pipe_recv(void *user_data, int res, const uint8_t *data)
+{
+	bluez_client_t *client = user_data;
+	struct pipe_io *notify_io = &client->notify_io;
+
+	bluez_metrics_inc(METRIC_WAKEUPS);
+
+	// Closed since.
+	if (notify_io->proxy == NULL)
+		return;
+
+	if (res == 0)
+	{
+		pipe_hup(notify_io);
+		return;
+	}
+
+	if (res < 0)
+	{
+		bluez_metrics_inc(METRIC_NOTIFY_READ_ERRORS);
+		return;
+	}
+
+	notify_io_deliver(client, data, res);
+
+	if (client->notifyBuffer != NULL && notify_io->op != NULL && notify_buffer_blocked(client))
+		pipe_pause(notify_io);
 }
 
-static struct io *pipe_io_new(int fd, void *user_data)
+static void pipe_io_new(struct pipe_io *notify_io, int fd, GMainContext *context)
 {
-	struct io *io;
+	// Non-blocking, so a buffered read loop stops when the pipe is empty.
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	notify_io->fd = fd;
+	notify_io->paused = FALSE;
+
+	if (notify_io->client->uring != NULL)
+	{
+		notify_io->op = uring_recv(notify_io->client->uring, fd, pipe_recv,
+						notify_io->client);
+		if (notify_io->op != NULL)
+			return;
+	}
+	notify_io->source = g_unix_fd_source_new(fd, G_IO_IN | G_IO_HUP | G_IO_ERR);
 
-	io = io_new(fd);
+	g_source_set_callback(notify_io->source, (GSourceFunc) pipe_event,
+						notify_io, NULL);
 
-	io_set_close_on_destroy(io, true);
+	g_source_attach(notify_io->source, context);
+}
 
-	io_set_read_handler(io, pipe_read, user_data, NULL);
+// Closes the notification socket from this end, as when acquiring it
+// again, without the hangup handling.
+void notify_io_release(bluez_client_t *client)
+{
+	notify_io_close(&client->notify_io);
+}
 
-	io_set_disconnect_handler(io, pipe_hup, user_data, NULL);
+// Watches the notification pipe again after pipe_pause().
+void notify_io_resume(bluez_client_t *client)
+{
+	struct pipe_io *notify_io = &client->notify_io;
 
-	return io;
+	if (notify_io->paused)
+		pipe_io_new(notify_io, notify_io->fd, client->context);
 }
 
 static void acquire_notify_reply(DBusMessage *message, void *user_data)
 {
+	bluez_client_t *client = user_data;
+	struct pipe_io *notify_io = &client->notify_io;
 	DBusError error;
 	int fd;
 
@@ -257,28 +354,32 @@ static void acquire_notify_reply(DBusMessage *message, void *user_data)
             return;
 	}
 
-	if (notify_io.io)
-        {
-            io_destroy(notify_io.io);
-            notify_io.io = NULL;
-	}
+	notify_io_close(notify_io);
 
-	notify_io.mtu = 0;
+	notify_io->mtu = 0;
 
 	if ((dbus_message_get_args(message, NULL, DBUS_TYPE_UNIX_FD, &fd,
-					DBUS_TYPE_UINT16, &notify_io.mtu,
+					DBUS_TYPE_UINT16, &notify_io->mtu,
 					DBUS_TYPE_INVALID) == false)) {
 		fprintf(stderr, "Invalid AcquireNotify response\n");
 		return;
 	}
 
-	fprintf(stderr, "AcquireNotify success: fd %d MTU %u\n", fd, notify_io.mtu);
+	fprintf(stderr, "AcquireNotify success: fd %d MTU %u\n", fd, notify_io->mtu);
 
-	notify_io.io = pipe_io_new(fd, NULL);
+	BLE_PROBE3(acquire_notify, client->proxy[BLUEZ_PROXY_CHARACTERISTIC_RD].obj_path,
+						fd, notify_io->mtu);
+
+	startup_end(client, STARTUP_ACQUIRE_NOTIFY);
+	startup_begin(client, STARTUP_FIRST_NOTIFICATION);
+
+	pipe_io_new(notify_io, fd, client->context);
 }
 
 
-static void acquire_setup(DBusMessageIter *iter, void *user_data)
+// Appends an empty options dictionary, as taken by AcquireNotify, ReadValue
+// and WriteValue.
+void bluez_options_setup(DBusMessageIter *iter, void *user_data)
 {
 	DBusMessageIter dict;
 
@@ -292,10 +393,10 @@ static void acquire_setup(DBusMessageIter *iter, void *user_data)
 	dbus_message_iter_close_container(iter, &dict);
 }
 
-void bluez_acquire_notify(NotificationCallback cb)
+void bluez_acquire_notify(bluez_client_t *client, NotificationCallback cb)
 {
-    GDBusProxy *proxy = &characteristicRd;
-    
+    GDBusProxy *proxy = &client->proxy[BLUEZ_PROXY_CHARACTERISTIC_RD];
+
     if (strcmp(proxy->interface, "org.bluez.GattCharacteristic1"))
     {
         fprintf(stderr, "Unable to acquire notify: %s not a"
@@ -303,19 +404,281 @@ void bluez_acquire_notify(NotificationCallback cb)
         return;
     }
 
-    if (g_dbus_proxy_method_call(proxy, "AcquireNotify", acquire_setup,
-                            acquire_notify_reply, NULL, NULL) == FALSE)
+    if (g_dbus_proxy_method_call(proxy, "AcquireNotify", bluez_options_setup,
+                            acquire_notify_reply, client, NULL) == FALSE)
     {
         fprintf(stderr, "Failed to AcquireNotify\n");
         return;
     }
 
-    notify_io.proxy = proxy;
-    notify_io.cb = cb;
+    startup_begin(client, STARTUP_ACQUIRE_NOTIFY);
+
+    client->notify_io.client = client;
+    client->notify_io.proxy = proxy;
+    client->notify_io.cb = cb;
+}
+
+// Value waiting for room in the AcquireWrite socket, GLib backend.
+struct write_pending
+{
+	struct write_pending *next;
+	size_t len;
+	uint8_t data[];
+};
+
+// Drops the values still waiting to be sent, before the socket is
+// closed: the ring would otherwise send them to whatever reuses its
+// descriptor.
+static void write_io_drop(bluez_client_t *client)
+{
+	struct write_io *write_io = &client->write_io;
+	struct write_pending *pending;
+
+	if (client->uring != NULL && write_io->acquired)
+		uring_send_drop(client->uring, write_io->fd);
+
+	if (write_io->source)
+	{
+		g_source_destroy(write_io->source);
+		g_source_unref(write_io->source);
+		write_io->source = NULL;
+	}
+
+	while ((pending = write_io->head) != NULL)
+	{
+		write_io->head = pending->next;
+		g_free(pending);
+	}
+	write_io->tail = NULL;
+}
+
+static void acquire_write_reply(DBusMessage *message, void *user_data)
+{
+	bluez_client_t *client = user_data;
+	struct write_io *write_io = &client->write_io;
+	DBusError error;
+	int fd;
+
+	dbus_error_init(&error);
+
+	if (dbus_set_error_from_message(&error, message) == TRUE)
+	{
+		fprintf(stderr, "Failed to acquire write: %s\n", error.name);
+		dbus_error_free(&error);
+		return;
+	}
+
+	if (dbus_message_get_args(message, NULL, DBUS_TYPE_UNIX_FD, &fd,
+					DBUS_TYPE_UINT16, &write_io->mtu,
+					DBUS_TYPE_INVALID) == false) {
+		fprintf(stderr, "Invalid AcquireWrite response\n");
+		return;
+	}
+
+	fprintf(stderr, "AcquireWrite success: fd %d MTU %u\n", fd, write_io->mtu);
+
+	if (write_io->acquired)
+	{
+		write_io_drop(client);
+		close(write_io->fd);
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	write_io->fd = fd;
+	write_io->acquired = TRUE;
+}
+
+// Acquires a socket for writes to the write characteristic, which
+// bluez_write_attribute() then uses in place of WriteValue calls.
+void bluez_acquire_write(bluez_client_t *client)
+{
+    GDBusProxy *proxy = &client->proxy[BLUEZ_PROXY_CHARACTERISTIC_WR];
+
+    if (strcmp(proxy->interface, "org.bluez.GattCharacteristic1"))
+    {
+        fprintf(stderr, "Unable to acquire write: %s not a"
+                        " characteristic\n", proxy->interface);
+        return;
+    }
+
+    if (g_dbus_proxy_method_call(proxy, "AcquireWrite", bluez_options_setup,
+                            acquire_write_reply, client, NULL) == FALSE)
+        fprintf(stderr, "Failed to AcquireWrite\n");
+}
+
+static void write_io_close(bluez_client_t *client)
+{
+	struct write_io *write_io = &client->write_io;
+
+	write_io_drop(client);
+
+	if (write_io->acquired)
+		close(write_io->fd);
+
+	memset(write_io, 0, sizeof(*write_io));
+}
+
+static void write_io_sent(void *user_data, int res, const uint8_t *data)
+{
+	bluez_client_t *client = user_data;
+
+	if (res < 0)
+		fprintf(stderr, "Failed to write: %s\n", strerror(-res));
+
+	BLE_PROBE2(write_complete, client->proxy[BLUEZ_PROXY_CHARACTERISTIC_WR].obj_path,
+			res < 0 ? res : 0);
+}
+
+// Sends the values that were waiting, as the socket takes them.
+static gboolean write_io_ready(gint fd, GIOCondition cond, gpointer user_data)
+{
+	bluez_client_t *client = user_data;
+	struct write_io *write_io = &client->write_io;
+	struct write_pending *pending;
+
+	while ((pending = write_io->head) != NULL)
+	{
+		if (send(fd, pending->data, pending->len, MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return TRUE;
+			write_io_sent(client, -errno, NULL);
+		}
+		else
+			write_io_sent(client, 0, NULL);
+
+		write_io->head = pending->next;
+		g_free(pending);
+	}
+
+	write_io->tail = NULL;
+	g_source_unref(write_io->source);
+	write_io->source = NULL;
+
+	return FALSE;
+}
+
+// Sends a value on the AcquireWrite socket, through the ring on the
+// io_uring backend.  On the GLib backend a value the socket has no room
+// for waits, along with every value after it, until the socket is
+// writable, so that none is dropped or overtaken.
+static void write_io_send(bluez_client_t *client, const uint8_t *data, size_t len)
+{
+	struct write_io *write_io = &client->write_io;
+	struct write_pending *pending;
+
+	if (client->uring != NULL)
+	{
+		uring_send(client->uring, write_io->fd, data, len, write_io_sent, client);
+		return;
+	}
+
+	if (write_io->head == NULL)
+	{
+		if (send(write_io->fd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL) >= 0)
+		{
+			write_io_sent(client, 0, NULL);
+			return;
+		}
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			write_io_sent(client, -errno, NULL);
+			return;
+		}
+	}
+
+	pending = g_malloc(sizeof(*pending) + len);
+	pending->next = NULL;
+	pending->len = len;
+	memcpy(pending->data, data, len);
+
+	if (write_io->tail != NULL)
+		write_io->tail->next = pending;
+	else
+		write_io->head = pending;
+	write_io->tail = pending;
+
+	if (write_io->source == NULL)
+	{
+		write_io->source = g_unix_fd_source_new(write_io->fd, G_IO_OUT);
+		g_source_set_callback(write_io->source, (GSourceFunc) write_io_ready,
+						client, NULL);
+		g_source_attach(write_io->source, client->context);
+	}
+}
+
+// Hands a value to the notification callback, which sees its first byte,
+// and to every sample sink.  While wakeups are batched, polled values are
+// held for the next wakeup instead.
+void bluez_deliver_sample(bluez_client_t *client, int source, gint64 timestamp,
+                          const uint8_t *data, size_t len)
+{
+    struct bluez_sample sample;
+    int i;
+
+    if (client->wakeup != NULL && wakeup_defer(client, source, timestamp, data, len))
+        return;
+
+    if (client->framing != NULL && source == BLUEZ_SOURCE_NOTIFY &&
+        framing_receive(client, timestamp, &data, &len) == FALSE)
+        return;
+
+    if (client->notify_io.cb != NULL && len > 0)
+        (client->notify_io.cb)(client, (int)data[0]);
+
+    if (client->sinkCount == 0)
+        return;
+
+    sample.source = source;
+    sample.timestamp = timestamp;
+    sample.data = data;
+    sample.len = len;
+
+    for (i = 0; i < client->sinkCount; i++)
+        client->sinks[i].fn(client, &sample, client->sinks[i].user_data);
 }
 
+// Adds a receiver of full notification and polled payloads.  Returns
+// FALSE if MAX_SAMPLE_SINKS are already registered.
+gboolean bluez_add_sample_sink(bluez_client_t *client, SampleCallback fn, void *user_data)
+{
+    if (fn == NULL || client->sinkCount == MAX_SAMPLE_SINKS)
+        return FALSE;
+
+    client->sinks[client->sinkCount].fn = fn;
+    client->sinks[client->sinkCount].user_data = user_data;
+    client->sinkCount++;
+
+    return TRUE;
+}
+
+void bluez_remove_sample_sink(bluez_client_t *client, SampleCallback fn, void *user_data)
+{
+    int i;
+
+    for (i = 0; i < client->sinkCount; i++)
+    {
+        if (client->sinks[i].fn == fn && client->sinks[i].user_data == user_data)
+        {
+            memmove(&client->sinks[i], &client->sinks[i + 1],
+                    (client->sinkCount - i - 1) * sizeof(client->sinks[0]));
+            client->sinkCount--;
+            return;
+        }
+    }
+}
+
+// Context for bluez_write_attribute(), starting with the iovec expected by
+// bluez_write_setup().
+struct write_data
+{
+    struct iovec iov;
+    GDBusProxy *proxy;
+};
+
 static void write_reply(DBusMessage *message, void *user_data)
 {
+    struct write_data *data = user_data;
     DBusError error;
 
     dbus_error_init(&error);
@@ -324,10 +687,17 @@ static void write_reply(DBusMessage *message, void *user_data)
     {
         fprintf(stderr, "Failed to write: %s\n", error.name);
         dbus_error_free(&error);
+        BLE_PROBE2(write_complete, data->proxy->obj_path, -EIO);
+        return;
     }
+
+    BLE_PROBE2(write_complete, data->proxy->obj_path, 0);
 }
 
-static void write_setup(DBusMessageIter *iter, void *user_data)
+// 'user_data' points to a struct iovec holding the bytes to write.  The
+// iovec may be the first member of a larger structure that also carries
+// context for the reply handler.
+void bluez_write_setup(DBusMessageIter *iter, void *user_data)
 {
     struct iovec *iov = user_data;
     DBusMessageIter array, dict;
@@ -346,10 +716,36 @@ static void write_setup(DBusMessageIter *iter, void *user_data)
     dbus_message_iter_close_container(iter, &dict);
 }
 
+// Writes 'len' bytes to the characteristic for writes, through the
+// AcquireWrite socket if there is one.
+void bluez_write_value(bluez_client_t *client, const uint8_t *bytes, size_t len)
+{
+    struct write_data *data;
+
+    if (client->write_io.acquired)
+    {
+        write_io_send(client, bytes, len);
+        return;
+    }
+
+    // 'bytes' is only needed while the message is built, the rest of
+    // 'data' lives until the reply.
+    data = g_new0(struct write_data, 1);
+    data->iov.iov_base = (void *)bytes;
+    data->iov.iov_len = len;
+    data->proxy = &client->proxy[BLUEZ_PROXY_CHARACTERISTIC_WR];
+
+    if (g_dbus_proxy_method_call(data->proxy, "WriteValue", bluez_write_setup,
+                                    write_reply, data, g_free) == FALSE)
+    {
+        fprintf(stderr, "Failed to write\n");
+        g_free(data);
+    }
+}
+
 // Write a four-byte value to the single GATT attribute supported for writes.
-void bluez_write_attribute(uint32_t value)
+void bluez_write_attribute(bluez_client_t *client, uint32_t value)
 {
-    struct iovec iov;
     uint8_t bytes[4];
     int i;
 
@@ -359,14 +755,8 @@ void bluez_write_attribute(uint32_t value)
         if (0 == i)  break;
         value >>= 8;
     }
-    iov.iov_base = bytes;
-    iov.iov_len = 4;
 
-    if (g_dbus_proxy_method_call(&characteristicWr, "WriteValue", write_setup,
-                                    write_reply, &iov, NULL) == FALSE)
-    {
-        fprintf(stderr, "Failed to write\n");
-    }
+    bluez_write_value(client, bytes, 4);
 }
 
 
@@ -497,7 +887,7 @@ void g_dbus_dict_append_array(DBusMessageIter *dict,
 								n_elements);
 }
 
-static void iter_append_iter(DBusMessageIter *base, DBusMessageIter *iter)
+void iter_append_iter(DBusMessageIter *base, DBusMessageIter *iter)
 {
 	int type;
 
@@ -510,24 +900,34 @@ static void iter_append_iter(DBusMessageIter *base, DBusMessageIter *iter)
 		dbus_message_iter_append_basic(base, type, &value);
 	} else if (dbus_type_is_container(type)) {
 		DBusMessageIter iter_sub, base_sub;
-		char *sig;
+		char basic_sig[2] = { 0, '\0' };
+		char *sig = NULL;
 
 		dbus_message_iter_recurse(iter, &iter_sub);
 
+		// A variant holding a basic value, or an array of basic
+		// values, has a one-character signature that can be built on
+		// the stack.  Anything deeper asks libdbus, which allocates.
 		switch (type) {
 		case DBUS_TYPE_ARRAY:
-		case DBUS_TYPE_VARIANT:
-			sig = dbus_message_iter_get_signature(&iter_sub);
+			basic_sig[0] = dbus_message_iter_get_element_type(iter);
 			break;
-		default:
-			sig = NULL;
+		case DBUS_TYPE_VARIANT:
+			basic_sig[0] = dbus_message_iter_get_arg_type(&iter_sub);
 			break;
 		}
 
-		dbus_message_iter_open_container(base, type, sig, &base_sub);
+		if (dbus_type_is_basic(basic_sig[0]))
+			dbus_message_iter_open_container(base, type, basic_sig, &base_sub);
+		else {
+			if (type == DBUS_TYPE_ARRAY || type == DBUS_TYPE_VARIANT)
+				sig = dbus_message_iter_get_signature(&iter_sub);
 
-		if (sig != NULL)
-			dbus_free(sig);
+			dbus_message_iter_open_container(base, type, sig, &base_sub);
+
+			if (sig != NULL)
+				dbus_free(sig);
+		}
 
 		while (dbus_message_iter_get_arg_type(&iter_sub) !=
 							DBUS_TYPE_INVALID) {
@@ -539,11 +939,22 @@ static void iter_append_iter(DBusMessageIter *base, DBusMessageIter *iter)
 	}
 }
 
-static void prop_entry_update(struct prop_entry *prop, DBusMessageIter *iter)
+void prop_entry_update(struct prop_entry *prop, DBusMessageIter *iter)
 {
 	DBusMessage *msg;
 	DBusMessageIter base;
 
+	// Every property the client tracks is a boolean or an integer, which
+	// is stored in place.  Only other types are copied into a message.
+	if (dbus_type_is_fixed(dbus_message_iter_get_arg_type(iter))) {
+		dbus_message_iter_get_basic(iter, &prop->value);
+
+		if (prop->msg != NULL)
+			dbus_message_unref(prop->msg);
+		prop->msg = NULL;
+		return;
+	}
+
 	msg = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
 	if (msg == NULL)
 		return;
@@ -554,11 +965,10 @@ static void prop_entry_update(struct prop_entry *prop, DBusMessageIter *iter)
 	if (prop->msg != NULL)
 		dbus_message_unref(prop->msg);
 
-	prop->msg = dbus_message_copy(msg);
-	dbus_message_unref(msg);
+	prop->msg = msg;
 }
 
-static void update_properties(GDBusProxy *proxy, DBusMessageIter *iter,
+void update_properties(GDBusProxy *proxy, DBusMessageIter *iter,
 							gboolean send_changed)
 {
     DBusMessageIter dict;
@@ -576,6 +986,10 @@ static void update_properties(GDBusProxy *proxy, DBusMessageIter *iter,
         if (bluez_dbus_msg_recurse(&dict, &entry, DBUS_TYPE_STRING, &name) == FALSE)
             break;
 
+        if (send_changed)
+            bluez_metrics_inc(METRIC_PROPERTY_EVENTS +
+                              (proxy - client_of(proxy->client)->proxy));
+
         bluez_add_property(proxy, name, &entry, send_changed);
 
         dbus_message_iter_next(&dict);
@@ -610,30 +1024,71 @@ static gboolean properties_changed(DBusConnection *conn, DBusMessage *msg,
     dbus_message_iter_get_basic(&iter, &interface);
     dbus_message_iter_next(&iter);
 
+    if (strcmp(interface, proxy->interface))
+            return TRUE;
+
+    BLE_PROBE2(properties_changed, proxy->obj_path, interface);
+
     update_properties(proxy, &iter, TRUE);
 
+    // Properties that no longer have a value, or whose new value the
+    // daemon did not send.
+    if (dbus_message_iter_next(&iter) == FALSE ||
+        dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY)
+            return TRUE;
+
+    dbus_message_iter_recurse(&iter, &entry);
+
+    while (dbus_message_iter_get_arg_type(&entry) == DBUS_TYPE_STRING)
+    {
+        const char *name;
+
+        dbus_message_iter_get_basic(&entry, &name);
+        bluez_invalidate_property(proxy, name);
+        dbus_message_iter_next(&entry);
+    }
+
     return TRUE;
 }
 
+// Starts with the transport's context, which is handed back in the
+// transport callbacks.
 struct method_call_data
 {
+    struct transport_call call;
+    struct bluez_slab *slab;
     GDBusReturnFunction function;
     void *user_data;
     GDBusDestroyFunction destroy;
+    gint64 start;
+    char method[32];
 };
 
-static void method_call_reply(DBusPendingCall *call, void *user_data)
+static void method_call_reply(DBusMessage *reply, struct transport_call *call)
 {
-    struct method_call_data *data = user_data;
-    DBusMessage *reply = dbus_pending_call_steal_reply(call);
+    struct method_call_data *data = (struct method_call_data *)call;
+    gint64 latency = g_get_monotonic_time() - data->start;
+    gboolean failed = (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR);
+
+    BLE_PROBE3(method_reply, data->method, latency, failed);
+
+    bluez_metrics_observe(HISTOGRAM_DBUS_CALL_SECONDS, latency);
+
+    if (failed)
+            bluez_metrics_inc(METRIC_DBUS_CALL_FAILURES);
 
     if (data->function)
             data->function(reply, data->user_data);
 
     if (data->destroy)
             data->destroy(data->user_data);
+}
+
+static void method_call_data_free(struct transport_call *call)
+{
+    struct method_call_data *data = (struct method_call_data *)call;
 
-    dbus_message_unref(reply);
+    bluez_slab_free(data->slab, data);
 }
 
 // Methods called:
@@ -649,8 +1104,9 @@ gboolean g_dbus_proxy_method_call(GDBusProxy *proxy, const char *method,
 {
     struct method_call_data *data;
     GDBusClient *client;
+    bluez_client_t *owner;
     DBusMessage *msg;
-    DBusPendingCall *call;
+    gboolean sent;
 
     if (proxy == NULL || method == NULL)
             return FALSE;
@@ -659,11 +1115,17 @@ gboolean g_dbus_proxy_method_call(GDBusProxy *proxy, const char *method,
     if (client == NULL)
             return FALSE;
 
+    owner = client_of(client);
+
     msg = dbus_message_new_method_call(BLUEZ_SERVICE,
                             proxy->obj_path, proxy->interface, method);
     if (msg == NULL)
             return FALSE;
 
+    bluez_metrics_inc(METRIC_DBUS_CALLS);
+
+    BLE_PROBE3(method_call, proxy->obj_path, proxy->interface, method);
+
     if (setup) {
             DBusMessageIter iter;
 
@@ -672,26 +1134,42 @@ gboolean g_dbus_proxy_method_call(GDBusProxy *proxy, const char *method,
     }
 
     if (!function)
-            return g_dbus_send_message(client->dbus_conn, msg);
+    {
+        sent = owner->transport->send(owner->transportConn, msg);
+        dbus_message_unref(msg);
+        if (sent == FALSE)
+        {
+            bluez_metrics_inc(METRIC_DBUS_CALL_FAILURES);
+            return FALSE;
+        }
+        return TRUE;
+    }
 
-    data = g_try_new0(struct method_call_data, 1);
+    data = bluez_slab_alloc(&owner->callSlab);
     if (data == NULL)
+    {
+            bluez_metrics_inc(METRIC_DBUS_CALL_FAILURES);
+            dbus_message_unref(msg);
             return FALSE;
+    }
 
+    data->call.reply = method_call_reply;
+    data->call.free = method_call_data_free;
+    data->slab = &owner->callSlab;
     data->function = function;
     data->user_data = user_data;
     data->destroy = destroy;
+    data->start = g_get_monotonic_time();
+    g_strlcpy(data->method, method, sizeof(data->method));
 
-    if (g_dbus_send_message_with_reply(client->dbus_conn, msg,
-                                    &call, METHOD_CALL_TIMEOUT) == FALSE) {
+    if (owner->transport->call(owner->transportConn, msg, METHOD_CALL_TIMEOUT,
+                                    &data->call) == FALSE) {
+            bluez_metrics_inc(METRIC_DBUS_CALL_FAILURES);
             dbus_message_unref(msg);
-            g_free(data);
+            method_call_data_free(&data->call);
             return FALSE;
     }
 
-    dbus_pending_call_set_notify(call, method_call_reply, data, g_free);
-    dbus_pending_call_unref(call);
-
     dbus_message_unref(msg);
 
     return TRUE;
@@ -709,6 +1187,9 @@ static void parse_properties(GDBusClient *client, const char *path,
             return;
 
     proxy = bluez_screen_interface(client, path, interface, iter);
+
+    bluez_mirror_add(client, path, interface, proxy);
+
     if (proxy == NULL)
         return;
 
@@ -717,9 +1198,35 @@ static void parse_properties(GDBusClient *client, const char *path,
     proxy_added(client, proxy);
 }
 
+// Records that a signal has added or removed 'interface' on 'path' while
+// a GetManagedObjects reply is being parsed.
+static void objects_touch(bluez_client_t *c, const char *path, const char *interface)
+{
+    if (c->objects_touched != NULL)
+        g_hash_table_add(c->objects_touched, g_strdup_printf("%s %s", path, interface));
+}
+
+static gboolean objects_touched(bluez_client_t *c, const char *path, const char *interface)
+{
+    char *key;
+    gboolean found;
+
+    if (c->objects_touched == NULL || g_hash_table_size(c->objects_touched) == 0)
+        return FALSE;
+
+    key = g_strdup_printf("%s %s", path, interface);
+    found = g_hash_table_contains(c->objects_touched, key);
+    g_free(key);
+
+    return found;
+}
+
+// 'fromReply' is TRUE for objects from a GetManagedObjects reply, FALSE
+// for InterfacesAdded.
 static void parse_interfaces(GDBusClient *client, const char *path,
-						DBusMessageIter *iter)
+				DBusMessageIter *iter, gboolean fromReply)
 {
+    bluez_client_t *c = client_of(client);
     DBusMessageIter dict;
 
     if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY)
@@ -736,7 +1243,13 @@ static void parse_interfaces(GDBusClient *client, const char *path,
             break;
 
         // Will filter and add only properties of interest.
-        parse_properties(client, path, interface, &entry);
+        if (!fromReply)
+        {
+            objects_touch(c, path, interface);
+            parse_properties(client, path, interface, &entry);
+        }
+        else if (!objects_touched(c, path, interface))
+            parse_properties(client, path, interface, &entry);
 
         dbus_message_iter_next(&dict);
     }
@@ -761,18 +1274,24 @@ static gboolean interfaces_added(DBusConnection *conn, DBusMessage *msg,
     dbus_message_iter_get_basic(&iter, &path);
     dbus_message_iter_next(&iter);
 
-    parse_interfaces(client, path, &iter);
+    if (reject_cache_contains(&client_of(client)->rejected, path))
+    {
+        bluez_metrics_inc(METRIC_REJECTED_OBJECTS);
+        return TRUE;
+    }
+
+    parse_interfaces(client, path, &iter, FALSE);
 
     return TRUE;
 }
 
+// Arrives here for the "InterfacesRemoved" signal, when a device has been
+// removed from the Bluez daemon's database or its services have gone away
+// on disconnect.  Proxies bound to the removed objects are invalidated, and
+// rebound when the objects reappear.
 static gboolean interfaces_removed(DBusConnection *conn, DBusMessage *msg,
 							void *user_data)
 {
-    // Since I removed the call to proxy_remove(), this function does no
-    // meaningful work.  I am keeping the shell around because it seems
-    // like it may be useful in the future.
-#ifdef OLD
     GDBusClient *client = user_data;
     DBusMessageIter iter, entry;
     const char *path;
@@ -789,71 +1308,188 @@ static gboolean interfaces_removed(DBusConnection *conn, DBusMessage *msg,
     if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY)
             return TRUE;
 
+    // A device that BlueZ has removed is screened afresh if it comes back.
+    if (reject_cache_key(path) == strlen(path))
+        reject_cache_remove(&client_of(client)->rejected, path);
+
     dbus_message_iter_recurse(&iter, &entry);
 
-    // Instead of proxy_remove() should set flag (possibly 'pending') so if interface
-    // reappears it will be reinitialized... (this would be 'Device1')
     while (dbus_message_iter_get_arg_type(&entry) == DBUS_TYPE_STRING) {
             const char *interface;
 
             dbus_message_iter_get_basic(&entry, &interface);
-            proxy_remove(client, path, interface);
+            objects_touch(client_of(client), path, interface);
+            bluez_mirror_remove(client, path, interface);
             dbus_message_iter_next(&entry);
     }
 
-#endif
     return TRUE;
 }
 
-static void parse_managed_objects(GDBusClient *client, DBusMessage *msg)
+// Positions the client at the first object of a GetManagedObjects reply
+// and keeps a reference to the reply until parse_objects_finish().
+gboolean parse_objects_begin(GDBusClient *client, DBusMessage *msg)
 {
-    DBusMessageIter iter, dict;
+    bluez_client_t *c = client_of(client);
+    DBusMessageIter iter;
 
     if (dbus_message_iter_init(msg, &iter) == FALSE)
-            return;
+            return FALSE;
 
     if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY)
-            return;
+            return FALSE;
 
-    dbus_message_iter_recurse(&iter, &dict);
+    dbus_message_iter_recurse(&iter, &c->objects_iter);
+    c->objects = dbus_message_ref(msg);
+    c->objects_touched = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 
-    while (dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY)
+    return TRUE;
+}
+
+// Parses objects until the monotonic time 'deadline', or to the end of
+// the reply if 'deadline' is 0.  Returns TRUE while objects remain.
+gboolean parse_objects_step(GDBusClient *client, gint64 deadline)
+{
+    bluez_client_t *c = client_of(client);
+
+    while (dbus_message_iter_get_arg_type(&c->objects_iter) == DBUS_TYPE_DICT_ENTRY)
     {
         DBusMessageIter entry;
         const char *path;
 
-        if (bluez_dbus_msg_recurse(&dict, &entry, DBUS_TYPE_OBJECT_PATH, &path) == FALSE)
-            break;
+        if (bluez_dbus_msg_recurse(&c->objects_iter, &entry, DBUS_TYPE_OBJECT_PATH, &path) == FALSE)
+            return FALSE;
 
-        parse_interfaces(client, path, &entry);
+        // Objects are listed parent first, so a device rejected here takes
+        // its services and characteristics with it.
+        if (!reject_cache_contains(&c->rejected, path))
+            parse_interfaces(client, path, &entry, TRUE);
 
-        dbus_message_iter_next(&dict);
+        dbus_message_iter_next(&c->objects_iter);
+
+        if (deadline != 0 && g_get_monotonic_time() >= deadline)
+            return dbus_message_iter_get_arg_type(&c->objects_iter) == DBUS_TYPE_DICT_ENTRY;
+    }
+
+    return FALSE;
+}
+
+void parse_objects_finish(GDBusClient *client)
+{
+    bluez_client_t *c = client_of(client);
+
+    if (c->objects != NULL)
+        dbus_message_unref(c->objects);
+    c->objects = NULL;
+
+    if (c->objects_touched != NULL)
+        g_hash_table_destroy(c->objects_touched);
+    c->objects_touched = NULL;
+}
+
+// Parses a whole reply in one go.
+void parse_managed_objects(GDBusClient *client, DBusMessage *msg)
+{
+    if (parse_objects_begin(client, msg) == FALSE)
+        return;
+
+    parse_objects_step(client, 0);
+    parse_objects_finish(client);
+}
+
+static void parse_objects_cancel(GDBusClient *client)
+{
+    bluez_client_t *c = client_of(client);
+
+    if (c->objects_source != NULL)
+    {
+        g_source_destroy(c->objects_source);
+        g_source_unref(c->objects_source);
+        c->objects_source = NULL;
     }
+
+    parse_objects_finish(client);
 }
 
-static void get_managed_objects_reply(DBusPendingCall *call, void *user_data)
+// Parses the reply one slice at a time from an idle source, so a large
+// object tree does not hold up notifications and timers.  Ready is
+// signalled once the last object has been parsed.
+static gboolean parse_objects_idle(gpointer user_data)
 {
     GDBusClient *client = user_data;
-    DBusMessage *reply = dbus_pending_call_steal_reply(call);
+    bluez_client_t *c = client_of(client);
+
+    if (parse_objects_step(client, g_get_monotonic_time() + OBJECTS_SLICE_US) == TRUE)
+        return TRUE;
+
+    parse_objects_finish(client);
+    g_source_unref(c->objects_source);
+    c->objects_source = NULL;
+
+    startup_end(c, STARTUP_OBJECTS_PARSE);
+
+    if (c->ready)
+            c->ready(c);
+
+    return FALSE;
+}
+
+// GetManagedObjects in flight.  'client' is cleared when the call is
+// abandoned, and the reply is then ignored.
+struct objects_call
+{
+    struct transport_call call;
+    GDBusClient *client;
+};
+
+static void get_managed_objects_reply(DBusMessage *reply, struct transport_call *call)
+{
+    GDBusClient *client = ((struct objects_call *)call)->client;
+    bluez_client_t *c;
     DBusError error;
 
+    if (client == NULL)
+            return;
+
+    c = client_of(client);
+
     dbus_error_init(&error);
 
+    startup_end(c, STARTUP_OBJECTS_CALL);
+    startup_begin(c, STARTUP_OBJECTS_PARSE);
+
+    // A reply to an earlier request may still be being parsed if the
+    // daemon restarted.  Start again from this one.
+    parse_objects_cancel(client);
+
     if (dbus_set_error_from_message(&error, reply) == TRUE)
         dbus_error_free(&error);
 
     // When this calls through to parse_properties(), that function
     // will filter for only objects we are interested in.
-    else
-        parse_managed_objects(client, reply);
+    else if (parse_objects_begin(client, reply) == TRUE)
+    {
+        c->objects_source = g_idle_source_new();
+        g_source_set_callback(c->objects_source, parse_objects_idle, client, NULL);
+        g_source_attach(c->objects_source, c->context);
+    }
+
+    if (c->objects_source == NULL)
+    {
+            startup_end(c, STARTUP_OBJECTS_PARSE);
+            if (c->ready)
+                    c->ready(c);
+    }
+}
 
-    if (client->ready)
-            client->ready(client, NULL);
+static void objects_call_free(struct transport_call *call)
+{
+    struct objects_call *objects = (struct objects_call *)call;
 
-    dbus_message_unref(reply);
+    if (objects->client != NULL && objects->client->get_objects_call == objects)
+            objects->client->get_objects_call = NULL;
 
-    dbus_pending_call_unref(client->get_objects_call);
-    client->get_objects_call = NULL;
+    g_free(objects);
 }
 
 // Call the "GetManagedObjects" method on the org.bluez root path.  This
@@ -869,8 +1505,14 @@ static void get_managed_objects_reply(DBusPendingCall *call, void *user_data)
 // device and all of its services and characteristics, so we can capture
 // them now to the proxies provided for them in this module even though
 // we probably aren't connected to the device yet.
+//
+// The call goes through the client's transport, on the connection that
+// also carries the InterfacesAdded and PropertiesChanged signals, so the
+// reply is ordered with them.
 static void get_managed_objects(GDBusClient *client)
 {
+    bluez_client_t *c = client_of(client);
+    struct objects_call *objects;
     DBusMessage *msg;
 
     if (!client->connected)
@@ -888,29 +1530,48 @@ static void get_managed_objects(GDBusClient *client)
 
     dbus_message_append_args(msg, DBUS_TYPE_INVALID);
 
-    if (g_dbus_send_message_with_reply(client->dbus_conn, msg,
-                            &client->get_objects_call, -1) == FALSE) {
+    objects = g_new0(struct objects_call, 1);
+    objects->call.reply = get_managed_objects_reply;
+    objects->call.free = objects_call_free;
+    objects->client = client;
+
+    if (c->transport->call(c->transportConn, msg, -1, &objects->call) == FALSE) {
+            g_free(objects);
             dbus_message_unref(msg);
             return;
     }
 
-    dbus_pending_call_set_notify(client->get_objects_call,
-                                            get_managed_objects_reply,
-                                            client, NULL);
+    client->get_objects_call = objects;
+
+    startup_begin(c, STARTUP_OBJECTS_CALL);
 
     dbus_message_unref(msg);
 }
 
 static void service_connect(DBusConnection *conn, void *user_data)
 {
-    btClient.connected = TRUE;
+    GDBusClient *client = user_data;
+
+    client->connected = TRUE;
 
-    get_managed_objects(&btClient);
+    startup_end(client_of(client), STARTUP_SERVICE_CONNECT);
+
+    get_managed_objects(client);
 }
 
 static void service_disconnect(DBusConnection *conn, void *user_data)
 {
-    btClient.connected = FALSE;
+    GDBusClient *client = user_data;
+
+    client->connected = FALSE;
+
+    parse_objects_cancel(client);
+
+    // The daemon's object tree starts afresh when it comes back.  Bound
+    // proxies keep their watches and are matched up again by the next
+    // GetManagedObjects.
+    reject_cache_clear(&client_of(client)->rejected);
+    object_tree_clear(&client_of(client)->objects_mirror);
 }
 
 // End functions extracted from Bluez module gdbus/client.c.
@@ -921,12 +1582,160 @@ static void service_disconnect(DBusConnection *conn, void *user_data)
 // gdbus/client.c) or are newly authored convenience functions to minimize
 // hair-pulling trying to keep DBus message parsing straight.
 
-static void bluez_add_property(GDBusProxy *proxy, const char *name,
+// Smooths an RSSI sample and says whether it should be reported.
+static gboolean rssi_filter_pass(bluez_client_t *client, int rssi)
+{
+    struct bluez_rssi_filter *filter = &client->rssiFilter;
+    gint64 now = g_get_monotonic_time();
+
+    if (!client->rssiPrimed)
+    {
+        client->rssiPrimed = TRUE;
+        client->rssiSmoothed = rssi * 256;
+    }
+    else
+    {
+        client->rssiSmoothed += (rssi * 256 - client->rssiSmoothed) * filter->smoothing / 100;
+
+        if (abs(client->rssiSmoothed / 256 - client->rssiReported) < filter->hysteresis)
+            return FALSE;
+
+        if (now - client->rssiReportedAt < (gint64)filter->minInterval * 1000)
+            return FALSE;
+    }
+
+    client->rssiReported = client->rssiSmoothed / 256;
+    client->rssiReportedAt = now;
+
+    return TRUE;
+}
+
+static struct prop_entry *prop_entry_find(GDBusProxy *proxy, const char *name)
+{
+    int i;
+
+    for (i = 0; i < MAX_PROPERTIES; i++)
+    {
+        if (!strcmp(proxy->property[i].name, ""))
+            break;
+
+        if (!strcmp(proxy->property[i].name, name))
+            return &(proxy->property[i]);
+    }
+
+    return NULL;
+}
+
+static gboolean basic_equal(int type, const DBusBasicValue *a, const DBusBasicValue *b)
+{
+    switch (type)
+    {
+        case DBUS_TYPE_BYTE:
+            return a->byt == b->byt;
+        case DBUS_TYPE_BOOLEAN:
+            return a->bool_val == b->bool_val;
+        case DBUS_TYPE_INT16:
+        case DBUS_TYPE_UINT16:
+            return a->u16 == b->u16;
+        case DBUS_TYPE_INT32:
+        case DBUS_TYPE_UINT32:
+        case DBUS_TYPE_UNIX_FD:
+            return a->u32 == b->u32;
+        case DBUS_TYPE_INT64:
+        case DBUS_TYPE_UINT64:
+        case DBUS_TYPE_DOUBLE:
+            return a->u64 == b->u64;
+        default:
+            return !strcmp(a->str, b->str);
+    }
+}
+
+static gboolean iter_equal(DBusMessageIter *a, DBusMessageIter *b)
+{
+    DBusMessageIter subA, subB;
+    DBusBasicValue valueA, valueB;
+    int type;
+
+    while ((type = dbus_message_iter_get_arg_type(a)) == dbus_message_iter_get_arg_type(b))
+    {
+        if (type == DBUS_TYPE_INVALID)
+            return TRUE;
+
+        if (dbus_type_is_basic(type))
+        {
+            dbus_message_iter_get_basic(a, &valueA);
+            dbus_message_iter_get_basic(b, &valueB);
+            if (basic_equal(type, &valueA, &valueB) == FALSE)
+                return FALSE;
+        }
+        else
+        {
+            dbus_message_iter_recurse(a, &subA);
+            dbus_message_iter_recurse(b, &subB);
+            if (iter_equal(&subA, &subB) == FALSE)
+                return FALSE;
+        }
+
+        dbus_message_iter_next(a);
+        dbus_message_iter_next(b);
+    }
+
+    return FALSE;
+}
+
+// Says whether 'iter' holds the value already cached in 'prop'.
+static gboolean prop_entry_equal(const struct prop_entry *prop, DBusMessageIter *iter)
+{
+    int type = dbus_message_iter_get_arg_type(iter);
+    DBusMessageIter cached, value;
+    DBusBasicValue basic;
+
+    if (prop->type != type)
+        return FALSE;
+
+    if (prop->msg == NULL)
+    {
+        if (dbus_type_is_fixed(type) == FALSE)
+            return FALSE;
+
+        dbus_message_iter_get_basic(iter, &basic);
+        return basic_equal(type, &prop->value, &basic);
+    }
+
+    value = *iter;
+    dbus_message_iter_init(prop->msg, &cached);
+
+    return iter_equal(&cached, &value);
+}
+
+// Fills in 'value' from the cached property.  Strings point into the
+// cached message.
+static void prop_entry_value(const struct prop_entry *prop, struct bluez_property_value *value)
+{
+    DBusMessageIter iter;
+
+    value->type = prop->type;
+    value->value = prop->value;
+
+    if (prop->msg != NULL && dbus_message_iter_init(prop->msg, &iter) &&
+        dbus_type_is_basic(prop->type))
+        dbus_message_iter_get_basic(&iter, &value->value);
+}
+
+// Caches a property value and reports it to the application if it
+// changed.  Updates repeating the cached value are dropped here, since
+// BlueZ resends unchanged properties, Connected in particular.  The
+// device's RSSI is the exception: every sample goes to the RSSI filter,
+// which decides what is reported.
+void bluez_add_property(GDBusProxy *proxy, const char *name,
 				DBusMessageIter *iter, gboolean send_changed)
 {
     GDBusClient *client = proxy->client;
+    struct bluez_property_value old, new;
+    struct prop_entry *prop;
+    DBusMessage *oldMsg;
     DBusMessageIter value;
-    int i;
+    gboolean rssiSample, unchanged;
 
     if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_VARIANT)
             return;
@@ -946,41 +1755,225 @@ static void bluez_add_property(GDBusProxy *proxy, const char *name,
 // end experiment
     dbus_message_iter_recurse(iter, &value);
 
-    for (i = 0; i < MAX_PROPERTIES; i++)
+    BLE_PROBE3(add_property, proxy->obj_path, name, dbus_message_iter_get_arg_type(&value));
+
+    prop = prop_entry_find(proxy, name);
+    if (prop == NULL)
     {
-        if (!strcmp(proxy->property[i].name, ""))
+//        fprintf(stderr, "Attempting to add unsupported property %s\n", name);
+        return;
+    }
+
+    // Device RSSI samples go to the filter even when they repeat the
+    // cached sample, since each one still moves the smoothed value.
+    rssiSample = client != NULL && send_changed &&
+                 proxy == &client_of(client)->proxy[BLUEZ_PROXY_DEVICE] &&
+                 DBUS_TYPE_INT16 == dbus_message_iter_get_arg_type(&value) &&
+                 !strcmp(name, "RSSI");
+
+    unchanged = prop_entry_equal(prop, &value);
+    if (unchanged && !rssiSample)
+    {
+        if (send_changed)
+            bluez_metrics_inc(METRIC_PROPERTY_UNCHANGED);
+        return;
+    }
+
+    // The old value stays readable until the application has seen it.
+    oldMsg = prop->msg ? dbus_message_ref(prop->msg) : NULL;
+    prop_entry_value(prop, &old);
+
+    if (!unchanged)
+    {
+        prop->type = dbus_message_iter_get_arg_type(&value);
+        prop_entry_update(prop, &value);
+
+        if (proxy->prop_func)
+                proxy->prop_func(proxy, name, &value, proxy->prop_data);
+    }
+
+    if (client == NULL || send_changed == FALSE)
+            goto done;
+
+    prop_entry_value(prop, &new);
+    if (!unchanged)
+    {
+        startup_property(client_of(client), name, &new);
+        if (client_of(client)->watchdog)
+            watchdog_property(client_of(client), name, &new);
+    }
+
+    if (rssiSample)
+    {
+        bluez_client_t *c = client_of(client);
+        gboolean primed = c->rssiPrimed;
+        int reported = c->rssiReported;
+        dbus_int16_t rssi;
+
+        dbus_message_iter_get_basic(&value, &rssi);
+        if (rssi_filter_pass(c, rssi) == FALSE)
         {
-//            fprintf(stderr, "Attempting to add unsupported property %s\n", name);
-            return;
+            bluez_metrics_inc(METRIC_RSSI_SUPPRESSED);
+            goto done;
         }
-        if (!strcmp(proxy->property[i].name, name))
+
+        // Report what the filter passed, the smoothed value, against the
+        // value reported before it rather than the last raw sample.
+        new.value.i16 = c->rssiReported;
+        if (primed)
         {
-            proxy->property[i].type = dbus_message_iter_get_arg_type(&value);
-            prop_entry_update(&(proxy->property[i]), &value);
-            break;
+            old.type = DBUS_TYPE_INT16;
+            old.value.i16 = reported;
         }
     }
 
-    if (proxy->prop_func)
-            proxy->prop_func(proxy, name, &value, proxy->prop_data);
+    if (client->propertyCallback)
+        client->propertyCallback(client_of(client), proxy->interface, name, &old, &new);
 
-    if (client == NULL || send_changed == FALSE)
-            return;
+done:
+    if (oldMsg != NULL)
+        dbus_message_unref(oldMsg);
+}
 
-    if (client->propertyCallback)
+// Drops the cached value of a property the daemon has invalidated, and
+// reports it as having no value.
+void bluez_invalidate_property(GDBusProxy *proxy, const char *name)
+{
+    GDBusClient *client = proxy->client;
+    struct bluez_property_value old, new;
+    struct prop_entry *prop;
+    DBusMessage *oldMsg;
+
+    prop = prop_entry_find(proxy, name);
+    if (prop == NULL || prop->type == DBUS_TYPE_INVALID)
+        return;
+
+    prop_entry_value(prop, &old);
+    oldMsg = prop->msg;
+
+    prop->type = DBUS_TYPE_INVALID;
+    prop->msg = NULL;
+
+    memset(&new, 0, sizeof(new));
+    new.type = DBUS_TYPE_INVALID;
+
+    if (client != NULL && client->propertyCallback)
+        client->propertyCallback(client_of(client), proxy->interface, name, &old, &new);
+
+    if (oldMsg != NULL)
+        dbus_message_unref(oldMsg);
+}
+
+// Unbinds a proxy from its object: the property watch is removed and the
+// cached properties are dropped.  If 'report' is TRUE and the device was
+// connected, the property callback sees it disconnect, so the
+// application recovers as it would from a disconnect.
+static void proxy_invalidate(GDBusProxy *proxy, gboolean report)
+{
+    GDBusClient *client = proxy->client;
+    gboolean wasConnected = FALSE;
+    int i;
+
+    if (client == NULL)
+        return;
+
+    if (proxy == &client_of(client)->proxy[BLUEZ_PROXY_DEVICE])
+        bluez_read_property_boolean(proxy, "Connected", &wasConnected);
+
+    if (proxy->watch)
     {
-        int i = FALSE;
-        if (DBUS_TYPE_BOOLEAN == dbus_message_iter_get_arg_type(&value))
-        {
-            dbus_bool_t b;
-            dbus_message_iter_get_basic(&value, &b);
-            if (b)  i = TRUE;
-        }
-        else i = -1;
-        client->propertyCallback(proxy->interface, name, i);
+        bluez_gdbus_lock();
+        client_of(client)->transport->remove_watch(client_of(client)->transportConn,
+                                                   proxy->watch);
+        bluez_gdbus_unlock();
+    }
+    proxy->watch = 0;
+
+    for (i = 0; i < MAX_PROPERTIES && strcmp(proxy->property[i].name, ""); i++)
+    {
+        proxy->property[i].type = DBUS_TYPE_INVALID;
+        if (proxy->property[i].msg != NULL)
+            dbus_message_unref(proxy->property[i].msg);
+        proxy->property[i].msg = NULL;
+    }
+
+    proxy->obj_path[0] = '\0';
+    proxy->client = NULL;
+    proxy->pending = FALSE;
+
+    if (report && wasConnected && client_of(client)->watchdog)
+        watchdog_stop(client_of(client));
+
+    if (report && wasConnected && client->propertyCallback)
+    {
+        struct bluez_property_value old, new;
+
+        old.type = new.type = DBUS_TYPE_BOOLEAN;
+        old.value.bool_val = TRUE;
+        new.value.bool_val = FALSE;
+        client->propertyCallback(client_of(client), "org.bluez.Device1", "Connected",
+                                 &old, &new);
     }
 }
 
+// Records an accepted object in the mirror.  Rejected devices are left
+// to the negative cache.
+static void bluez_mirror_add(GDBusClient *client, const char *path,
+                             const char *interface, GDBusProxy *proxy)
+{
+    bluez_client_t *c = client_of(client);
+    struct object_node *node;
+    unsigned iface = object_tree_iface(interface);
+
+    if (iface == 0 || (iface == OBJECT_IFACE_DEVICE && proxy == NULL))
+        return;
+
+    node = object_tree_insert(&c->objects_mirror, path);
+    if (node == NULL)
+        return;
+
+    node->ifaces |= iface;
+    if (proxy != NULL)
+        node->role = proxy - c->proxy;
+}
+
+static void invalidate_node(struct object_node *node, void *user_data)
+{
+    bluez_client_t *c = user_data;
+
+    if (node->role >= 0)
+        proxy_invalidate(&c->proxy[node->role], TRUE);
+    node->role = -1;
+}
+
+static void bluez_mirror_remove(GDBusClient *client, const char *path,
+                                const char *interface)
+{
+    bluez_client_t *c = client_of(client);
+    struct object_node *node;
+    unsigned iface = object_tree_iface(interface);
+
+    if (iface == 0)
+        return;
+
+    node = object_tree_lookup(&c->objects_mirror, path);
+    if (node == NULL)
+        return;
+
+    node->ifaces &= ~iface;
+
+    if (node->role >= 0 && !strcmp(c->proxy[node->role].interface, interface))
+        invalidate_node(node, c);
+
+    if (node->ifaces != 0)
+        return;
+
+    // BlueZ removes children before their parent, but anything still
+    // bound below an object that has gone goes with it.
+    object_tree_foreach(node, invalidate_node, c);
+    object_tree_remove(&c->objects_mirror, node);
+}
+
 static void bluez_discovery_filter_setup(DBusMessageIter *iter, void *user_data)
 {
     // Sets filter to only one UUID, defined as UUID_DEVICE
@@ -1016,16 +2009,14 @@ static void bluez_discovery_filter_reply(DBusMessage *message, void *user_data)
     }
 }
 
-static void bluez_discovery_filter(void)
+static void bluez_discovery_filter(bluez_client_t *client)
 {
-    static gboolean filterSet = FALSE;
-    
-    if (filterSet)
+    if (client->filterSet)
 	return;
 
     fprintf(stderr, "Setting discovery filter now...\n");
     
-    if (g_dbus_proxy_method_call(&adapter, "SetDiscoveryFilter",
+    if (g_dbus_proxy_method_call(&client->proxy[BLUEZ_PROXY_ADAPTER], "SetDiscoveryFilter",
             bluez_discovery_filter_setup, bluez_discovery_filter_reply,
             NULL, NULL) == FALSE)
     {
@@ -1033,43 +2024,21 @@ static void bluez_discovery_filter(void)
         return;
     }
 
-    filterSet = TRUE;
+    client->filterSet = TRUE;
 }
 
-static gboolean bluez_proxy_get_property(GDBusProxy *proxy, const char *name,
-                                                        DBusMessageIter *iter)
+static struct prop_entry *bluez_proxy_get_property(GDBusProxy *proxy, const char *name)
 {
-    struct prop_entry *prop = NULL;
-    int i;
+    struct prop_entry *prop;
 
     if (proxy == NULL || name == NULL)
-            return FALSE;
-
-    for (i = 0; i < MAX_PROPERTIES; i++)
-    {
-        if (!strcmp(proxy->property[i].name, ""))
-            break;
-
-        if (!strcmp(proxy->property[i].name, name))
-        {
-            prop = &(proxy->property[i]);
-            break;
-        }
-    }
+            return NULL;
 
+    prop = prop_entry_find(proxy, name);
     if (prop == NULL)
-    {
         fprintf(stderr, "Property %s->%s not found.\n", proxy->obj_path, name);
-        return FALSE;
-    }
-
-    if (prop->msg == NULL)
-            return FALSE;
-
-    if (dbus_message_iter_init(prop->msg, iter) == FALSE)
-            return FALSE;
 
-    return TRUE;
+    return prop;
 }
 
 
@@ -1080,25 +2049,46 @@ static GDBusProxy *bluez_screen_interface(GDBusClient *client, const char *path,
     GDBusProxy *proxy = NULL;
     
     if (!strcmp(interface, "org.bluez.Adapter1"))
-        proxy = &adapter;
+        proxy = &client_of(client)->proxy[BLUEZ_PROXY_ADAPTER];
 
     else if (!strcmp(interface, "org.bluez.Device1"))
     {
         if (TRUE == bluez_screen_uuid(iter, UUID_DEVICE))
-            proxy = &device;
+            proxy = &client_of(client)->proxy[BLUEZ_PROXY_DEVICE];
+        else
+            reject_cache_add(&client_of(client)->rejected, path);
     }
 
     else if (!strcmp(interface, "org.bluez.GattCharacteristic1"))
     {
         DBusMessageIter *copy = iter;
         if (TRUE == bluez_screen_uuid(iter, UUID_CHARACTERISTIC_RD))
-            proxy = &characteristicRd;
+            proxy = &client_of(client)->proxy[BLUEZ_PROXY_CHARACTERISTIC_RD];
         else if (TRUE == bluez_screen_uuid(copy, UUID_CHARACTERISTIC_WR))
-            proxy = &characteristicWr;
+            proxy = &client_of(client)->proxy[BLUEZ_PROXY_CHARACTERISTIC_WR];
     }
 
     if (NULL == proxy)
         return NULL;
+
+    if (proxy->client != NULL && proxy->watch)
+    {
+        struct object_node *old;
+
+        // Already bound to this object, as when InterfacesAdded repeats
+        // what GetManagedObjects said.  Keep the watch.
+        if (!strcmp(proxy->obj_path, path))
+            return proxy;
+
+        // Another object replaces the one bound.
+        old = object_tree_lookup(&client_of(client)->objects_mirror, proxy->obj_path);
+        if (old != NULL)
+        {
+            old->role = -1;
+            object_tree_prune(&client_of(client)->objects_mirror, old);
+        }
+        proxy_invalidate(proxy, FALSE);
+    }
     
     proxy->client = client;
     // "/org/bluez/hci0"
@@ -1111,12 +2101,15 @@ static GDBusProxy *bluez_screen_interface(GDBusClient *client, const char *path,
     // "org.bluez.GattCharacteristic1"
     strncpy(proxy->interface, interface, MAX_BLUEZ_INTERFACE);
 
-    proxy->watch = g_dbus_add_properties_watch(dbus_conn,
+    bluez_gdbus_lock();
+    proxy->watch = client_of(client)->transport->add_properties_watch(
+                                                    client_of(client)->transportConn,
                                                     BLUEZ_SERVICE,
                                                     proxy->obj_path,
                                                     proxy->interface,
                                                     properties_changed,
                                                     proxy, NULL);
+    bluez_gdbus_unlock();
     proxy->pending = TRUE;
     
     return proxy;
@@ -1124,7 +2117,7 @@ static GDBusProxy *bluez_screen_interface(GDBusClient *client, const char *path,
 
 // Dive down into a property (dictionary type) looking for the UUID.
 // If the UUID matches one we want, return TRUE.
-static gboolean bluez_screen_uuid(DBusMessageIter *iter, const char *uuidWanted)
+gboolean bluez_screen_uuid(DBusMessageIter *iter, const char *uuidWanted)
 {
     DBusMessageIter entry;
 
@@ -1186,87 +2179,306 @@ static gboolean bluez_screen_uuid(DBusMessageIter *iter, const char *uuidWanted)
 }
 
 
-void bluez_client_init(DBusConnection *connection, const char *service,
-        const char *path, GDBusClientFunction ready)
+static void proxy_init(GDBusProxy *proxy, const char *const *names)
 {
-    if (!connection || !service)
-            return;
+    int i;
+
+    for (i = 0; i < MAX_PROPERTIES; i++)
+    {
+        proxy->property[i].name = names[i];
+        if (!strcmp(names[i], ""))
+            break;
+    }
+}
+
+bluez_client_t *bluez_client_new(GMainContext *context, void *user_data)
+{
+    bluez_client_t *client;
+    int i;
+
+    client = g_new0(bluez_client_t, 1);
+
+    client->gdbus.service_name = BLUEZ_SERVICE;
+    client->gdbus.base_path = BLUEZ_PATH;
+    client->gdbus.root_path = ROOT_PATH;
+    client->gdbus.connected = FALSE;
+
+    for (i = 0; i < BLUEZ_PROXY_COUNT; i++)
+        proxy_init(&client->proxy[i], proxy_properties[i]);
+
+    // NULL selects the global default context, as used by a single client
+    // running on the program's main thread.
+    if (context == NULL)
+        context = g_main_context_default();
 
-    btClient.dbus_conn = dbus_connection_ref(connection);
+    client->context = g_main_context_ref(context);
+    client->loop = g_main_loop_new(client->context, FALSE);
+    client->user_data = user_data;
+    client->startup.fd = -1;
+    client->transport = bluez_transport_get(BLUEZ_TRANSPORT_LIBDBUS);
 
-    // This call increments the connection reference count by 3.
-    btClient.watch = g_dbus_add_service_watch(connection, service,
+    command_queue_init(client);
+
+    bluez_slab_init(&client->callSlab, sizeof(struct method_call_data), 16);
+
+    bluez_set_rssi_filter(client, NULL);
+    reject_cache_clear(&client->rejected);
+    object_tree_init(&client->objects_mirror);
+    bluez_slab_init(&client->commandSlab, command_call_size(), COMMAND_QUEUE_SIZE);
+
+    return client;
+}
+
+void bluez_client_free(bluez_client_t *client)
+{
+    int i, j;
+
+    if (client == NULL)
+        return;
+
+    for (i = 0; i < BLUEZ_PROXY_COUNT; i++)
+    {
+        for (j = 0; j < MAX_PROPERTIES; j++)
+        {
+            if (client->proxy[i].property[j].msg != NULL)
+                dbus_message_unref(client->proxy[i].property[j].msg);
+        }
+    }
+
+    command_queue_destroy(client);
+
+    poll_engine_free(client);
+
+    wakeup_free(client);
+
+    watchdog_free(client);
+
+    framing_free(client);
+
+    notify_buffer_free(client);
+
+    uring_free(client->uring);
+
+    object_tree_destroy(&client->objects_mirror);
+
+    bluez_slab_destroy(&client->callSlab);
+    bluez_slab_destroy(&client->commandSlab);
+
+    g_main_loop_unref(client->loop);
+    g_main_context_unref(client->context);
+    g_free(client);
+}
+
+// Opens a private connection to the given bus, bound to the client's
+// context, and starts watching the BlueZ daemon.
+gboolean bluez_client_init(bluez_client_t *client, DBusBusType bus,
+        const char *service, const char *path, ClientReadyCallback ready)
+{
+    DBusConnection *connection;
+
+    if (!client || !service)
+            return FALSE;
+
+    startup_start(client);
+    startup_begin(client, STARTUP_BUS_SETUP);
+
+    connection = bluez_setup_bus_uring(bus, client->context, client->uring);
+    if (connection == NULL)
+            return FALSE;
+
+    startup_end(client, STARTUP_BUS_SETUP);
+    startup_begin(client, STARTUP_SERVICE_CONNECT);
+
+    client->transportConn = client->transport->open(bus, client->context, connection);
+    if (client->transportConn == NULL)
+    {
+            bluez_close_bus(connection);
+            return FALSE;
+    }
+
+    client->gdbus.dbus_conn = connection;
+    client->ready = ready;
+
+    bluez_gdbus_lock();
+
+    client->gdbus.watch = client->transport->add_service_watch(client->transportConn,
+                                            service,
                                             service_connect,
                                             service_disconnect,
-                                            &btClient, NULL);
+                                            &client->gdbus, NULL);
 
-    // This call increments the connection reference count by 1.
-    btClient.added_watch = g_dbus_add_signal_watch(connection, service,
+    client->gdbus.added_watch = client->transport->add_signal_watch(client->transportConn,
+                                            service,
                                             ROOT_PATH,
                                             DBUS_INTERFACE_OBJECT_MANAGER,
                                             "InterfacesAdded",
                                             interfaces_added,
-                                            &btClient, NULL);
-    // This call increments the connection reference count by 1.
-    btClient.removed_watch = g_dbus_add_signal_watch(connection, service,
+                                            &client->gdbus, NULL);
+
+    client->gdbus.removed_watch = client->transport->add_signal_watch(client->transportConn,
+                                            service,
                                             ROOT_PATH,
                                             DBUS_INTERFACE_OBJECT_MANAGER,
                                             "InterfacesRemoved",
                                             interfaces_removed,
-                                            &btClient, NULL);
-    btClient.ready = ready;
+                                            &client->gdbus, NULL);
+
+    bluez_gdbus_unlock();
+
+    return TRUE;
 }
 
-void bluez_client_exit(void)
+void bluez_client_exit(bluez_client_t *client)
 {
+    GDBusClient *gdbus = &client->gdbus;
+    int i;
+
     // It is safe to call this if the notification io has already been destroyed.
-    notify_io_destroy();
+    notify_io_destroy(&client->notify_io);
+    write_io_close(client);
+
+    parse_objects_cancel(gdbus);
+
+    if (gdbus->dbus_conn == NULL)
+        return;
 
-    if (btClient.pending_call != NULL)
+    if (gdbus->get_objects_call != NULL)
     {
-        dbus_pending_call_cancel(btClient.pending_call);
-        dbus_pending_call_unref(btClient.pending_call);
+        gdbus->get_objects_call->client = NULL;
+        gdbus->get_objects_call = NULL;
     }
 
-    if (btClient.get_objects_call != NULL)
+    bluez_gdbus_lock();
+
+    for (i = 0; i < BLUEZ_PROXY_COUNT; i++)
     {
-        dbus_pending_call_cancel(btClient.get_objects_call);
-        dbus_pending_call_unref(btClient.get_objects_call);
+        if (client->proxy[i].watch)
+            client->transport->remove_watch(client->transportConn, client->proxy[i].watch);
+        client->proxy[i].watch = 0;
     }
 
-    g_dbus_remove_watch(btClient.dbus_conn, btClient.watch);
-    g_dbus_remove_watch(btClient.dbus_conn, btClient.added_watch);
-    g_dbus_remove_watch(btClient.dbus_conn, btClient.removed_watch);
+    client->transport->remove_watch(client->transportConn, gdbus->watch);
+    client->transport->remove_watch(client->transportConn, gdbus->added_watch);
+    client->transport->remove_watch(client->transportConn, gdbus->removed_watch);
+
+    bluez_gdbus_unlock();
+
+    client->transport->close(client->transportConn);
+    client->transportConn = NULL;
+
+    // The connection is private to this client, so closing it releases
+    // every reference the BlueZ helper code took on it.
+    bluez_close_bus(gdbus->dbus_conn);
+    gdbus->dbus_conn = NULL;
+}
 
-    dbus_connection_unref(btClient.dbus_conn);
+// Runs the client's main loop on the calling thread until
+// bluez_client_quit() is called.  The client's context is made the
+// thread-default context for the duration.
+void bluez_client_run(bluez_client_t *client)
+{
+    g_main_context_push_thread_default(client->context);
+    g_main_loop_run(client->loop);
+    g_main_context_pop_thread_default(client->context);
 }
 
-void bluez_set_property_change_fn(PropertyCallback fn)
+// Safe to call from any thread.
+void bluez_client_quit(bluez_client_t *client)
 {
-    btClient.propertyCallback = fn;
+    g_main_loop_quit(client->loop);
+}
+
+// Selects the event backend, BLUEZ_BACKEND_GLIB or BLUEZ_BACKEND_URING,
+// see bleUring.c.  Call before bluez_client_init().  Returns FALSE,
+// leaving the client on the GLib backend, if io_uring was not built in or
+// the kernel does not support it.
+gboolean bluez_client_set_backend(bluez_client_t *client, int backend)
+{
+    if (client->gdbus.dbus_conn != NULL)
+        return FALSE;
+
+    if (backend == BLUEZ_BACKEND_GLIB)
+    {
+        uring_free(client->uring);
+        client->uring = NULL;
+        return TRUE;
+    }
+
+    if (backend != BLUEZ_BACKEND_URING)
+        return FALSE;
+
+    if (client->uring == NULL)
+        client->uring = uring_new(client->context);
+
+    return client->uring != NULL;
+}
+
+// Copies the ring's counters.  All zero on the GLib backend.
+void bluez_get_uring_stats(bluez_client_t *client, struct bluez_uring_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (client->uring != NULL)
+        uring_get_stats(client->uring, stats);
+}
+
+GMainContext *bluez_client_get_context(bluez_client_t *client)
+{
+    return client->context;
+}
+
+GDBusProxy *bluez_client_get_proxy(bluez_client_t *client, int which)
+{
+    if (which < 0 || which >= BLUEZ_PROXY_COUNT)
+        return NULL;
+
+    return &client->proxy[which];
+}
+
+void *bluez_client_get_user_data(bluez_client_t *client)
+{
+    return client->user_data;
+}
+
+void bluez_set_property_change_fn(bluez_client_t *client, PropertyCallback fn)
+{
+    client->gdbus.propertyCallback = fn;
+}
+
+// NULL selects the default: light smoothing, 4 dB hysteresis and at most
+// five reports a second.  Use { 100, 0, 0 } to report every update.
+void bluez_set_rssi_filter(bluez_client_t *client, const struct bluez_rssi_filter *filter)
+{
+    static const struct bluez_rssi_filter defaults = { 25, 4, 200 };
+
+    if (filter == NULL)
+        filter = &defaults;
+
+    client->rssiFilter = *filter;
+
+    if (client->rssiFilter.smoothing < 1 || client->rssiFilter.smoothing > 100)
+        client->rssiFilter.smoothing = 100;
 }
 
 // Returns non-zero if error encountered.  Otherwise sets 'yes' to the value of
 // the property.
 int bluez_read_property_boolean(GDBusProxy *proxy, const char *name, gboolean *yes)
 {
-    DBusMessageIter iter;
-    dbus_bool_t value; 
+    struct prop_entry *prop;
 
     if (NULL == yes)
         return 1;
 
     *yes = FALSE;
     
-    if (bluez_proxy_get_property(proxy, name, &iter) == FALSE)
+    prop = bluez_proxy_get_property(proxy, name);
+    if (prop == NULL)
         return 1;
 
-    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_BOOLEAN)
+    // Type is DBUS_TYPE_INVALID until the property has been received.
+    if (prop->type != DBUS_TYPE_BOOLEAN)
         return 1;
 
-    dbus_message_iter_get_basic(&iter, &value);
-    
-    if (value) *yes = TRUE;
+    if (prop->value.bool_val) *yes = TRUE;
     return 0;
 }
 
@@ -1283,9 +2495,8 @@ gboolean bluez_dbus_msg_recurse(DBusMessageIter *iter, DBusMessageIter *sub, int
     return TRUE;
 }
 
-static void bluez_set_property_reply(DBusPendingCall *call, void *user_data)
+static void bluez_set_property_reply(DBusMessage *reply, struct transport_call *call)
 {
-    DBusMessage *reply = dbus_pending_call_steal_reply(call);
     DBusError error;
 
     dbus_error_init(&error);
@@ -1294,19 +2505,28 @@ static void bluez_set_property_reply(DBusPendingCall *call, void *user_data)
         fprintf(stderr, "SetProperty failed: %s\n", error.name);
 
     dbus_error_free(&error);
+}
 
-    dbus_message_unref(reply);
+static void bluez_set_property_free(struct transport_call *call)
+{
+    g_free(call);
 }
 
+// Sets a property through the client's transport, like method calls, so
+// that the change is ordered with the signals reporting it.
 gboolean bluez_set_property(GDBusProxy *proxy, const char *name, int type, const void *value)
 {
+    bluez_client_t *owner;
     DBusMessage *msg;
     DBusMessageIter iter;
-    DBusPendingCall *call;
+    struct transport_call *call;
 
     if (proxy == NULL || name == NULL || value == NULL)
             return FALSE;
 
+    if (proxy->client == NULL)
+            return FALSE;
+
     if (dbus_type_is_basic(type) == FALSE)
             return FALSE;
 
@@ -1325,51 +2545,74 @@ gboolean bluez_set_property(GDBusProxy *proxy, const char *name, int type, const
 
     append_variant(&iter, type, value);
 
-    if (g_dbus_send_message_with_reply(btClient.dbus_conn, msg,
-                                                    &call, -1) == FALSE)
+    owner = client_of(proxy->client);
+
+    call = g_new0(struct transport_call, 1);
+    call->reply = bluez_set_property_reply;
+    call->free = bluez_set_property_free;
+
+    if (owner->transport->call(owner->transportConn, msg, -1, call) == FALSE)
     {
+            g_free(call);
             dbus_message_unref(msg);
             return FALSE;
     }
 
-    dbus_pending_call_set_notify(call, bluez_set_property_reply, NULL, NULL);
-    dbus_pending_call_unref(call);
-
     dbus_message_unref(msg);
 
     return TRUE;
 }
 
 // Connect to the one specific device we care about.
-gboolean bluez_connect(void)
+gboolean bluez_connect(bluez_client_t *client)
 {
-    return g_dbus_proxy_method_call(&device, "Connect", NULL, NULL, NULL, NULL);
+    startup_begin(client, STARTUP_CONNECT);
+
+    return g_dbus_proxy_method_call(&client->proxy[BLUEZ_PROXY_DEVICE], "Connect",
+                                    NULL, NULL, NULL, NULL);
+}
+
+// Disconnect from it.
+gboolean bluez_disconnect(bluez_client_t *client)
+{
+    return g_dbus_proxy_method_call(&client->proxy[BLUEZ_PROXY_DEVICE], "Disconnect",
+                                    NULL, NULL, NULL, NULL);
 }
 
 // Power the Bluetooth adapter on.
-void bluez_power_on(void)
+void bluez_power_on(bluez_client_t *client)
 {
     dbus_bool_t power = TRUE;
 
-    if (bluez_set_property(&adapter, "Powered", DBUS_TYPE_BOOLEAN, &power) == FALSE)
+    startup_begin(client, STARTUP_POWER_ON);
+
+    if (bluez_set_property(&client->proxy[BLUEZ_PROXY_ADAPTER], "Powered", DBUS_TYPE_BOOLEAN, &power) == FALSE)
         fprintf(stderr, "Failed to power adapter on.\n");
 }
 
 // Start / stop scan.  Searches for specific UUID set in bluez_discovery_filter().
-void bluez_scan(gboolean on)
+void bluez_scan(bluez_client_t *client, gboolean on)
 {
     const char *method;
     
     // Before starting scan, set filter to specific UUID
     if (on)
     {
-        bluez_discovery_filter();
+        // The first RSSI update of each scan always gets through.
+        client->rssiPrimed = FALSE;
+
+        bluez_discovery_filter(client);
 	method = "StartDiscovery";
+        startup_begin(client, STARTUP_SCAN);
     }
     else
+    {
         method = "StopDiscovery";
+        startup_end(client, STARTUP_SCAN);
+        startup_begin(client, STARTUP_SCAN_STOP);
+    }
 
-    if (g_dbus_proxy_method_call(&adapter, method,
+    if (g_dbus_proxy_method_call(&client->proxy[BLUEZ_PROXY_ADAPTER], method,
 			NULL, NULL, GUINT_TO_POINTER(on), NULL) == FALSE) 
     {
         fprintf(stderr, "Failed to %s discovery\n", on ? "start" : "stop");
@@ -3,7 +3,7 @@
 // Author: Paul DeKeyser
 //
 // Created  04/18/2018
-// Modified 04/21/2018
+// Modified 10/18/2026
 //
 // Declarations and definitions for interfacing to simplified Bluez bluetooth
 // client.
@@ -20,28 +20,301 @@ extern "C" {
 #define BLUEZ_PATH "/org/bluez"
 #define ROOT_PATH "/"
 
-// UUIDs for the single device and two characteristics this client deals with.    
+// UUIDs for the single device and two characteristics this client deals with.
 #define UUID_CHARACTERISTIC_RD "0003caa2-0000-1000-8000-00805f9b0131"
 #define UUID_CHARACTERISTIC_WR "0003cbb1-0000-1000-8000-00805f9b0131"
 #define UUID_DEVICE "0003cbbb-0000-1000-8000-00805f9b0131"
 
+// Proxies owned by each client, one for each supported interface.
+enum {
+    BLUEZ_PROXY_ADAPTER = 0,
+    BLUEZ_PROXY_DEVICE,
+    BLUEZ_PROXY_CHARACTERISTIC_RD,
+    BLUEZ_PROXY_CHARACTERISTIC_WR,
+    BLUEZ_PROXY_COUNT
+};
 
-typedef void (* PropertyCallback) (const char *interface, const char *name, int yes);
-typedef void (* NotificationCallback) (int);
+// Opaque handle owning all state for one client: its D-Bus connection,
+// proxies, notification pipe and main loop.  Independent clients may run
+// on separate threads as long as each is bound to its own GMainContext.
+typedef struct bluez_client bluez_client_t;
+
+// Shared-memory value segment, see bleShm.h.
+struct bluez_shm;
+
+// Datagram forwarder, see bleForward.c.
+struct bluez_forward;
+
+typedef void (* ClientReadyCallback) (bluez_client_t *client);
+
+// A property value as passed to a PropertyCallback.  'type' is its D-Bus
+// type, or DBUS_TYPE_INVALID if there is no value: not yet received, or
+// invalidated by the daemon.  Booleans and integers are held in 'value',
+// strings in value.str, valid only for the duration of the callback.
+struct bluez_property_value
+{
+    int type;
+    DBusBasicValue value;
+};
+
+// Called when a tracked property changes value, not for updates that
+// repeat the value already held.
+typedef void (* PropertyCallback) (bluez_client_t *client, const char *interface,
+                                   const char *name,
+                                   const struct bluez_property_value *old,
+                                   const struct bluez_property_value *value);
+
+typedef void (* NotificationCallback) (bluez_client_t *client, int value);
+
+// Notification watchdog, see bleWatchdog.c.  Times are in ms.
+struct bluez_watchdog
+{
+    int interval;           // expected gap between notifications, 0 to learn it
+    int factor;             // gaps without a notification before a stall
+    int minTimeout;         // shortest time without one before a stall
+    int stepTimeout;        // time each recovery step is given to work
+};
+
+// Framing of messages longer than one notification or write, see
+// bleFraming.c.
+struct bluez_framing
+{
+    size_t maxMessage;      // bytes, the size of the reassembly buffer
+    int timeout;            // ms to receive every fragment of a message
+};
+
+// Counts since framing was set up.  'discarded' counts partial messages
+// thrown away, 'timeouts' those of them that took too long, and
+// 'malformed' fragments that were short, too long for the buffer or
+// belonged to no message.
+struct bluez_framing_stats
+{
+    uint64_t messages;
+    uint64_t fragments;
+    uint64_t discarded;
+    uint64_t timeouts;
+    uint64_t malformed;
+};
+
+// Completion of a command submitted with bluez_submit_read() or
+// bluez_submit_write().  Runs on the client's thread.  'status' is 0 on
+// success or a negative errno value; 'data' holds the value read, if any.
+typedef void (* CommandCallback) (bluez_client_t *client, int status,
+                                  const uint8_t *data, size_t len, void *user_data);
+
+#define BLUEZ_COMMAND_MAX_DATA 512
+
+// A notification or polled value with its full payload, as delivered to
+// sample sinks.  'data' is valid only for the duration of the call.
+struct bluez_sample
+{
+    int source;             // BLUEZ_SOURCE_NOTIFY, or an ID from bluez_poll_add()
+    gint64 timestamp;       // g_get_monotonic_time() when received, us
+    const uint8_t *data;
+    size_t len;
+};
+
+#define BLUEZ_SOURCE_NOTIFY 0
+
+typedef void (* SampleCallback) (bluez_client_t *client, const struct bluez_sample *sample,
+                                 void *user_data);
+
+// Schedule for a characteristic polled with ReadValue.  The interval
+// doubles, up to 'maxInterval', each time the value comes back unchanged,
+// and drops back to 'interval' when it changes.  Each wait is varied at
+// random by up to 'jitter' percent.
+struct bluez_poll_config
+{
+    int interval;       // ms
+    int maxInterval;    // ms
+    int jitter;         // percent
+};
+
+// Packing of samples into datagrams by the forwarder.  A datagram is sent
+// when it is full, or at most 'deadline' ms after its first sample.
+struct bluez_forward_config
+{
+    size_t datagram;    // bytes
+    int deadline;       // ms
+};
+
+// Notification buffering, see bleBackpressure.c.  'capacity' is in
+// notifications, and so are the watermarks.  'spillDir' and 'spillMax'
+// apply to BLUEZ_BP_SPILL only, and default to the temporary directory
+// and 64 MB.
+enum {
+    BLUEZ_BP_DROP_OLDEST = 0,
+    BLUEZ_BP_DROP_NEWEST,
+    BLUEZ_BP_BLOCK,
+    BLUEZ_BP_SPILL
+};
+
+struct bluez_backpressure
+{
+    int policy;
+    size_t capacity;
+    size_t high;
+    size_t low;
+    const char *spillDir;
+    size_t spillMax;    // bytes
+};
+
+// Exact counts since buffering was set up.  'received' always equals
+// 'delivered' plus every dropped count plus 'buffered'.
+struct bluez_backpressure_stats
+{
+    uint64_t received;
+    uint64_t delivered;
+    uint64_t droppedOldest;
+    uint64_t droppedNewest;
+    uint64_t spillDropped;      // spill file full or unreadable
+    uint64_t spilled;           // written to the spill file, delivered later
+    uint64_t pauses;            // times reading stopped under BLUEZ_BP_BLOCK
+    uint64_t buffered;
+};
+
+// D-Bus transports, see bleTransport.h.
+enum {
+    BLUEZ_TRANSPORT_LIBDBUS = 0
+};
+
+// Event backends, see bleUring.c.
+enum {
+    BLUEZ_BACKEND_GLIB = 0,
+    BLUEZ_BACKEND_URING
+};
+
+// 'enters' counts io_uring_enter() calls, 'requests' the requests they
+// submitted and 'completions' the completions handled.
+struct bluez_uring_stats
+{
+    uint64_t enters;
+    uint64_t requests;
+    uint64_t completions;
+};
+
+// Counters for batched wakeups, see bleWakeup.c.  'wakeups' counts every
+// time the client thread woke for the notification pipe or the wakeup
+// timer, and 'batched' the values delivered on a timer wakeup.
+struct bluez_wakeup_stats
+{
+    uint64_t wakeups;
+    uint64_t ticks;             // timer wakeups
+    uint64_t batched;
+    double perSecond;           // wakeups per second since batching was set up
+};
+
+typedef void (* WatermarkCallback) (bluez_client_t *client, gboolean high, size_t buffered,
+                                    void *user_data);
+
+// Processing of the device's RSSI updates during discovery, before they
+// reach the property callback.  Each sample is smoothed, and the smoothed
+// value is reported only when it has moved by at least 'hysteresis' dB
+// and at least 'minInterval' ms after the previous report.  The first
+// update after discovery starts is always reported.  The callback's new
+// value is the smoothed RSSI, and its old value the one last reported.
+struct bluez_rssi_filter
+{
+    int smoothing;      // weight of each new sample in percent, 100 for none
+    int hysteresis;     // dB
+    int minInterval;    // ms
+};
 
 // Function prototypes
-void        bluez_acquire_notify            (NotificationCallback cb);
-void        bluez_client_init               (DBusConnection *connection, const char *service,
-                                             const char *path, GDBusClientFunction ready);
-void        bluez_client_exit               (void);
-gboolean    bluez_connect                   (void);
-void        bluez_power_on                  (void);
-int         bluez_read_property_boolean     (GDBusProxy *proxy, const char *name, gboolean *yes);
-void        bluez_scan                      (gboolean on);
-gboolean    bluez_set_property              (GDBusProxy *proxy, const char *name, int type, const void *value);
-void        bluez_set_property_change_fn    (PropertyCallback fn);
-void        bluez_write_attribute           (uint32_t value);
+void            bluez_acquire_notify            (bluez_client_t *client, NotificationCallback cb);
+void            bluez_acquire_write             (bluez_client_t *client);
+gboolean        bluez_add_sample_sink           (bluez_client_t *client, SampleCallback fn, void *user_data);
+void            bluez_client_exit               (bluez_client_t *client);
+void            bluez_client_free               (bluez_client_t *client);
+GMainContext *  bluez_client_get_context        (bluez_client_t *client);
+GDBusProxy *    bluez_client_get_proxy          (bluez_client_t *client, int which);
+void *          bluez_client_get_user_data      (bluez_client_t *client);
+gboolean        bluez_client_init               (bluez_client_t *client, DBusBusType bus,
+                                                 const char *service, const char *path,
+                                                 ClientReadyCallback ready);
+bluez_client_t *bluez_client_new                (GMainContext *context, void *user_data);
+void            bluez_client_quit               (bluez_client_t *client);
+void            bluez_client_run                (bluez_client_t *client);
+gboolean        bluez_client_set_backend        (bluez_client_t *client, int backend);
+gboolean        bluez_connect                   (bluez_client_t *client);
+gboolean        bluez_disconnect                (bluez_client_t *client);
+void            bluez_get_uring_stats           (bluez_client_t *client,
+                                                 struct bluez_uring_stats *stats);
+void            bluez_power_on                  (bluez_client_t *client);
+void            bluez_remove_sample_sink        (bluez_client_t *client, SampleCallback fn, void *user_data);
+int             bluez_read_property_boolean     (GDBusProxy *proxy, const char *name, gboolean *yes);
+void            bluez_scan                      (bluez_client_t *client, gboolean on);
+gboolean        bluez_set_property              (GDBusProxy *proxy, const char *name, int type, const void *value);
+void            bluez_set_property_change_fn    (bluez_client_t *client, PropertyCallback fn);
+void            bluez_set_rssi_filter           (bluez_client_t *client, const struct bluez_rssi_filter *filter);
+void            bluez_write_attribute           (bluez_client_t *client, uint32_t value);
+
+// bleBackpressure.c
+void            bluez_get_backpressure_stats    (bluez_client_t *client,
+                                                 struct bluez_backpressure_stats *stats);
+gboolean        bluez_set_backpressure          (bluez_client_t *client,
+                                                 const struct bluez_backpressure *config,
+                                                 WatermarkCallback watermark, void *user_data);
+
+// bleFraming.c
+void            bluez_get_framing_stats         (bluez_client_t *client,
+                                                 struct bluez_framing_stats *stats);
+gboolean        bluez_set_framing               (bluez_client_t *client,
+                                                 const struct bluez_framing *config);
+gboolean        bluez_write_message             (bluez_client_t *client, const uint8_t *data,
+                                                 size_t len);
+
+// bleStartup.c
+void            bluez_set_startup_report        (bluez_client_t *client, int fd);
+
+// bleTransport.c
+gboolean        bluez_client_set_transport      (bluez_client_t *client, int which);
+
+// bleWakeup.c
+void            bluez_get_wakeup_stats          (bluez_client_t *client,
+                                                 struct bluez_wakeup_stats *stats);
+gboolean        bluez_set_urgent                (bluez_client_t *client, int source, gboolean urgent);
+gboolean        bluez_set_wakeup_budget         (bluez_client_t *client, int budget);
+
+// bleWatchdog.c
+gboolean        bluez_set_watchdog              (bluez_client_t *client,
+                                                 const struct bluez_watchdog *config);
+
+// bleThread.c.  Unlike the functions above, which must be called on the
+// client's own thread, these may be called from any thread.
+gboolean        bluez_client_start              (bluez_client_t *client);
+void            bluez_client_stop               (bluez_client_t *client);
+gboolean        bluez_submit_read               (bluez_client_t *client, int which,
+                                                 CommandCallback cb, void *user_data);
+gboolean        bluez_submit_write              (bluez_client_t *client, int which,
+                                                 const uint8_t *data, size_t len,
+                                                 CommandCallback cb, void *user_data);
+
+// blePoll.c
+int             bluez_poll_add                  (bluez_client_t *client, const char *path,
+                                                 const struct bluez_poll_config *config);
+void            bluez_poll_remove               (bluez_client_t *client, int id);
+void            bluez_poll_set_pipeline         (bluez_client_t *client, int maxInFlight);
+
+// bleForward.c
+gboolean        bluez_forward_add_peer          (struct bluez_forward *fwd, const char *path);
+void            bluez_forward_free              (struct bluez_forward *fwd);
+struct bluez_forward *bluez_forward_new         (bluez_client_t *client,
+                                                 const struct bluez_forward_config *config);
+void            bluez_forward_sample            (bluez_client_t *client, const struct bluez_sample *sample,
+                                                 void *user_data);
+
+// bleShm.c
+struct bluez_shm *bluez_shm_create              (const char *name, int slots);
+void            bluez_shm_destroy               (struct bluez_shm *shm);
+void            bluez_shm_publish               (struct bluez_shm *shm, int source, gint64 timestamp,
+                                                 const uint8_t *data, size_t len);
+void            bluez_shm_sample                (bluez_client_t *client, const struct bluez_sample *sample,
+                                                 void *user_data);
 
+// bleMainloop.c
+void            bluez_close_bus                 (DBusConnection *connection);
+DBusConnection *bluez_setup_bus                 (DBusBusType type, GMainContext *context);
 
 
 #ifdef __cplusplus
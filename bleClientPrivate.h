@@ -0,0 +1,372 @@
+//
+// bleClientPrivate.h
+//
+// Created  10/18/2026
+//
+// Structures shared between the modules that make up the client.  Not for
+// use by applications, which see only the opaque bluez_client_t handle
+// declared in bleClient.h.
+
+#ifndef CLIENT_PRIVATE_H
+#define CLIENT_PRIVATE_H
+
+#include <stdatomic.h>
+
+#include "bleObjectTree.h"
+#include "bleRejectCache.h"
+#include "bleSlab.h"
+
+#define MAX_BLUEZ_PATH 64
+#define MAX_BLUEZ_INTERFACE 32
+#define MAX_PROPERTIES 4
+
+// Must be a power of two.
+#define COMMAND_QUEUE_SIZE 64
+
+#define MAX_SAMPLE_SINKS 8
+
+// Longest time the GetManagedObjects reply is parsed for before the main
+// loop gets to run other sources, in microseconds.
+#define OBJECTS_SLICE_US 2000
+
+// Most notifications read from the pipe per wakeup when they are buffered.
+#define NOTIFY_READ_BATCH 64
+
+struct objects_call;
+
+struct GDBusClient
+{
+	DBusConnection *dbus_conn;
+	char *service_name;
+	char *base_path;
+	char *root_path;
+	guint watch;
+	guint added_watch;
+	guint removed_watch;
+	struct objects_call *get_objects_call;
+	gboolean connected;
+	GDBusProxyFunction proxy_added;
+        PropertyCallback propertyCallback;
+};
+
+// Last value of a tracked property.  Fixed-size values are kept in
+// 'value', anything else as a message in 'msg'.
+struct prop_entry
+{
+	const char *name;
+	int type;
+	DBusBasicValue value;
+	DBusMessage *msg;
+};
+
+struct GDBusProxy
+{
+	GDBusClient *client;
+	char obj_path[MAX_BLUEZ_PATH];
+	char interface[MAX_BLUEZ_INTERFACE];
+        struct prop_entry property[MAX_PROPERTIES];  // leave room for properties in structure
+	guint watch;
+	GDBusPropertyFunction prop_func;
+	void *prop_data;
+	GDBusProxyFunction removed_func;
+	void *removed_data;
+	gboolean pending;
+};
+
+// Notification pipe handed out by AcquireNotify.  Watched by a unix fd
+// source attached to the owning client's context, or received from by
+// 'op' on the io_uring backend.
+struct pipe_io
+{
+	bluez_client_t *client;
+	GDBusProxy *proxy;
+	int fd;
+	GSource *source;
+	struct uring_op *op;
+	uint16_t mtu;
+        NotificationCallback cb;
+        gboolean paused;        // open, but not watched while the buffer is full
+};
+
+struct write_pending;
+
+// Write socket handed out by AcquireWrite.  On the GLib backend, values
+// it had no room for wait in 'head' to 'tail' until 'source' sees it
+// writable.
+struct write_io
+{
+	int fd;
+	uint16_t mtu;
+	gboolean acquired;
+	struct write_pending *head;
+	struct write_pending *tail;
+	GSource *source;
+};
+
+// Command submitted from an application thread, executed on the client's
+// thread.
+struct bluez_command
+{
+    int type;
+    int which;
+    CommandCallback cb;
+    void *user_data;
+    size_t len;
+    uint8_t data[BLUEZ_COMMAND_MAX_DATA];
+};
+
+// Bounded lock-free multi-producer, single-consumer queue.  Each cell's
+// sequence number says whether it is free for the producer claiming
+// position 'seq' or full for the consumer at position 'seq - 1'.
+struct command_cell
+{
+    atomic_size_t seq;
+    struct bluez_command cmd;
+};
+
+struct command_queue
+{
+    struct command_cell cell[COMMAND_QUEUE_SIZE];
+    atomic_size_t tail;             // next position claimed by a producer
+    size_t head;                    // next position read by the consumer
+    atomic_int signalled;           // eventfd already written, not yet drained
+    int efd;
+    GSource *source;
+};
+
+struct sample_sink
+{
+    SampleCallback fn;
+    void *user_data;
+};
+
+// Startup phases timed by bleStartup.c.
+enum {
+    STARTUP_BUS_SETUP = 0,
+    STARTUP_SERVICE_CONNECT,
+    STARTUP_OBJECTS_CALL,
+    STARTUP_OBJECTS_PARSE,
+    STARTUP_POWER_ON,
+    STARTUP_SCAN,
+    STARTUP_SCAN_STOP,
+    STARTUP_CONNECT,
+    STARTUP_SERVICES_RESOLVED,
+    STARTUP_ACQUIRE_NOTIFY,
+    STARTUP_FIRST_NOTIFICATION,
+    STARTUP_PHASES
+};
+
+// Monotonic times, zero until set.
+struct startup_profile
+{
+    gint64 origin;
+    gint64 begin[STARTUP_PHASES];
+    gint64 end[STARTUP_PHASES];
+    int fd;                     // report destination, -1 for none
+    gboolean done;
+};
+
+struct notify_buffer;
+struct poll_engine;
+struct wakeup_batch;
+struct notify_watchdog;
+struct frame_state;
+struct bluez_uring;
+struct uring_op;
+struct bluez_transport;
+
+// Completion of an io_uring request, see bleUring.c.
+typedef void (* UringCallback) (void *user_data, int res, const uint8_t *data);
+
+struct bluez_client
+{
+    // Must be the first member: the BlueZ-derived code hands around
+    // GDBusClient pointers, which are converted back with client_of().
+    GDBusClient gdbus;
+
+    GDBusProxy proxy[BLUEZ_PROXY_COUNT];
+    struct pipe_io notify_io;
+    struct write_io write_io;
+
+    GMainContext *context;
+    GMainLoop *loop;
+
+    // Carries method calls and signal watches, see bleTransport.h.
+    const struct bluez_transport *transport;
+    void *transportConn;
+
+    ClientReadyCallback ready;
+    gboolean filterSet;
+    void *user_data;
+
+    struct command_queue commands;
+    GThread *thread;
+
+    // Pools for method call bookkeeping, so calls in flight do not go
+    // to the heap once the pools have grown to the peak load.
+    struct bluez_slab callSlab;
+    struct bluez_slab commandSlab;
+
+    // RSSI filter settings, and its state since discovery started.
+    // 'smoothed' is in 1/256 dB.
+    struct bluez_rssi_filter rssiFilter;
+    gboolean rssiPrimed;
+    int rssiSmoothed;
+    int rssiReported;
+    gint64 rssiReportedAt;
+
+    // Devices screened out, whose objects are dropped on sight.
+    struct reject_cache rejected;
+
+    // Objects accepted from the daemon, and the proxies bound to them.
+    struct object_tree objects_mirror;
+
+    // Receivers of full payloads, from notifications and polling.
+    struct sample_sink sinks[MAX_SAMPLE_SINKS];
+    int sinkCount;
+
+    // Buffer between the notification pipe and delivery, set up by
+    // bluez_set_backpressure().
+    struct notify_buffer *notifyBuffer;
+
+    // Timer batching of deliveries, set up by bluez_set_wakeup_budget().
+    struct wakeup_batch *wakeup;
+
+    // Notification liveness watchdog, set up by bluez_set_watchdog().
+    struct notify_watchdog *watchdog;
+
+    // Reassembly of framed notifications, set up by bluez_set_framing().
+    struct frame_state *framing;
+
+    // io_uring backend, set up by bluez_client_set_backend().
+    struct bluez_uring *uring;
+
+    // ReadValue poller, created by the first bluez_poll_add().
+    struct poll_engine *poll;
+
+    // Time taken by each step of startup, see bleStartup.c.
+    struct startup_profile startup;
+
+    // GetManagedObjects reply being parsed in time slices, and the
+    // position of the next object in it.
+    DBusMessage *objects;
+    DBusMessageIter objects_iter;
+    GSource *objects_source;
+
+    // "path interface" keys added or removed by signals since that reply
+    // arrived.  The reply is older, so its entries for them are skipped.
+    GHashTable *objects_touched;
+};
+
+static inline bluez_client_t *client_of(GDBusClient *client)
+{
+    return (bluez_client_t *)client;
+}
+
+// bleClient.c
+void bluez_options_setup(DBusMessageIter *iter, void *user_data);
+void bluez_write_setup(DBusMessageIter *iter, void *user_data);
+void bluez_write_value(bluez_client_t *client, const uint8_t *bytes, size_t len);
+void bluez_deliver_sample(bluez_client_t *client, int source, gint64 timestamp,
+                          const uint8_t *data, size_t len);
+gboolean notify_io_read(bluez_client_t *client, int max, int *count);
+void notify_io_release(bluez_client_t *client);
+void notify_io_resume(bluez_client_t *client);
+
+// bleClient.c, D-Bus parsing.  Exported for bleMicrobench.
+void     bluez_add_property     (GDBusProxy *proxy, const char *name,
+                                 DBusMessageIter *iter, gboolean send_changed);
+void     bluez_invalidate_property (GDBusProxy *proxy, const char *name);
+gboolean bluez_screen_uuid      (DBusMessageIter *iter, const char *uuidWanted);
+void     iter_append_iter       (DBusMessageIter *base, DBusMessageIter *iter);
+void     parse_managed_objects  (GDBusClient *client, DBusMessage *msg);
+gboolean parse_objects_begin    (GDBusClient *client, DBusMessage *msg);
+void     parse_objects_finish   (GDBusClient *client);
+gboolean parse_objects_step     (GDBusClient *client, gint64 deadline);
+void     prop_entry_update      (struct prop_entry *prop, DBusMessageIter *iter);
+void     update_properties      (GDBusProxy *proxy, DBusMessageIter *iter,
+                                 gboolean send_changed);
+
+// bleBackpressure.c
+gboolean notify_buffer_blocked  (bluez_client_t *client);
+void     notify_buffer_free     (bluez_client_t *client);
+void     notify_buffer_park     (bluez_client_t *client, gint64 timestamp,
+                                 const uint8_t *data, size_t len);
+void     notify_buffer_push     (bluez_client_t *client, gint64 timestamp,
+                                 const uint8_t *data, size_t len);
+
+// bleWakeup.c
+gboolean wakeup_defer           (bluez_client_t *client, int source, gint64 timestamp,
+                                 const uint8_t *data, size_t len);
+void     wakeup_free            (bluez_client_t *client);
+gboolean wakeup_hold            (bluez_client_t *client);
+
+// bleFraming.c
+void     framing_free           (bluez_client_t *client);
+gboolean framing_receive        (bluez_client_t *client, gint64 timestamp,
+                                 const uint8_t **data, size_t *len);
+void     framing_reset          (bluez_client_t *client);
+
+// blePoll.c
+void poll_engine_free(bluez_client_t *client);
+
+// bleUring.c, built with URING=1.  Without it there is no ring to set up,
+// so none of the others are reached.
+#ifdef HAVE_URING
+void              uring_cancel  (struct bluez_uring *ring, struct uring_op *op);
+void              uring_free    (struct bluez_uring *ring);
+void              uring_get_stats (struct bluez_uring *ring, struct bluez_uring_stats *stats);
+struct bluez_uring *uring_new   (GMainContext *context);
+struct uring_op * uring_poll    (struct bluez_uring *ring, int fd, unsigned int events,
+                                 UringCallback cb, void *user_data);
+struct uring_op * uring_recv    (struct bluez_uring *ring, int fd, UringCallback cb,
+                                 void *user_data);
+void              uring_hold_buffer (struct bluez_uring *ring);
+void              uring_release_buffer (struct bluez_uring *ring, const uint8_t *data);
+void              uring_send    (struct bluez_uring *ring, int fd, const void *data, size_t len,
+                                 UringCallback cb, void *user_data);
+void              uring_send_drop (struct bluez_uring *ring, int fd);
+#else
+static inline void uring_cancel(struct bluez_uring *ring, struct uring_op *op) { }
+static inline void uring_free(struct bluez_uring *ring) { }
+static inline void uring_get_stats(struct bluez_uring *ring, struct bluez_uring_stats *stats) { }
+static inline struct bluez_uring *uring_new(GMainContext *context) { return NULL; }
+static inline struct uring_op *uring_poll(struct bluez_uring *ring, int fd, unsigned int events,
+                                          UringCallback cb, void *user_data) { return NULL; }
+static inline struct uring_op *uring_recv(struct bluez_uring *ring, int fd, UringCallback cb,
+                                          void *user_data) { return NULL; }
+static inline void uring_hold_buffer(struct bluez_uring *ring) { }
+static inline void uring_release_buffer(struct bluez_uring *ring, const uint8_t *data) { }
+static inline void uring_send(struct bluez_uring *ring, int fd, const void *data, size_t len,
+                              UringCallback cb, void *user_data) { }
+static inline void uring_send_drop(struct bluez_uring *ring, int fd) { }
+#endif
+
+// bleStartup.c
+void startup_begin      (bluez_client_t *client, int phase);
+void startup_end        (bluez_client_t *client, int phase);
+void startup_property   (bluez_client_t *client, const char *name,
+                         const struct bluez_property_value *value);
+void startup_start      (bluez_client_t *client);
+
+// bleWatchdog.c
+void watchdog_feed      (bluez_client_t *client);
+void watchdog_free      (bluez_client_t *client);
+void watchdog_property  (bluez_client_t *client, const char *name,
+                         const struct bluez_property_value *value);
+void watchdog_stop      (bluez_client_t *client);
+
+// bleThread.c
+void command_queue_init(bluez_client_t *client);
+void command_queue_destroy(bluez_client_t *client);
+size_t command_call_size(void);
+
+// bleMainloop.c.  gdbus/watch.c keeps its listener list in process-wide
+// statics, so D-Bus dispatch and watch registration must be serialized
+// across clients.
+void bluez_gdbus_lock(void);
+void bluez_gdbus_unlock(void);
+DBusConnection *bluez_setup_bus_uring(DBusBusType type, GMainContext *context,
+                                      struct bluez_uring *uring);
+
+#endif // CLIENT_PRIVATE_H
@@ -0,0 +1,261 @@
+//
+// bleDecode.c
+//
+// Created  10/18/2026
+//
+// Payload decoders, see bleDecode.h.  bluez_decoder_init() picks a kernel
+// for the schema's field type once, so decoding a payload makes no
+// per-field decisions.  The scalar kernels are generated per type from
+// one macro, which leaves the compiler a constant size and conversion to
+// unroll.
+//
+// 16-bit fields, the common case for inertial sensors, also have vector
+// kernels for SSE2 and NEON.  They widen and scale a batch of records
+// into a staging buffer eight values at a time, then copy the batch out
+// field by field.  The copy reads from L1 and costs far less than the
+// conversion it follows.  Records left over after the last full batch go
+// through the scalar kernel.  On 32-bit ARM, NEON needs -mfpu=neon.
+
+#include <string.h>
+#include <stdint.h>
+#include <glib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define DECODE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DECODE_NEON 1
+#endif
+
+#include "bleDecode.h"
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Scalar kernels.
+
+#define LOAD_INT8(p)    ((int8_t)(p)[0])
+#define LOAD_UINT8(p)   ((p)[0])
+#define LOAD_INT16(p)   ((int16_t)((p)[0] | (p)[1] << 8))
+#define LOAD_UINT16(p)  ((uint16_t)((p)[0] | (p)[1] << 8))
+#define LOAD_INT32(p)   ((int32_t)((uint32_t)(p)[0] | (uint32_t)(p)[1] << 8 | \
+                                   (uint32_t)(p)[2] << 16 | (uint32_t)(p)[3] << 24))
+
+#define DECODE_SCALAR(name, size, load)                                             \
+static void name(const struct bluez_decoder *decoder, const uint8_t *src,           \
+                 size_t records, float *const *out)                                 \
+{                                                                                   \
+    const int fields = decoder->schema.fields;                                      \
+    const float *scale = decoder->schema.scale;                                     \
+    size_t r;                                                                       \
+    int f;                                                                          \
+                                                                                    \
+    for (r = 0; r < records; r++)                                                   \
+    {                                                                               \
+        for (f = 0; f < fields; f++, src += (size))                                 \
+            out[f][r] = (float)load(src) * scale[f];                                \
+        src += decoder->record - fields * (size);                                   \
+    }                                                                               \
+}
+
+DECODE_SCALAR(decode_int8,   1, LOAD_INT8)
+DECODE_SCALAR(decode_uint8,  1, LOAD_UINT8)
+DECODE_SCALAR(decode_int16,  2, LOAD_INT16)
+DECODE_SCALAR(decode_uint16, 2, LOAD_UINT16)
+DECODE_SCALAR(decode_int32,  4, LOAD_INT32)
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Vector kernels for 16-bit fields.
+
+#if (DECODE_SSE2 || DECODE_NEON) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+// Copies a batch of converted records out of the staging buffer.
+static inline void batch_split(const float *stage, int fields, size_t records,
+                               float *const *out, size_t at)
+{
+    size_t r;
+    int f;
+
+    for (f = 0; f < fields; f++)
+    {
+        float *dst = out[f] + at;
+
+        for (r = 0; r < records; r++)
+            dst[r] = stage[r * fields + f];
+    }
+}
+
+// Converts 'n' values, a multiple of eight.
+static inline void batch_convert(const uint8_t *src, const float *pattern, float *stage,
+                                 size_t n, gboolean sign)
+{
+    size_t i;
+
+#if DECODE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+
+    for (i = 0; i < n; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        __m128i lo, hi;
+
+        if (sign)
+        {
+            lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        }
+        else
+        {
+            lo = _mm_unpacklo_epi16(v, zero);
+            hi = _mm_unpackhi_epi16(v, zero);
+        }
+
+        _mm_storeu_ps(stage + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), _mm_loadu_ps(pattern + i)));
+        _mm_storeu_ps(stage + i + 4,
+                      _mm_mul_ps(_mm_cvtepi32_ps(hi), _mm_loadu_ps(pattern + i + 4)));
+    }
+#else
+    for (i = 0; i < n; i += 8)
+    {
+        float32x4_t lo, hi;
+
+        if (sign)
+        {
+            int16x8_t v = vld1q_s16((const int16_t *)(src + 2 * i));
+            lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+            hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        }
+        else
+        {
+            uint16x8_t v = vld1q_u16((const uint16_t *)(src + 2 * i));
+            lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(v)));
+            hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(v)));
+        }
+
+        vst1q_f32(stage + i, vmulq_f32(lo, vld1q_f32(pattern + i)));
+        vst1q_f32(stage + i + 4, vmulq_f32(hi, vld1q_f32(pattern + i + 4)));
+    }
+#endif
+}
+
+static inline void decode_vector16(const struct bluez_decoder *decoder, const uint8_t *src,
+                                   size_t records, float *const *out, gboolean sign)
+{
+    const int fields = decoder->schema.fields;
+    const size_t n = BLUEZ_DECODE_BATCH * fields;
+    float stage[BLUEZ_DECODE_BATCH * BLUEZ_DECODE_MAX_FIELDS];
+    float *rest[BLUEZ_DECODE_MAX_FIELDS];
+    size_t r;
+    int f;
+
+    for (r = 0; r + BLUEZ_DECODE_BATCH <= records; r += BLUEZ_DECODE_BATCH)
+    {
+        batch_convert(src, decoder->pattern, stage, n, sign);
+
+        // Constant field counts let the compiler unroll the copy.
+        switch (fields)
+        {
+            case 1:  batch_split(stage, 1, BLUEZ_DECODE_BATCH, out, r); break;
+            case 2:  batch_split(stage, 2, BLUEZ_DECODE_BATCH, out, r); break;
+            case 3:  batch_split(stage, 3, BLUEZ_DECODE_BATCH, out, r); break;
+            default: batch_split(stage, 4, BLUEZ_DECODE_BATCH, out, r); break;
+        }
+
+        src += BLUEZ_DECODE_BATCH * decoder->record;
+    }
+
+    if (r == records)
+        return;
+
+    for (f = 0; f < fields; f++)
+        rest[f] = out[f] + r;
+
+    if (sign)
+        decode_int16(decoder, src, records - r, rest);
+    else
+        decode_uint16(decoder, src, records - r, rest);
+}
+
+static void decode_vector_int16(const struct bluez_decoder *decoder, const uint8_t *src,
+                                size_t records, float *const *out)
+{
+    decode_vector16(decoder, src, records, out, TRUE);
+}
+
+static void decode_vector_uint16(const struct bluez_decoder *decoder, const uint8_t *src,
+                                 size_t records, float *const *out)
+{
+    decode_vector16(decoder, src, records, out, FALSE);
+}
+
+#define HAVE_VECTOR16 1
+#endif
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Public interface.
+
+// Builds a decoder for 'schema'.  Returns FALSE if the schema is invalid.
+gboolean bluez_decoder_init(struct bluez_decoder *decoder, const struct bluez_schema *schema)
+{
+    static const struct {
+        size_t size;
+        DecodeKernel scalar;
+        DecodeKernel vector;
+    } kernels[] = {
+        [BLUEZ_DECODE_INT8]   = { 1, decode_int8,   NULL },
+        [BLUEZ_DECODE_UINT8]  = { 1, decode_uint8,  NULL },
+#if HAVE_VECTOR16
+        [BLUEZ_DECODE_INT16]  = { 2, decode_int16,  decode_vector_int16 },
+        [BLUEZ_DECODE_UINT16] = { 2, decode_uint16, decode_vector_uint16 },
+#else
+        [BLUEZ_DECODE_INT16]  = { 2, decode_int16,  NULL },
+        [BLUEZ_DECODE_UINT16] = { 2, decode_uint16, NULL },
+#endif
+        [BLUEZ_DECODE_INT32]  = { 4, decode_int32,  NULL },
+    };
+    size_t i;
+
+    if (schema == NULL || schema->type < 0 || schema->type >= (int)G_N_ELEMENTS(kernels) ||
+        schema->fields < 1 || schema->fields > BLUEZ_DECODE_MAX_FIELDS)
+        return FALSE;
+
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->schema = *schema;
+    decoder->record = kernels[schema->type].size * schema->fields;
+
+    // The vector kernels read records as one packed run of values.
+    decoder->kernel = kernels[schema->type].vector;
+    if (decoder->kernel == NULL)
+        decoder->kernel = kernels[schema->type].scalar;
+
+    for (i = 0; i < G_N_ELEMENTS(decoder->pattern); i++)
+        decoder->pattern[i] = schema->scale[i % schema->fields];
+
+    return TRUE;
+}
+
+// Appends the records in 'data' to 'out', as far as it has room.  Bytes
+// after the last whole record are ignored.  Returns the number of records
+// appended.
+size_t bluez_decode(const struct bluez_decoder *decoder, const uint8_t *data,
+                    size_t len, struct bluez_soa *out)
+{
+    float *dst[BLUEZ_DECODE_MAX_FIELDS];
+    size_t records;
+    int f;
+
+    if (len <= decoder->schema.header || out->count >= out->capacity)
+        return 0;
+
+    records = (len - decoder->schema.header) / decoder->record;
+    records = MIN(records, out->capacity - out->count);
+    if (records == 0)
+        return 0;
+
+    for (f = 0; f < decoder->schema.fields; f++)
+        dst[f] = out->field[f] + out->count;
+
+    decoder->kernel(decoder, data + decoder->schema.header, records, dst);
+    out->count += records;
+
+    return records;
+}
@@ -0,0 +1,78 @@
+//
+// bleDecode.h
+//
+// Created  10/18/2026
+//
+// Payload decoders.  A schema describes a characteristic's packed layout:
+// a fixed header followed by repeated records of one to four fields of
+// the same integer type.  A decoder built from it unpacks whole payloads
+// into struct-of-arrays buffers of floats, one array per field, each
+// value multiplied by its field's scale.
+//
+// For example, an IMU sending a 4-byte header and then int16 x, y, z
+// triplets in units of 1/16384 g:
+//
+//    static const struct bluez_schema imu =
+//        BLUEZ_SCHEMA(4, BLUEZ_DECODE_INT16, 3, 1 / 16384.0f, 1 / 16384.0f, 1 / 16384.0f);
+
+#ifndef BLE_DECODE_H
+#define BLE_DECODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glib.h>
+
+enum {
+    BLUEZ_DECODE_INT8 = 0,
+    BLUEZ_DECODE_UINT8,
+    BLUEZ_DECODE_INT16,         // little-endian, as is all of GATT
+    BLUEZ_DECODE_UINT16,
+    BLUEZ_DECODE_INT32
+};
+
+#define BLUEZ_DECODE_MAX_FIELDS 4
+
+// Records converted per batch by the vector kernels.
+#define BLUEZ_DECODE_BATCH      8
+
+struct bluez_schema
+{
+    size_t header;              // bytes before the first record
+    int type;                   // of every field
+    int fields;                 // per record
+    float scale[BLUEZ_DECODE_MAX_FIELDS];
+};
+
+#define BLUEZ_SCHEMA(header, type, fields, ...) \
+    { (header), (type), (fields), { __VA_ARGS__ } }
+
+struct bluez_decoder;
+
+typedef void (* DecodeKernel) (const struct bluez_decoder *decoder, const uint8_t *src,
+                               size_t records, float *const *out);
+
+struct bluez_decoder
+{
+    struct bluez_schema schema;
+    size_t record;              // bytes per record
+    DecodeKernel kernel;
+
+    // Field scales repeated over one batch, so the vector kernels scale
+    // a whole register at a time.
+    float pattern[BLUEZ_DECODE_BATCH * BLUEZ_DECODE_MAX_FIELDS];
+};
+
+// Decoded samples.  field[i] points to 'capacity' floats for each field
+// in the schema; 'count' of them are filled.
+struct bluez_soa
+{
+    float *field[BLUEZ_DECODE_MAX_FIELDS];
+    size_t capacity;
+    size_t count;
+};
+
+size_t      bluez_decode        (const struct bluez_decoder *decoder, const uint8_t *data,
+                                 size_t len, struct bluez_soa *out);
+gboolean    bluez_decoder_init  (struct bluez_decoder *decoder, const struct bluez_schema *schema);
+
+#endif // BLE_DECODE_H
@@ -0,0 +1,313 @@
+//
+// bleForward.c
+//
+// Created  10/18/2026
+//
+// Forwards samples to local consumers over unix-domain datagram sockets.
+// Added as a sample sink, it packs samples into datagrams in the format
+// described in bleForward.h.  A datagram is closed when the next sample
+// does not fit, and closed datagrams are sent together with one
+// sendmmsg() call per batch, to every peer.  The batch goes out when all
+// its buffers are full, or when the oldest sample in it has waited for
+// the flush deadline, whichever comes first.
+//
+//    fwd = bluez_forward_new(client, NULL);
+//    bluez_forward_add_peer(fwd, "/run/ble/consumer.sock");
+//    bluez_add_sample_sink(client, bluez_forward_sample, fwd);
+//
+// Sends never block.  A datagram a peer cannot take, because its queue is
+// full or it is not listening, is dropped for that peer and counted in
+// ble_forward_dropped_total.
+
+#define _GNU_SOURCE     // sendmmsg()
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleForward.h"
+#include "bleMetrics.h"
+
+// Datagrams held before a batch is sent.
+#define FORWARD_BATCH       16
+
+#define FORWARD_MAX_PEERS   8
+
+struct forward_buffer
+{
+    uint8_t *data;
+    size_t len;
+    uint16_t count;
+    gint64 last;                // timestamp of the last record
+};
+
+struct forward_source
+{
+    GSource source;
+    struct bluez_forward *fwd;
+};
+
+struct bluez_forward
+{
+    bluez_client_t *client;
+    struct bluez_forward_config config;
+    int fd;
+
+    struct sockaddr_un peer[FORWARD_MAX_PEERS];
+    int peerCount;
+
+    struct forward_buffer buffer[FORWARD_BATCH];
+    int filled;                 // buffers closed and waiting to be sent
+    GSource *deadline;
+
+    struct mmsghdr msg[FORWARD_BATCH * FORWARD_MAX_PEERS];
+    struct iovec iov[FORWARD_BATCH];
+};
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Encoding.
+
+static size_t put_varint(uint8_t *p, uint64_t v)
+{
+    size_t n = 0;
+
+    while (v >= 0x80)
+    {
+        p[n++] = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+
+    return n;
+}
+
+static void put_le(uint8_t *p, uint64_t v, int bytes)
+{
+    int i;
+
+    for (i = 0; i < bytes; i++)
+        p[i] = v >> (8 * i);
+}
+
+static void buffer_start(struct forward_buffer *b, gint64 timestamp)
+{
+    b->data[0] = BLE_FORWARD_VERSION;
+    b->data[1] = 0;
+    put_le(b->data + 4, timestamp, 8);
+    b->len = BLE_FORWARD_HEADER;
+    b->count = 0;
+    b->last = timestamp;
+}
+
+static void buffer_close(struct forward_buffer *b)
+{
+    put_le(b->data + 2, b->count, 2);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Sending.
+
+// Sends every closed buffer to every peer.
+static void forward_send(struct bluez_forward *fwd)
+{
+    int i, p, n = 0, sent;
+
+    for (i = 0; i < fwd->filled; i++)
+    {
+        fwd->iov[i].iov_base = fwd->buffer[i].data;
+        fwd->iov[i].iov_len = fwd->buffer[i].len;
+
+        for (p = 0; p < fwd->peerCount; p++, n++)
+        {
+            memset(&fwd->msg[n], 0, sizeof(fwd->msg[n]));
+            fwd->msg[n].msg_hdr.msg_name = &fwd->peer[p];
+            fwd->msg[n].msg_hdr.msg_namelen = sizeof(fwd->peer[p]);
+            fwd->msg[n].msg_hdr.msg_iov = &fwd->iov[i];
+            fwd->msg[n].msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    fwd->filled = 0;
+
+    // sendmmsg() stops at the first message that fails.  Drop it and go
+    // on with the rest.
+    for (i = 0; i < n; )
+    {
+        sent = sendmmsg(fwd->fd, &fwd->msg[i], n - i, MSG_DONTWAIT);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            bluez_metrics_inc(METRIC_FORWARD_DROPPED);
+            sent = 1;
+        }
+        i += sent;
+    }
+
+    g_source_set_ready_time(fwd->deadline, -1);
+}
+
+// Closes the open buffer and sends the batch.
+static void forward_flush(struct bluez_forward *fwd)
+{
+    struct forward_buffer *b = &fwd->buffer[fwd->filled];
+
+    if (b->len > 0)
+    {
+        buffer_close(b);
+        fwd->filled++;
+    }
+
+    if (fwd->filled > 0)
+        forward_send(fwd);
+
+    fwd->buffer[0].len = 0;
+    g_source_set_ready_time(fwd->deadline, -1);
+}
+
+static gboolean forward_dispatch(GSource *source, GSourceFunc callback, gpointer user_data)
+{
+    forward_flush(((struct forward_source *)source)->fwd);
+
+    return TRUE;
+}
+
+static GSourceFuncs forward_source_funcs = {
+    .dispatch = forward_dispatch
+};
+
+// Sample sink, with 'user_data' the forwarder.
+void bluez_forward_sample(bluez_client_t *client, const struct bluez_sample *sample,
+                          void *user_data)
+{
+    struct bluez_forward *fwd = user_data;
+    struct forward_buffer *b = &fwd->buffer[fwd->filled];
+    size_t need = BLE_FORWARD_RECORD_MAX + sample->len;
+
+    if (fwd->peerCount == 0)
+        return;
+
+    if (BLE_FORWARD_HEADER + need > fwd->config.datagram)
+    {
+        bluez_metrics_inc(METRIC_FORWARD_DROPPED);
+        return;
+    }
+
+    // Close the open buffer if the record does not fit, and send the
+    // batch if that was the last buffer.
+    if (b->len > 0 && b->len + need > fwd->config.datagram)
+    {
+        buffer_close(b);
+        if (++fwd->filled == FORWARD_BATCH)
+            forward_send(fwd);
+
+        b = &fwd->buffer[fwd->filled];
+        b->len = 0;
+    }
+
+    if (b->len == 0)
+    {
+        buffer_start(b, sample->timestamp);
+        if (fwd->filled == 0)
+            g_source_set_ready_time(fwd->deadline,
+                                    sample->timestamp + fwd->config.deadline * 1000);
+    }
+
+    b->len += put_varint(b->data + b->len, sample->source);
+    b->len += put_varint(b->data + b->len, MAX(sample->timestamp - b->last, 0));
+    b->len += put_varint(b->data + b->len, sample->len);
+    memcpy(b->data + b->len, sample->data, sample->len);
+    b->len += sample->len;
+    b->count++;
+    b->last = sample->timestamp;
+
+    if (b->count == G_MAXUINT16)
+        forward_flush(fwd);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Public interface.
+
+// Creates a forwarder.  NULL selects 4 KB datagrams flushed within 5 ms.
+struct bluez_forward *bluez_forward_new(bluez_client_t *client,
+                                        const struct bluez_forward_config *config)
+{
+    static const struct bluez_forward_config defaults = { 4096, 5 };
+    struct bluez_forward *fwd;
+    int i;
+
+    if (client == NULL)
+        return NULL;
+
+    if (config == NULL)
+        config = &defaults;
+
+    if (config->datagram < BLE_FORWARD_HEADER + BLE_FORWARD_RECORD_MAX || config->deadline < 0)
+        return NULL;
+
+    fwd = g_new0(struct bluez_forward, 1);
+    fwd->client = client;
+    fwd->config = *config;
+
+    fwd->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fwd->fd < 0)
+    {
+        fprintf(stderr, "Unable to create forwarding socket: %s\n", strerror(errno));
+        g_free(fwd);
+        return NULL;
+    }
+
+    for (i = 0; i < FORWARD_BATCH; i++)
+        fwd->buffer[i].data = g_malloc(config->datagram);
+
+    fwd->deadline = g_source_new(&forward_source_funcs, sizeof(struct forward_source));
+    ((struct forward_source *)fwd->deadline)->fwd = fwd;
+    g_source_attach(fwd->deadline, bluez_client_get_context(client));
+
+    return fwd;
+}
+
+// Adds a consumer listening on a datagram socket at 'path'.  Returns
+// FALSE if FORWARD_MAX_PEERS are already added or the path is too long.
+gboolean bluez_forward_add_peer(struct bluez_forward *fwd, const char *path)
+{
+    struct sockaddr_un *peer;
+
+    if (fwd->peerCount == FORWARD_MAX_PEERS || strlen(path) >= sizeof(peer->sun_path))
+        return FALSE;
+
+    peer = &fwd->peer[fwd->peerCount++];
+    memset(peer, 0, sizeof(*peer));
+    peer->sun_family = AF_UNIX;
+    strcpy(peer->sun_path, path);
+
+    return TRUE;
+}
+
+// Sends anything still buffered and frees the forwarder.  Remove it as a
+// sample sink first.
+void bluez_forward_free(struct bluez_forward *fwd)
+{
+    int i;
+
+    if (fwd == NULL)
+        return;
+
+    forward_flush(fwd);
+
+    g_source_destroy(fwd->deadline);
+    g_source_unref(fwd->deadline);
+    close(fwd->fd);
+
+    for (i = 0; i < FORWARD_BATCH; i++)
+        g_free(fwd->buffer[i].data);
+    g_free(fwd);
+}
@@ -0,0 +1,37 @@
+//
+// bleForward.h
+//
+// Created  10/18/2026
+//
+// Wire format of the datagrams sent by the notification forwarder, see
+// bleForward.c.  Each datagram packs one or more values:
+//
+//    header   version        1 byte, BLE_FORWARD_VERSION
+//             reserved       1 byte, zero
+//             count          2 bytes, little-endian, number of records
+//             timestamp      8 bytes, little-endian, CLOCK_MONOTONIC in
+//                            microseconds, of the first record
+//
+//    record   source         varint, BLUEZ_SOURCE_NOTIFY or a poll ID
+//             delta          varint, microseconds since the previous
+//                            record, or since the header timestamp for
+//                            the first record
+//             length         varint
+//             data           'length' bytes
+//
+// Varints are unsigned LEB128: seven bits per byte, least significant
+// first, with the top bit set on every byte but the last.
+
+#ifndef BLE_FORWARD_H
+#define BLE_FORWARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLE_FORWARD_VERSION     1
+#define BLE_FORWARD_HEADER      12
+
+// Largest encoding of a record's source, delta and length.
+#define BLE_FORWARD_RECORD_MAX  (3 * 10)
+
+#endif // BLE_FORWARD_H
@@ -0,0 +1,277 @@
+//
+// bleFraming.c
+//
+// Created  10/18/2026
+//
+// Framing of application messages longer than one ATT value.  Each
+// message is sent as a run of fragments, each fitting one notification or
+// one write, and each starting with a two-byte header:
+//
+//    byte 0   message sequence number, one more for each message, mod 256
+//    byte 1   bit 7 set on the last fragment, bits 0-6 the fragment index
+//
+// so a message has at most 128 fragments.  A message that fits in one
+// fragment is sent as fragment 0 with the last bit set.
+//
+// Notifications are reassembled into one buffer allocated when framing is
+// set up, sized for the largest message.  Each fragment's payload is
+// copied into it once, straight from the read buffer, and the complete
+// message is delivered from it in place, to the notification callback and
+// the sample sinks like any notification.  A fragment out of order, one
+// from another message, a new message starting, or one arriving after
+// the reassembly timeout discards the partial message.  Fragments dropped
+// by the notification buffer show up the same way.
+//
+// Outgoing messages are cut to the write MTU from AcquireWrite, or the
+// notification MTU before that, less 3 bytes of ATT header.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleClientPrivate.h"
+#include "bleMetrics.h"
+#include "bleTrace.h"
+
+#define FRAME_HEADER        2
+#define FRAME_LAST          0x80
+#define FRAME_INDEX_MASK    0x7f
+#define FRAME_FRAGMENTS_MAX 128
+
+// Largest ATT value, and the MTU assumed before one is known.
+#define ATT_VALUE_MAX       512
+#define ATT_MTU_DEFAULT     23
+#define ATT_WRITE_HEADER    3
+
+struct frame_state
+{
+    struct bluez_framing config;
+    struct bluez_framing_stats stats;
+
+    // Message being reassembled.  'next' is the index of the fragment
+    // expected next, 0 when none is under way.
+    uint8_t *buf;
+    size_t len;
+    uint8_t seq;
+    int next;
+    gint64 started;
+
+    uint8_t txSeq;
+};
+
+static void frame_discard(bluez_client_t *client, const char *why)
+{
+    struct frame_state *f = client->framing;
+
+    BLE_TRACE(TRACE_WARN, "framing", why, f->seq, f->next);
+
+    f->stats.discarded++;
+    bluez_metrics_inc(METRIC_FRAMES_DISCARDED);
+
+    f->next = 0;
+    f->len = 0;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Interface to notification delivery.
+
+// Takes one fragment from 'data'.  Returns TRUE when it completes a
+// message, with 'data' and 'len' set to the message in the reassembly
+// buffer, valid until the next fragment.  Returns FALSE otherwise.
+gboolean framing_receive(bluez_client_t *client, gint64 timestamp,
+                         const uint8_t **data, size_t *len)
+{
+    struct frame_state *f = client->framing;
+    const uint8_t *frag = *data;
+    size_t payload;
+    int index;
+
+    f->stats.fragments++;
+
+    if (*len < FRAME_HEADER)
+    {
+        f->stats.malformed++;
+        return FALSE;
+    }
+
+    index = frag[1] & FRAME_INDEX_MASK;
+    payload = *len - FRAME_HEADER;
+
+    if (f->next > 0 && timestamp - f->started > (gint64)f->config.timeout * 1000)
+    {
+        f->stats.timeouts++;
+        frame_discard(client, "timeout");
+    }
+
+    if (index == 0)
+    {
+        if (f->next > 0)
+            frame_discard(client, "restarted");
+
+        f->seq = frag[0];
+        f->started = timestamp;
+    }
+    else if (f->next == 0)
+    {
+        // The start of this message was missed or discarded.
+        f->stats.malformed++;
+        return FALSE;
+    }
+    else if (frag[0] != f->seq || index != f->next)
+    {
+        frame_discard(client, "out_of_sequence");
+        return FALSE;
+    }
+
+    if (payload > f->config.maxMessage - f->len)
+    {
+        f->stats.malformed++;
+        frame_discard(client, "too_long");
+        return FALSE;
+    }
+
+    memcpy(f->buf + f->len, frag + FRAME_HEADER, payload);
+    f->len += payload;
+    f->next = index + 1;
+
+    if ((frag[1] & FRAME_LAST) == 0)
+        return FALSE;
+
+    f->stats.messages++;
+
+    *data = f->buf;
+    *len = f->len;
+
+    f->next = 0;
+    f->len = 0;
+
+    return TRUE;
+}
+
+// Drops any partial message when the notification socket goes away.
+void framing_reset(bluez_client_t *client)
+{
+    if (client->framing->next > 0)
+        frame_discard(client, "closed");
+}
+
+// Frees the framing state.
+void framing_free(bluez_client_t *client)
+{
+    struct frame_state *f = client->framing;
+
+    if (f == NULL)
+        return;
+
+    g_free(f->buf);
+    g_free(f);
+    client->framing = NULL;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Public interface.
+
+// Turns on framing of notifications and bluez_write_message(), as
+// described at the top of this file.  Zero fields in 'config' take the
+// defaults: messages up to 4096 bytes, and 1 s to receive all of one.
+// NULL turns framing off, after which notifications are delivered as they
+// arrive again.
+gboolean bluez_set_framing(bluez_client_t *client, const struct bluez_framing *config)
+{
+    struct frame_state *f = client->framing;
+    struct bluez_framing c;
+
+    if (config == NULL)
+    {
+        framing_free(client);
+        return TRUE;
+    }
+
+    c = *config;
+    if (c.maxMessage == 0)
+        c.maxMessage = 4096;
+    if (c.timeout <= 0)
+        c.timeout = 1000;
+
+    if (f == NULL)
+    {
+        f = g_new0(struct frame_state, 1);
+        client->framing = f;
+    }
+    else if (c.maxMessage != f->config.maxMessage)
+    {
+        g_free(f->buf);
+        f->buf = NULL;
+    }
+
+    if (f->buf == NULL)
+        f->buf = g_malloc(c.maxMessage);
+
+    f->config = c;
+    f->next = 0;
+    f->len = 0;
+
+    return TRUE;
+}
+
+void bluez_get_framing_stats(bluez_client_t *client, struct bluez_framing_stats *stats)
+{
+    if (client->framing == NULL)
+        memset(stats, 0, sizeof(*stats));
+    else
+        *stats = client->framing->stats;
+}
+
+// Sends 'len' bytes as one framed message to the characteristic for
+// writes.  The fragments are queued in order before this returns, those
+// an AcquireWrite socket has no room for waiting until it has.
+// Returns FALSE if framing is off, or the message needs more than 128
+// fragments at the current MTU.
+gboolean bluez_write_message(bluez_client_t *client, const uint8_t *data, size_t len)
+{
+    struct frame_state *f = client->framing;
+    uint8_t frag[ATT_VALUE_MAX];
+    size_t mtu, payload, n;
+    int index;
+
+    if (f == NULL)
+        return FALSE;
+
+    if (client->write_io.acquired && client->write_io.mtu > 0)
+        mtu = client->write_io.mtu;
+    else if (client->notify_io.mtu > 0)
+        mtu = client->notify_io.mtu;
+    else
+        mtu = ATT_MTU_DEFAULT;
+
+    payload = MIN(mtu - ATT_WRITE_HEADER, ATT_VALUE_MAX) - FRAME_HEADER;
+
+    if (len > payload * FRAME_FRAGMENTS_MAX)
+    {
+        fprintf(stderr, "Message of %zu bytes too long for MTU %zu\n", len, mtu);
+        return FALSE;
+    }
+
+    index = 0;
+    do
+    {
+        n = MIN(len, payload);
+
+        frag[0] = f->txSeq;
+        frag[1] = index++ | (n == len ? FRAME_LAST : 0);
+        memcpy(frag + FRAME_HEADER, data, n);
+
+        bluez_write_value(client, frag, n + FRAME_HEADER);
+
+        data += n;
+        len -= n;
+    } while (len > 0);
+
+    f->txSeq++;
+
+    return TRUE;
+}
@@ -0,0 +1,341 @@
+//
+// bleMainloop.c
+//
+// Created  10/18/2026
+//
+// D-Bus main loop integration for a private connection bound to a specific
+// GMainContext.  This replaces g_dbus_setup_bus() from BlueZ's
+// gdbus/mainloop.c, which attaches every watch, timeout and dispatch source
+// to the global default context and so allows only one client per process.
+//
+// The structure follows gdbus/mainloop.c: each DBusWatch becomes a unix fd
+// source, each DBusTimeout a timeout source, and pending messages are
+// dispatched from an idle source, all attached to the caller's context.
+// On the io_uring backend, watches are poll requests on the client's ring
+// instead, see bleUring.c.
+
+#include <stdio.h>
+#include <poll.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleClientPrivate.h"
+
+struct conn_info
+{
+    DBusConnection *conn;
+    GMainContext *context;
+    struct bluez_uring *uring;
+    GSource *dispatch;
+};
+
+struct watch_info
+{
+    DBusWatch *watch;
+    GSource *source;
+    struct bluez_uring *uring;
+    struct uring_op *op;
+};
+
+struct timeout_info
+{
+    DBusTimeout *timeout;
+    GSource *source;
+};
+
+// gdbus/watch.c keeps its listener list in process-wide statics and is not
+// thread safe.  Every dispatch and every watch registration goes through
+// this lock.  It is only taken while D-Bus messages are being handled,
+// never on the notification path.
+static GRecMutex gdbus_lock;
+
+void bluez_gdbus_lock(void)
+{
+    g_rec_mutex_lock(&gdbus_lock);
+}
+
+void bluez_gdbus_unlock(void)
+{
+    g_rec_mutex_unlock(&gdbus_lock);
+}
+
+static gboolean message_dispatch(gpointer user_data)
+{
+    struct conn_info *info = user_data;
+
+    g_source_unref(info->dispatch);
+    info->dispatch = NULL;
+
+    bluez_gdbus_lock();
+
+    // Dispatch messages until the incoming queue is empty.
+    while (dbus_connection_dispatch(info->conn) == DBUS_DISPATCH_DATA_REMAINS)
+        ;
+
+    bluez_gdbus_unlock();
+
+    return FALSE;
+}
+
+static void queue_dispatch(struct conn_info *info)
+{
+    if (info->dispatch != NULL)
+        return;
+
+    info->dispatch = g_idle_source_new();
+    g_source_set_priority(info->dispatch, G_PRIORITY_DEFAULT);
+    g_source_set_callback(info->dispatch, message_dispatch, info, NULL);
+    g_source_attach(info->dispatch, info->context);
+}
+
+static void dispatch_status(DBusConnection *conn,
+                            DBusDispatchStatus status, void *user_data)
+{
+    if (!dbus_connection_get_is_connected(conn))
+        return;
+
+    if (status == DBUS_DISPATCH_DATA_REMAINS)
+        queue_dispatch(user_data);
+}
+
+static void wakeup_main(void *user_data)
+{
+    struct conn_info *info = user_data;
+
+    g_main_context_wakeup(info->context);
+}
+
+static gboolean watch_func(gint fd, GIOCondition cond, gpointer user_data)
+{
+    struct watch_info *info = user_data;
+    unsigned int flags = 0;
+
+    if (cond & G_IO_IN)  flags |= DBUS_WATCH_READABLE;
+    if (cond & G_IO_OUT) flags |= DBUS_WATCH_WRITABLE;
+    if (cond & G_IO_HUP) flags |= DBUS_WATCH_HANGUP;
+    if (cond & G_IO_ERR) flags |= DBUS_WATCH_ERROR;
+
+    dbus_watch_handle(info->watch, flags);
+
+    return TRUE;
+}
+
+static void watch_ready(void *user_data, int res, const uint8_t *data)
+{
+    struct watch_info *info = user_data;
+    unsigned int flags = 0;
+
+    if (res < 0)
+        return;
+
+    if (res & POLLIN)  flags |= DBUS_WATCH_READABLE;
+    if (res & POLLOUT) flags |= DBUS_WATCH_WRITABLE;
+    if (res & POLLHUP) flags |= DBUS_WATCH_HANGUP;
+    if (res & POLLERR) flags |= DBUS_WATCH_ERROR;
+
+    dbus_watch_handle(info->watch, flags);
+}
+
+static void watch_info_free(void *data)
+{
+    struct watch_info *info = data;
+
+    if (info->op != NULL)
+        uring_cancel(info->uring, info->op);
+    else
+    {
+        g_source_destroy(info->source);
+        g_source_unref(info->source);
+    }
+    g_free(info);
+}
+
+static dbus_bool_t add_watch(DBusWatch *watch, void *data)
+{
+    struct conn_info *cinfo = data;
+    struct watch_info *info;
+    GIOCondition cond = G_IO_HUP | G_IO_ERR;
+    unsigned int flags;
+
+    if (!dbus_watch_get_enabled(watch))
+        return TRUE;
+
+    flags = dbus_watch_get_flags(watch);
+    if (flags & DBUS_WATCH_READABLE) cond |= G_IO_IN;
+    if (flags & DBUS_WATCH_WRITABLE) cond |= G_IO_OUT;
+
+    info = g_new0(struct watch_info, 1);
+    info->watch = watch;
+
+    if (cinfo->uring != NULL)
+    {
+        info->uring = cinfo->uring;
+        info->op = uring_poll(cinfo->uring, dbus_watch_get_unix_fd(watch),
+                              ((cond & G_IO_IN) ? POLLIN : 0) | ((cond & G_IO_OUT) ? POLLOUT : 0),
+                              watch_ready, info);
+        if (info->op == NULL)
+        {
+            g_free(info);
+            return FALSE;
+        }
+    }
+    else
+    {
+        info->source = g_unix_fd_source_new(dbus_watch_get_unix_fd(watch), cond);
+
+        g_source_set_callback(info->source, (GSourceFunc) watch_func, info, NULL);
+        g_source_attach(info->source, cinfo->context);
+    }
+
+    // Replaces, and frees, any previous data for this watch.
+    dbus_watch_set_data(watch, info, watch_info_free);
+
+    return TRUE;
+}
+
+static void remove_watch(DBusWatch *watch, void *data)
+{
+    dbus_watch_set_data(watch, NULL, NULL);
+}
+
+static void watch_toggled(DBusWatch *watch, void *data)
+{
+    if (dbus_watch_get_enabled(watch))
+        add_watch(watch, data);
+    else
+        remove_watch(watch, data);
+}
+
+static gboolean timeout_func(gpointer user_data)
+{
+    struct timeout_info *info = user_data;
+
+    dbus_timeout_handle(info->timeout);
+
+    return TRUE;
+}
+
+static void timeout_info_free(void *data)
+{
+    struct timeout_info *info = data;
+
+    g_source_destroy(info->source);
+    g_source_unref(info->source);
+    g_free(info);
+}
+
+static dbus_bool_t add_timeout(DBusTimeout *timeout, void *data)
+{
+    struct conn_info *cinfo = data;
+    struct timeout_info *info;
+
+    if (!dbus_timeout_get_enabled(timeout))
+        return TRUE;
+
+    info = g_new0(struct timeout_info, 1);
+    info->timeout = timeout;
+    info->source = g_timeout_source_new(dbus_timeout_get_interval(timeout));
+
+    g_source_set_callback(info->source, timeout_func, info, NULL);
+    g_source_attach(info->source, cinfo->context);
+
+    dbus_timeout_set_data(timeout, info, timeout_info_free);
+
+    return TRUE;
+}
+
+static void remove_timeout(DBusTimeout *timeout, void *data)
+{
+    dbus_timeout_set_data(timeout, NULL, NULL);
+}
+
+static void timeout_toggled(DBusTimeout *timeout, void *data)
+{
+    if (dbus_timeout_get_enabled(timeout))
+        add_timeout(timeout, data);
+    else
+        remove_timeout(timeout, data);
+}
+
+static void conn_info_free(void *data)
+{
+    struct conn_info *info = data;
+
+    if (info->dispatch != NULL)
+    {
+        g_source_destroy(info->dispatch);
+        g_source_unref(info->dispatch);
+    }
+
+    g_main_context_unref(info->context);
+    g_free(info);
+}
+
+// Opens a private connection to the given bus with all of its event
+// sources attached to 'context' (NULL for the global default context).
+// Release it with bluez_close_bus().
+DBusConnection *bluez_setup_bus(DBusBusType type, GMainContext *context)
+{
+    return bluez_setup_bus_uring(type, context, NULL);
+}
+
+// As bluez_setup_bus(), with the connection's watches serviced by 'uring'
+// if it is not NULL.  Timeouts and dispatch stay on 'context'.
+DBusConnection *bluez_setup_bus_uring(DBusBusType type, GMainContext *context,
+                                      struct bluez_uring *uring)
+{
+    DBusConnection *conn;
+    struct conn_info *info;
+    DBusError error;
+
+    dbus_threads_init_default();
+
+    dbus_error_init(&error);
+
+    conn = dbus_bus_get_private(type, &error);
+    if (dbus_error_is_set(&error))
+    {
+        fprintf(stderr, "Failed to connect to bus: %s\n", error.message);
+        dbus_error_free(&error);
+        return NULL;
+    }
+
+    if (conn == NULL)
+        return NULL;
+
+    dbus_connection_set_exit_on_disconnect(conn, FALSE);
+
+    info = g_new0(struct conn_info, 1);
+    info->conn = conn;
+    info->context = g_main_context_ref(context ? context : g_main_context_default());
+    info->uring = uring;
+
+    dbus_connection_set_watch_functions(conn, add_watch, remove_watch,
+                                        watch_toggled, info, NULL);
+
+    dbus_connection_set_timeout_functions(conn, add_timeout, remove_timeout,
+                                          timeout_toggled, info, NULL);
+
+    dbus_connection_set_wakeup_main_function(conn, wakeup_main, info, NULL);
+
+    // Last, since this one owns 'info' and frees it with the connection.
+    dbus_connection_set_dispatch_status_function(conn, dispatch_status,
+                                                 info, conn_info_free);
+
+    if (dbus_connection_get_dispatch_status(conn) == DBUS_DISPATCH_DATA_REMAINS)
+        queue_dispatch(info);
+
+    return conn;
+}
+
+void bluez_close_bus(DBusConnection *connection)
+{
+    if (connection == NULL)
+        return;
+
+    dbus_connection_close(connection);
+    dbus_connection_unref(connection);
+}
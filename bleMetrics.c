@@ -0,0 +1,471 @@
+//
+// bleMetrics.c
+//
+// Created  10/18/2026
+//
+// Per-thread metric shards and the Prometheus text exporter.  A shard is
+// allocated the first time a thread records anything and is pushed onto a
+// lock-free list.  Only the owning thread writes a shard, so an update is
+// a relaxed load and store.  The scraper sums all shards with relaxed
+// loads.  Shards outlive their threads so that counters never go
+// backwards.
+//
+// The exporter answers each connection on its unix-domain socket with one
+// HTTP/1.0 response and then closes it.  For example:
+//
+//    curl --unix-socket /run/ble/metrics.sock http://localhost/metrics
+
+#define _GNU_SOURCE     // accept4()
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleMetrics.h"
+
+// Histogram bucket i counts observations of at most 2^i microseconds.
+#define HISTOGRAM_BUCKETS 24
+
+// Scrapers served at once, and the time each is given to send its request.
+#define METRICS_MAX_CONNECTIONS 4
+#define METRICS_READ_TIMEOUT    2       // seconds
+
+struct histogram
+{
+    atomic_uint_fast64_t bucket[HISTOGRAM_BUCKETS + 1];    // last is +Inf
+    atomic_uint_fast64_t sum_usec;
+    atomic_uint_fast64_t count;
+};
+
+struct metrics_shard
+{
+    atomic_uint_fast64_t counter[METRIC_COUNT];
+    atomic_uint_fast64_t state_usec[METRICS_MAX_STATES];
+    atomic_uint_fast64_t state_entries[METRICS_MAX_STATES];
+    struct histogram histogram[HISTOGRAM_COUNT];
+
+    // State timing is per thread, one state machine per client thread.
+    int state;
+    gint64 state_since;
+
+    struct metrics_shard *next;
+};
+
+struct bluez_metrics_server
+{
+    char *path;
+    int fd;
+    GSource *source;
+    GMainContext *context;
+    GSList *connections;
+};
+
+// A scraper connection, waiting for its request.
+struct metrics_connection
+{
+    struct bluez_metrics_server *server;
+    int fd;
+    GSource *source;
+    GSource *timeout;
+};
+
+static _Atomic(struct metrics_shard *) shards;
+static __thread struct metrics_shard *my_shard;
+
+static const char *const *state_names;
+static int state_count;
+
+static const char *const histogram_names[HISTOGRAM_COUNT] =
+{
+    [HISTOGRAM_DBUS_CALL_SECONDS] = "ble_dbus_call_seconds",
+    [HISTOGRAM_STALL_DETECT_SECONDS] = "ble_notify_stall_detect_seconds",
+    [HISTOGRAM_STALL_RECOVERY_SECONDS] = "ble_notify_stall_recovery_seconds"
+};
+
+static const char *const proxy_labels[BLUEZ_PROXY_COUNT] =
+{
+    [BLUEZ_PROXY_ADAPTER] = "interface=\"org.bluez.Adapter1\",proxy=\"adapter\"",
+    [BLUEZ_PROXY_DEVICE] = "interface=\"org.bluez.Device1\",proxy=\"device\"",
+    [BLUEZ_PROXY_CHARACTERISTIC_RD] = "interface=\"org.bluez.GattCharacteristic1\",proxy=\"characteristic_rd\"",
+    [BLUEZ_PROXY_CHARACTERISTIC_WR] = "interface=\"org.bluez.GattCharacteristic1\",proxy=\"characteristic_wr\""
+};
+
+static struct metrics_shard *shard_get(void)
+{
+    struct metrics_shard *shard = my_shard;
+
+    if (G_LIKELY(shard != NULL))
+        return shard;
+
+    shard = g_new0(struct metrics_shard, 1);
+    shard->state = -1;
+
+    shard->next = atomic_load(&shards);
+    while (!atomic_compare_exchange_weak(&shards, &shard->next, shard))
+        ;
+
+    my_shard = shard;
+    return shard;
+}
+
+// Single-writer increment.  No read-modify-write instruction is needed
+// because no other thread writes this shard.
+static inline void shard_add(atomic_uint_fast64_t *v, uint64_t n)
+{
+    atomic_store_explicit(v, atomic_load_explicit(v, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+void bluez_metrics_add(int metric, uint64_t n)
+{
+    if (metric < 0 || metric >= METRIC_COUNT)
+        return;
+
+    shard_add(&shard_get()->counter[metric], n);
+}
+
+void bluez_metrics_observe(int histogram, gint64 usec)
+{
+    struct histogram *h;
+    int i = 0;
+
+    if (histogram < 0 || histogram >= HISTOGRAM_COUNT)
+        return;
+
+    h = &shard_get()->histogram[histogram];
+
+    if (usec < 0)
+        usec = 0;
+
+    while (i < HISTOGRAM_BUCKETS && usec > ((gint64)1 << i))
+        i++;
+
+    shard_add(&h->bucket[i], 1);
+    shard_add(&h->sum_usec, usec);
+    shard_add(&h->count, 1);
+}
+
+// Names for the states passed to bluez_metrics_state(), indexed by state.
+// The array must remain valid for the life of the program.
+void bluez_metrics_set_state_names(const char *const *names, int count)
+{
+    state_names = names;
+    state_count = MIN(count, METRICS_MAX_STATES);
+}
+
+// Records a transition of the calling thread's state machine into 'state'.
+// Time spent in the previous state is added to that state's total.
+void bluez_metrics_state(int state)
+{
+    struct metrics_shard *shard = shard_get();
+    gint64 now = g_get_monotonic_time();
+
+    if (state == shard->state)
+        return;
+
+    if (shard->state >= 0 && shard->state < METRICS_MAX_STATES)
+        shard_add(&shard->state_usec[shard->state], now - shard->state_since);
+
+    if (state >= 0 && state < METRICS_MAX_STATES)
+        shard_add(&shard->state_entries[state], 1);
+
+    shard->state = state;
+    shard->state_since = now;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Exporter.
+
+static uint64_t sum_counter(size_t offset)
+{
+    struct metrics_shard *shard;
+    uint64_t total = 0;
+
+    for (shard = atomic_load(&shards); shard != NULL; shard = shard->next)
+        total += atomic_load_explicit((atomic_uint_fast64_t *)((char *)shard + offset),
+                                      memory_order_relaxed);
+
+    return total;
+}
+
+#define SUM(field) sum_counter(G_STRUCT_OFFSET(struct metrics_shard, field))
+
+static void format_counter(GString *out, const char *name, const char *help, uint64_t value)
+{
+    g_string_append_printf(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+                           name, help, name, name, (unsigned long long)value);
+}
+
+static void format_histogram(GString *out, int index)
+{
+    const char *name = histogram_names[index];
+    uint64_t cumulative = 0;
+    int i;
+
+    g_string_append_printf(out, "# TYPE %s histogram\n", name);
+
+    for (i = 0; i <= HISTOGRAM_BUCKETS; i++)
+    {
+        cumulative += SUM(histogram[index].bucket[i]);
+
+        if (i < HISTOGRAM_BUCKETS)
+            g_string_append_printf(out, "%s_bucket{le=\"%g\"} %llu\n", name,
+                                   (double)((gint64)1 << i) / G_USEC_PER_SEC,
+                                   (unsigned long long)cumulative);
+        else
+            g_string_append_printf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name,
+                                   (unsigned long long)cumulative);
+    }
+
+    g_string_append_printf(out, "%s_sum %g\n%s_count %llu\n",
+                           name, (double)SUM(histogram[index].sum_usec) / G_USEC_PER_SEC,
+                           name, (unsigned long long)SUM(histogram[index].count));
+}
+
+static GString *metrics_format(void)
+{
+    GString *out = g_string_sized_new(4096);
+    int i;
+
+    format_counter(out, "ble_notifications_total",
+                   "Notifications received.", SUM(counter[METRIC_NOTIFICATIONS]));
+    format_counter(out, "ble_notification_bytes_total",
+                   "Notification payload bytes received.", SUM(counter[METRIC_NOTIFICATION_BYTES]));
+    format_counter(out, "ble_notify_read_errors_total",
+                   "Failed reads from the notification pipe.", SUM(counter[METRIC_NOTIFY_READ_ERRORS]));
+    format_counter(out, "ble_dbus_calls_total",
+                   "D-Bus method calls issued.", SUM(counter[METRIC_DBUS_CALLS]));
+    format_counter(out, "ble_dbus_call_failures_total",
+                   "D-Bus method calls that failed to send or returned an error.",
+                   SUM(counter[METRIC_DBUS_CALL_FAILURES]));
+    format_counter(out, "ble_reconnects_total",
+                   "Reconnections after the device disconnected.", SUM(counter[METRIC_RECONNECTS]));
+    format_counter(out, "ble_rssi_suppressed_total",
+                   "RSSI updates held back by the RSSI filter.", SUM(counter[METRIC_RSSI_SUPPRESSED]));
+    format_counter(out, "ble_rejected_objects_total",
+                   "Objects dropped because their device was already screened out.",
+                   SUM(counter[METRIC_REJECTED_OBJECTS]));
+    format_counter(out, "ble_shm_dropped_total",
+                   "Values not published because the shared-memory segment was full.",
+                   SUM(counter[METRIC_SHM_DROPPED]));
+    format_counter(out, "ble_forward_dropped_total",
+                   "Datagrams or samples the forwarder could not deliver.",
+                   SUM(counter[METRIC_FORWARD_DROPPED]));
+    format_counter(out, "ble_notify_dropped_total",
+                   "Notifications dropped by the notification buffer.",
+                   SUM(counter[METRIC_NOTIFY_DROPPED]));
+    format_counter(out, "ble_wakeups_total",
+                   "Times the client thread woke for notifications or the wakeup timer.",
+                   SUM(counter[METRIC_WAKEUPS]));
+    format_counter(out, "ble_property_unchanged_total",
+                   "Property updates not reported because the value had not changed.",
+                   SUM(counter[METRIC_PROPERTY_UNCHANGED]));
+    format_counter(out, "ble_notify_stalls_total",
+                   "Times notifications stopped without a disconnect.",
+                   SUM(counter[METRIC_NOTIFY_STALLS]));
+    format_counter(out, "ble_watchdog_steps_total",
+                   "Recovery steps taken by the notification watchdog.",
+                   SUM(counter[METRIC_WATCHDOG_STEPS]));
+    format_counter(out, "ble_frames_discarded_total",
+                   "Partly received framed messages thrown away.",
+                   SUM(counter[METRIC_FRAMES_DISCARDED]));
+
+    g_string_append(out, "# HELP ble_property_events_total PropertiesChanged entries by interface.\n"
+                         "# TYPE ble_property_events_total counter\n");
+    for (i = 0; i < BLUEZ_PROXY_COUNT; i++)
+        g_string_append_printf(out, "ble_property_events_total{%s} %llu\n", proxy_labels[i],
+                               (unsigned long long)SUM(counter[METRIC_PROPERTY_EVENTS + i]));
+
+    if (state_count > 0)
+    {
+        g_string_append(out, "# HELP ble_state_seconds_total Time spent in each connection state.\n"
+                             "# TYPE ble_state_seconds_total counter\n");
+        for (i = 0; i < state_count; i++)
+            g_string_append_printf(out, "ble_state_seconds_total{state=\"%s\"} %g\n", state_names[i],
+                                   (double)SUM(state_usec[i]) / G_USEC_PER_SEC);
+
+        g_string_append(out, "# HELP ble_state_entries_total Transitions into each connection state.\n"
+                             "# TYPE ble_state_entries_total counter\n");
+        for (i = 0; i < state_count; i++)
+            g_string_append_printf(out, "ble_state_entries_total{state=\"%s\"} %llu\n", state_names[i],
+                                   (unsigned long long)SUM(state_entries[i]));
+    }
+
+    for (i = 0; i < HISTOGRAM_COUNT; i++)
+        format_histogram(out, i);
+
+    return out;
+}
+
+static void write_all(int fd, const char *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0)
+    {
+        n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        buf += n;
+        len -= n;
+    }
+}
+
+static void connection_close(struct metrics_connection *conn)
+{
+    conn->server->connections = g_slist_remove(conn->server->connections, conn);
+
+    g_source_destroy(conn->source);
+    g_source_unref(conn->source);
+    g_source_destroy(conn->timeout);
+    g_source_unref(conn->timeout);
+    close(conn->fd);
+
+    g_free(conn);
+}
+
+// The scraper's request has arrived.  Its content does not matter, every
+// request gets the full set of metrics.
+static gboolean metrics_request(gint fd, GIOCondition cond, gpointer user_data)
+{
+    struct metrics_connection *conn = user_data;
+    char request[1024];
+    char header[128];
+    GString *body;
+
+    if (read(fd, request, sizeof(request)) > 0)
+    {
+        body = metrics_format();
+
+        snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\n"
+                 "Content-Type: text/plain; version=0.0.4\r\n"
+                 "Content-Length: %zu\r\n\r\n", body->len);
+
+        write_all(fd, header, strlen(header));
+        write_all(fd, body->str, body->len);
+
+        g_string_free(body, TRUE);
+    }
+
+    connection_close(conn);
+
+    return FALSE;
+}
+
+// The scraper connected but sent nothing in time.
+static gboolean metrics_timeout(gpointer user_data)
+{
+    connection_close(user_data);
+
+    return FALSE;
+}
+
+static gboolean metrics_accept(gint fd, GIOCondition cond, gpointer user_data)
+{
+    struct bluez_metrics_server *server = user_data;
+    struct timeval timeout = { .tv_sec = 1 };
+    struct metrics_connection *conn;
+    int client;
+
+    client = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+    if (client < 0)
+        return TRUE;
+
+    // Turn away scrapers beyond the limit rather than hold an fd for each.
+    if (g_slist_length(server->connections) >= METRICS_MAX_CONNECTIONS)
+    {
+        close(client);
+        return TRUE;
+    }
+
+    // Responses are small and written synchronously; never let a stalled
+    // scraper hold up the main loop for long.
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    conn = g_new0(struct metrics_connection, 1);
+    conn->server = server;
+    conn->fd = client;
+
+    conn->source = g_unix_fd_source_new(client, G_IO_IN | G_IO_HUP | G_IO_ERR);
+    g_source_set_callback(conn->source, (GSourceFunc) metrics_request, conn, NULL);
+    g_source_attach(conn->source, server->context);
+
+    conn->timeout = g_timeout_source_new_seconds(METRICS_READ_TIMEOUT);
+    g_source_set_callback(conn->timeout, metrics_timeout, conn, NULL);
+    g_source_attach(conn->timeout, server->context);
+
+    server->connections = g_slist_prepend(server->connections, conn);
+
+    return TRUE;
+}
+
+// Serves the metrics from a unix-domain socket at 'path', on the given
+// main context (NULL for the default context).  Any existing file at
+// 'path' is replaced.
+struct bluez_metrics_server *bluez_metrics_serve(GMainContext *context, const char *path)
+{
+    struct bluez_metrics_server *server;
+    struct sockaddr_un addr;
+    int fd;
+
+    if (path == NULL || strlen(path) >= sizeof(addr.sun_path))
+        return NULL;
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return NULL;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0)
+    {
+        fprintf(stderr, "Unable to serve metrics on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    server = g_new0(struct bluez_metrics_server, 1);
+    server->path = g_strdup(path);
+    server->fd = fd;
+    server->context = g_main_context_ref(context ? context : g_main_context_default());
+
+    server->source = g_unix_fd_source_new(fd, G_IO_IN);
+    g_source_set_callback(server->source, (GSourceFunc) metrics_accept, server, NULL);
+    g_source_attach(server->source, server->context);
+
+    return server;
+}
+
+void bluez_metrics_server_free(struct bluez_metrics_server *server)
+{
+    if (server == NULL)
+        return;
+
+    while (server->connections != NULL)
+        connection_close(server->connections->data);
+
+    g_source_destroy(server->source);
+    g_source_unref(server->source);
+    close(server->fd);
+    unlink(server->path);
+
+    g_main_context_unref(server->context);
+    g_free(server->path);
+    g_free(server);
+}
@@ -0,0 +1,70 @@
+//
+// bleMetrics.h
+//
+// Created  10/18/2026
+//
+// Counters and histograms for the client, exported in Prometheus text
+// format over a unix-domain socket.  Every thread records into a shard of
+// its own, so recording is a pair of relaxed loads and stores with no
+// locked instructions.  Shards are only summed when the socket is scraped.
+
+#ifndef BLE_METRICS_H
+#define BLE_METRICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    METRIC_NOTIFICATIONS = 0,
+    METRIC_NOTIFICATION_BYTES,
+    METRIC_NOTIFY_READ_ERRORS,
+    METRIC_DBUS_CALLS,
+    METRIC_DBUS_CALL_FAILURES,
+    METRIC_RECONNECTS,
+    METRIC_RSSI_SUPPRESSED,
+    METRIC_REJECTED_OBJECTS,
+    METRIC_SHM_DROPPED,
+    METRIC_FORWARD_DROPPED,
+    METRIC_NOTIFY_DROPPED,
+    METRIC_WAKEUPS,
+    METRIC_PROPERTY_UNCHANGED,
+    METRIC_NOTIFY_STALLS,
+    METRIC_WATCHDOG_STEPS,
+    METRIC_FRAMES_DISCARDED,
+    // One property event counter for each proxy, BLUEZ_PROXY_ADAPTER etc.
+    METRIC_PROPERTY_EVENTS,
+    METRIC_COUNT = METRIC_PROPERTY_EVENTS + BLUEZ_PROXY_COUNT
+};
+
+enum {
+    HISTOGRAM_DBUS_CALL_SECONDS = 0,
+    HISTOGRAM_STALL_DETECT_SECONDS,
+    HISTOGRAM_STALL_RECOVERY_SECONDS,
+    HISTOGRAM_COUNT
+};
+
+// Maximum number of states that bluez_metrics_state() can time.
+#define METRICS_MAX_STATES 16
+
+struct bluez_metrics_server;
+
+void    bluez_metrics_add               (int metric, uint64_t n);
+void    bluez_metrics_observe           (int histogram, gint64 usec);
+void    bluez_metrics_set_state_names   (const char *const *names, int count);
+void    bluez_metrics_state             (int state);
+
+struct bluez_metrics_server *
+        bluez_metrics_serve             (GMainContext *context, const char *path);
+void    bluez_metrics_server_free       (struct bluez_metrics_server *server);
+
+static inline void bluez_metrics_inc(int metric)
+{
+    bluez_metrics_add(metric, 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLE_METRICS_H
@@ -0,0 +1,562 @@
+//
+// bleMicrobench.c
+//
+// Created  10/18/2026
+//
+// Microbenchmarks for the D-Bus parsing hot paths in bleClient.c.  Each
+// function is run in isolation against synthetic messages built here, and
+// reported as time and heap allocations per operation:
+//
+//    bluez_add_property      one tracked property from a variant
+//    bluez_screen_uuid       Device1 dictionary without the wanted UUID
+//    iter_append_iter        a full Device1 property dictionary
+//    prop_entry_update       one int16 property value
+//    update_properties       Device1 dictionary, as from GetManagedObjects
+//                            and as from PropertiesChanged
+//    parse_managed_objects   whole reply, devices that do not match, both
+//                            screened afresh and already rejected
+//    bluez_decode            IMU notification of 40 int16 xyz triplets
+//
+// Allocations are counted by interposing malloc(), which catches libdbus
+// and GLib as well as the client.
+//
+// Objects that match are left out of the GetManagedObjects tree, because
+// screening them in registers a bus watch.  "make bench" covers them.
+//
+// With -s, runs a scale sweep instead: GetManagedObjects trees of 1k to
+// 50k objects, each parsed in a child process of its own so that its
+// peak RSS is its own.  Reports the time to build the reply, the time to
+// parse it in one go, and the number and longest of the time slices the
+// client parses it in on the main loop.
+//
+// Usage:
+//    bleMicrobench [-t seconds per case] [-n devices in the tree] [-s]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleClientPrivate.h"
+#include "bleDecode.h"
+
+// Services and characteristics per device in the synthetic tree.
+#define TREE_SERVICES           2
+#define TREE_CHARACTERISTICS    3
+#define TREE_OBJECTS_PER_DEVICE (1 + TREE_SERVICES * (1 + TREE_CHARACTERISTICS))
+
+// iter_append_iter() output is collected in one message, replaced after
+// this many appends so it does not grow without bound.
+#define SINK_APPENDS            256
+
+// IMU notification: a 4-byte header and int16 x, y, z triplets.
+#define IMU_HEADER              4
+#define IMU_SAMPLES             40
+
+#define FOREIGN_UUID "0000180f-0000-1000-8000-00805f9b34fb"
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Allocation counting.
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void  __libc_free(void *ptr);
+
+static uint64_t allocs;
+
+void *malloc(size_t size)
+{
+    allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    allocs++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Synthetic messages.
+
+struct fixture
+{
+    bluez_client_t *client;
+    GDBusProxy *device;
+
+    DBusMessage *props;         // a{sv}, Device1 properties
+    DBusMessage *rssi[2];       // v, int16, two values so that each update
+    int rssiNext;               // changes the cached one
+    DBusMessage *objects;       // a{oa{sa{sv}}}, GetManagedObjects reply
+    int objectCount;
+
+    DBusMessage *sink;
+    int sinkCount;
+    struct prop_entry prop;
+
+    struct bluez_decoder decoder;
+    uint8_t imu[IMU_HEADER + IMU_SAMPLES * 3 * 2];
+    float samples[3][IMU_SAMPLES];
+    struct bluez_soa soa;
+};
+
+static void dict_open(DBusMessageIter *iter, DBusMessageIter *dict)
+{
+    dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+                                    DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+                                    DBUS_TYPE_STRING_AS_STRING
+                                    DBUS_TYPE_VARIANT_AS_STRING
+                                    DBUS_DICT_ENTRY_END_CHAR_AS_STRING, dict);
+}
+
+static void dict_append(DBusMessageIter *dict, const char *key, int type, const void *val)
+{
+    DBusMessageIter entry, value;
+    char sig[2] = { type, '\0' };
+
+    dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+    dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT, sig, &value);
+    dbus_message_iter_append_basic(&value, type, val);
+    dbus_message_iter_close_container(&entry, &value);
+    dbus_message_iter_close_container(dict, &entry);
+}
+
+static void dict_append_uuids(DBusMessageIter *dict, const char *key,
+                              const char *const *uuids, int n)
+{
+    DBusMessageIter entry, variant, array;
+    int i;
+
+    dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+    dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT, "as", &variant);
+    dbus_message_iter_open_container(&variant, DBUS_TYPE_ARRAY, "s", &array);
+    for (i = 0; i < n; i++)
+        dbus_message_iter_append_basic(&array, DBUS_TYPE_STRING, &uuids[i]);
+    dbus_message_iter_close_container(&variant, &array);
+    dbus_message_iter_close_container(&entry, &variant);
+    dbus_message_iter_close_container(dict, &entry);
+}
+
+// Device1 properties roughly as bluetoothd sends them for a scanned
+// device, but advertising none of our UUIDs.
+static void append_device_props(DBusMessageIter *iter)
+{
+    static const char *const uuids[] = {
+        "00001800-0000-1000-8000-00805f9b34fb",
+        "00001801-0000-1000-8000-00805f9b34fb",
+        "0000180a-0000-1000-8000-00805f9b34fb",
+        FOREIGN_UUID
+    };
+    const char *address = "00:A0:50:3E:47:9D", *name = "Sensor", *adapter = BLUEZ_PATH "/hci0";
+    dbus_bool_t no = FALSE;
+    int16_t rssi = -62;
+    DBusMessageIter dict;
+
+    dict_open(iter, &dict);
+    dict_append(&dict, "Address", DBUS_TYPE_STRING, &address);
+    dict_append(&dict, "Name", DBUS_TYPE_STRING, &name);
+    dict_append(&dict, "Alias", DBUS_TYPE_STRING, &name);
+    dict_append(&dict, "Paired", DBUS_TYPE_BOOLEAN, &no);
+    dict_append(&dict, "Trusted", DBUS_TYPE_BOOLEAN, &no);
+    dict_append(&dict, "Connected", DBUS_TYPE_BOOLEAN, &no);
+    dict_append_uuids(&dict, "UUIDs", uuids, G_N_ELEMENTS(uuids));
+    dict_append(&dict, "Adapter", DBUS_TYPE_OBJECT_PATH, &adapter);
+    dict_append(&dict, "RSSI", DBUS_TYPE_INT16, &rssi);
+    dict_append(&dict, "ServicesResolved", DBUS_TYPE_BOOLEAN, &no);
+    dbus_message_iter_close_container(iter, &dict);
+}
+
+static void append_object(DBusMessageIter *objects, const char *path,
+                          const char *interface, int kind)
+{
+    DBusMessageIter entry, ifaces, ientry, dict;
+    const char *introspectable = DBUS_INTERFACE_INTROSPECTABLE;
+    const char *uuid = FOREIGN_UUID;
+    dbus_bool_t yes = TRUE;
+
+    dbus_message_iter_open_container(objects, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_OBJECT_PATH, &path);
+    dbus_message_iter_open_container(&entry, DBUS_TYPE_ARRAY, "{sa{sv}}", &ifaces);
+
+    // Every object also carries Introspectable, which the client skips.
+    dbus_message_iter_open_container(&ifaces, DBUS_TYPE_DICT_ENTRY, NULL, &ientry);
+    dbus_message_iter_append_basic(&ientry, DBUS_TYPE_STRING, &introspectable);
+    dict_open(&ientry, &dict);
+    dbus_message_iter_close_container(&ientry, &dict);
+    dbus_message_iter_close_container(&ifaces, &ientry);
+
+    dbus_message_iter_open_container(&ifaces, DBUS_TYPE_DICT_ENTRY, NULL, &ientry);
+    dbus_message_iter_append_basic(&ientry, DBUS_TYPE_STRING, &interface);
+    if (0 == kind)
+        append_device_props(&ientry);
+    else
+    {
+        dict_open(&ientry, &dict);
+        dict_append(&dict, "UUID", DBUS_TYPE_STRING, &uuid);
+        dict_append(&dict, "Primary", DBUS_TYPE_BOOLEAN, &yes);
+        dbus_message_iter_close_container(&ientry, &dict);
+    }
+    dbus_message_iter_close_container(&ifaces, &ientry);
+
+    dbus_message_iter_close_container(&entry, &ifaces);
+    dbus_message_iter_close_container(objects, &entry);
+}
+
+static DBusMessage *build_objects(int devices, int *count)
+{
+    DBusMessage *msg = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+    DBusMessageIter iter, objects;
+    char dev[64], svc[80], chr[96];
+    int i, s, c;
+
+    *count = 0;
+
+    dbus_message_iter_init_append(msg, &iter);
+    dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{oa{sa{sv}}}", &objects);
+
+    for (i = 0; i < devices; i++)
+    {
+        snprintf(dev, sizeof(dev), BLUEZ_PATH "/hci0/dev_00_A0_50_%02X_%02X_%02X",
+                 (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+        append_object(&objects, dev, "org.bluez.Device1", 0);
+        (*count)++;
+
+        for (s = 0; s < TREE_SERVICES; s++)
+        {
+            snprintf(svc, sizeof(svc), "%s/service%04x", dev, 0x0c + s * 0x10);
+            append_object(&objects, svc, "org.bluez.GattService1", 1);
+            (*count)++;
+
+            for (c = 0; c < TREE_CHARACTERISTICS; c++)
+            {
+                snprintf(chr, sizeof(chr), "%s/char%04x", svc, 0x0d + s * 0x10 + c * 3);
+                append_object(&objects, chr, "org.bluez.GattCharacteristic1", 1);
+                (*count)++;
+            }
+        }
+    }
+
+    dbus_message_iter_close_container(&iter, &objects);
+
+    return msg;
+}
+
+static void fixture_init(struct fixture *f, int devices)
+{
+    static const struct bluez_schema imu =
+        BLUEZ_SCHEMA(IMU_HEADER, BLUEZ_DECODE_INT16, 3, 1 / 16384.0f, 1 / 16384.0f, 1 / 16384.0f);
+    DBusMessageIter iter, value;
+    int16_t rssi[2] = { -70, -71 };
+    size_t i;
+
+    f->client = bluez_client_new(NULL, NULL);
+    f->device = bluez_client_get_proxy(f->client, BLUEZ_PROXY_DEVICE);
+    f->device->client = &f->client->gdbus;
+
+    f->props = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+    dbus_message_iter_init_append(f->props, &iter);
+    append_device_props(&iter);
+
+    for (i = 0; i < 2; i++)
+    {
+        f->rssi[i] = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+        dbus_message_iter_init_append(f->rssi[i], &iter);
+        dbus_message_iter_open_container(&iter, DBUS_TYPE_VARIANT, "n", &value);
+        dbus_message_iter_append_basic(&value, DBUS_TYPE_INT16, &rssi[i]);
+        dbus_message_iter_close_container(&iter, &value);
+    }
+
+    f->objects = build_objects(devices, &f->objectCount);
+
+    bluez_decoder_init(&f->decoder, &imu);
+    for (i = 0; i < sizeof(f->imu); i++)
+        f->imu[i] = i * 37;
+    for (i = 0; i < 3; i++)
+        f->soa.field[i] = f->samples[i];
+    f->soa.capacity = IMU_SAMPLES;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Cases.  Each runs one operation.
+
+// Alternates between two values, since a repeated one returns early.
+static void case_add_property(struct fixture *f)
+{
+    DBusMessageIter iter;
+
+    dbus_message_iter_init(f->rssi[f->rssiNext ^= 1], &iter);
+    bluez_add_property(f->device, "RSSI", &iter, FALSE);
+}
+
+static void case_screen_uuid(struct fixture *f)
+{
+    DBusMessageIter iter;
+
+    dbus_message_iter_init(f->props, &iter);
+    if (bluez_screen_uuid(&iter, UUID_DEVICE) == TRUE)
+        abort();
+}
+
+static void case_append_iter(struct fixture *f)
+{
+    DBusMessageIter iter, base;
+
+    if (f->sink == NULL || ++f->sinkCount == SINK_APPENDS)
+    {
+        if (f->sink != NULL)
+            dbus_message_unref(f->sink);
+        f->sink = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+        f->sinkCount = 0;
+    }
+
+    dbus_message_iter_init(f->props, &iter);
+    dbus_message_iter_init_append(f->sink, &base);
+    iter_append_iter(&base, &iter);
+}
+
+static void case_prop_entry_update(struct fixture *f)
+{
+    DBusMessageIter iter, value;
+
+    dbus_message_iter_init(f->rssi[0], &iter);
+    dbus_message_iter_recurse(&iter, &value);
+    prop_entry_update(&f->prop, &value);
+}
+
+static void case_update_properties(struct fixture *f)
+{
+    DBusMessageIter iter;
+
+    dbus_message_iter_init(f->props, &iter);
+    update_properties(f->device, &iter, FALSE);
+}
+
+static void case_update_properties_changed(struct fixture *f)
+{
+    DBusMessageIter iter;
+
+    dbus_message_iter_init(f->props, &iter);
+    update_properties(f->device, &iter, TRUE);
+}
+
+// Every device is screened, as on first contact.
+static void case_parse_managed_objects(struct fixture *f)
+{
+    reject_cache_clear(&f->client->rejected);
+    parse_managed_objects(&f->client->gdbus, f->objects);
+}
+
+// Every device has already been rejected.
+static void case_parse_managed_objects_rejected(struct fixture *f)
+{
+    parse_managed_objects(&f->client->gdbus, f->objects);
+}
+
+static void case_decode(struct fixture *f)
+{
+    f->soa.count = 0;
+    if (bluez_decode(&f->decoder, f->imu, sizeof(f->imu), &f->soa) != IMU_SAMPLES)
+        abort();
+}
+
+struct bench_case
+{
+    const char *name;
+    void (*fn)(struct fixture *f);
+};
+
+static const struct bench_case cases[] = {
+    { "bluez_add_property",         case_add_property },
+    { "bluez_screen_uuid",          case_screen_uuid },
+    { "iter_append_iter",           case_append_iter },
+    { "prop_entry_update",          case_prop_entry_update },
+    { "update_properties",          case_update_properties },
+    { "update_properties/changed",  case_update_properties_changed },
+    { "parse_managed_objects",      case_parse_managed_objects },
+    { "parse_managed_objects/rej",  case_parse_managed_objects_rejected },
+    { "bluez_decode",               case_decode },
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Doubles the iteration count until one batch takes long enough to time,
+// then runs batches until the case has had its share of time.
+static void run_case(const struct bench_case *c, struct fixture *f, double seconds)
+{
+    uint64_t iterations = 1, ops = 0, elapsed = 0, start, allocStart, i;
+    uint64_t budget = seconds * 1e9;
+
+    for ( ; ; iterations *= 2)
+    {
+        start = now_ns();
+        for (i = 0; i < iterations; i++)
+            c->fn(f);
+        if (now_ns() - start > budget / 20)
+            break;
+    }
+
+    allocStart = allocs;
+    while (elapsed < budget)
+    {
+        start = now_ns();
+        for (i = 0; i < iterations; i++)
+            c->fn(f);
+        elapsed += now_ns() - start;
+        ops += iterations;
+    }
+
+    printf("%-28s %12.1f ns/op %10.2f allocs/op", c->name,
+           (double)elapsed / ops, (double)(allocs - allocStart) / ops);
+
+    if (c->fn == case_parse_managed_objects || c->fn == case_parse_managed_objects_rejected)
+        printf("   (%d objects, %.1f ns/object)", f->objectCount,
+               (double)elapsed / ops / f->objectCount);
+
+    printf("\n");
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Scale sweep.
+
+static const int scaleObjects[] = { 1000, 5000, 10000, 25000, 50000 };
+
+static void scale_child(int objects)
+{
+    bluez_client_t *client = bluez_client_new(NULL, NULL);
+    GDBusClient *gdbus = &client->gdbus;
+    DBusMessage *msg;
+    gint64 start, built, parsed, slice, longest = 0;
+    struct rusage usage;
+    int count, slices = 0;
+    gboolean more;
+
+    start = g_get_monotonic_time();
+    msg = build_objects(MAX(objects / TREE_OBJECTS_PER_DEVICE, 1), &count);
+    built = g_get_monotonic_time();
+
+    parse_managed_objects(gdbus, msg);
+    parsed = g_get_monotonic_time();
+    reject_cache_clear(&client->rejected);
+
+    // Same slicing as the idle source in bleClient.c.
+    parse_objects_begin(gdbus, msg);
+    do {
+        slice = g_get_monotonic_time();
+        more = parse_objects_step(gdbus, slice + OBJECTS_SLICE_US);
+        slice = g_get_monotonic_time() - slice;
+        longest = MAX(longest, slice);
+        slices++;
+    } while (more);
+    parse_objects_finish(gdbus);
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("%8d %10.1f %10.1f %8d %10.2f %10.1f\n", count,
+           (built - start) / 1e3, (parsed - built) / 1e3,
+           slices, longest / 1e3, usage.ru_maxrss / 1024.0);
+    fflush(stdout);
+}
+
+static int run_scale(void)
+{
+    size_t i;
+    pid_t pid;
+    int status;
+
+    printf("%8s %10s %10s %8s %10s %10s\n",
+           "objects", "build_ms", "parse_ms", "slices", "slice_max", "rss_mb");
+    fflush(stdout);
+
+    for (i = 0; i < G_N_ELEMENTS(scaleObjects); i++)
+    {
+        pid = fork();
+        if (pid < 0)
+        {
+            perror("fork");
+            return 1;
+        }
+
+        if (0 == pid)
+        {
+            scale_child(scaleObjects[i]);
+            _exit(0);
+        }
+
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            fprintf(stderr, "bleMicrobench: %d objects failed\n", scaleObjects[i]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: bleMicrobench [-t seconds per case] [-n devices in the tree] [-s]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct fixture f = { NULL };
+    double seconds = 1.0;
+    int devices = 100;
+    gboolean scale = FALSE;
+    size_t i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:n:s")) != -1)
+    {
+        switch (opt)
+        {
+            case 't': seconds = atof(optarg); break;
+            case 'n': devices = atoi(optarg); break;
+            case 's': scale = TRUE; break;
+            default:  usage();
+        }
+    }
+
+    if (seconds <= 0 || devices < 1)
+        usage();
+
+    if (scale)
+        return run_scale();
+
+    fixture_init(&f, devices);
+
+    for (i = 0; i < G_N_ELEMENTS(cases); i++)
+        run_case(&cases[i], &f, seconds);
+
+    return 0;
+}
@@ -0,0 +1,688 @@
+//
+// bleMock.c
+//
+// Created  10/18/2026
+//
+// Stand-in for the BlueZ daemon, for benchmarking the client without a
+// radio.  Owns the name org.bluez on whatever bus it is started on,
+// normally a private session bus from dbus-run-session, and implements
+// just enough of ObjectManager, Adapter1, Device1 and GattCharacteristic1
+// for the client to go through its whole startup:
+//
+//    - the adapter starts powered off and is powered on through
+//      Properties.Set
+//    - StartDiscovery announces the advertisers with InterfacesAdded and
+//      then sends an RSSI update for each one on every advertising tick
+//    - Connect on the target device announces its characteristics and
+//      sets ServicesResolved
+//    - AcquireNotify and AcquireWrite hand out one end of a socketpair.
+//      Notifications are sent through it at the configured rate.
+//    - WriteValue and ReadValue reply immediately
+//
+// Usage:
+//    bleMock [-a advertisers] [-r notifications/s] [-p payload bytes]
+//            [-i advertising interval ms] [-d disconnect every s]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+
+#define ADAPTER_PATH    BLUEZ_PATH "/hci0"
+#define SERVICE_SUFFIX  "/service000c"
+#define CHAR_RD_SUFFIX  SERVICE_SUFFIX "/char000d"
+#define CHAR_WR_SUFFIX  SERVICE_SUFFIX "/char0010"
+
+#define MOCK_MTU        247
+#define MOCK_PATH_MAX   64
+
+#define IFACE_ADAPTER   "org.bluez.Adapter1"
+#define IFACE_DEVICE    "org.bluez.Device1"
+#define IFACE_SERVICE   "org.bluez.GattService1"
+#define IFACE_CHAR      "org.bluez.GattCharacteristic1"
+
+struct mock_device
+{
+    char path[MOCK_PATH_MAX];
+    int16_t rssi;
+    gboolean target;            // advertises UUID_DEVICE
+    gboolean announced;
+    gboolean connected;
+    gboolean resolved;
+};
+
+struct mock
+{
+    DBusConnection *conn;
+
+    // Scenario.
+    int advertisers;
+    int rate;
+    int payload;
+    int advInterval;
+    int disconnectEvery;
+
+    gboolean powered;
+    gboolean discovering;
+    guint advTimer;
+
+    struct mock_device *device;
+    gboolean servicesAnnounced;
+
+    // Notification stream to the client.
+    int notifyFd;
+    guint notifyTimer;
+    gint64 notifyStart;
+    uint64_t notifySent;
+    uint8_t *notifyBuf;
+
+    // AcquireWrite pipe from the client.
+    int writeFd;
+    guint writeWatch;
+    uint64_t writesReceived;
+};
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Message building.
+
+static void append_variant(DBusMessageIter *iter, int type, const void *val)
+{
+    DBusMessageIter value;
+    char sig[2] = { type, '\0' };
+
+    dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, sig, &value);
+    dbus_message_iter_append_basic(&value, type, val);
+    dbus_message_iter_close_container(iter, &value);
+}
+
+static void dict_append(DBusMessageIter *dict, const char *key, int type, const void *val)
+{
+    DBusMessageIter entry;
+
+    dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+    append_variant(&entry, type, val);
+    dbus_message_iter_close_container(dict, &entry);
+}
+
+static void dict_append_bool(DBusMessageIter *dict, const char *key, gboolean value)
+{
+    dbus_bool_t b = value;
+
+    dict_append(dict, key, DBUS_TYPE_BOOLEAN, &b);
+}
+
+static void dict_append_strings(DBusMessageIter *dict, const char *key, const char *value)
+{
+    DBusMessageIter entry, variant, array;
+
+    dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+    dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT, "as", &variant);
+    dbus_message_iter_open_container(&variant, DBUS_TYPE_ARRAY, "s", &array);
+    dbus_message_iter_append_basic(&array, DBUS_TYPE_STRING, &value);
+    dbus_message_iter_close_container(&variant, &array);
+    dbus_message_iter_close_container(&entry, &variant);
+    dbus_message_iter_close_container(dict, &entry);
+}
+
+static void open_dict(DBusMessageIter *iter, DBusMessageIter *dict)
+{
+    dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+                                    DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+                                    DBUS_TYPE_STRING_AS_STRING
+                                    DBUS_TYPE_VARIANT_AS_STRING
+                                    DBUS_DICT_ENTRY_END_CHAR_AS_STRING, dict);
+}
+
+// Appends one interface with its properties, as an entry of a{sa{sv}}.
+static void append_interface(struct mock *mock, DBusMessageIter *ifaces,
+                             const char *path, const char *iface)
+{
+    DBusMessageIter entry, props;
+    struct mock_device *dev = &mock->device[0];
+    int i;
+
+    dbus_message_iter_open_container(ifaces, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &iface);
+    open_dict(&entry, &props);
+
+    if (!strcmp(iface, IFACE_ADAPTER))
+    {
+        dict_append_bool(&props, "Powered", mock->powered);
+        dict_append_bool(&props, "Discovering", mock->discovering);
+    }
+    else if (!strcmp(iface, IFACE_DEVICE))
+    {
+        for (i = 0; i < mock->advertisers; i++)
+            if (!strcmp(mock->device[i].path, path))
+                dev = &mock->device[i];
+
+        dict_append_strings(&props, "UUIDs", dev->target ? UUID_DEVICE
+                                    : "0000180f-0000-1000-8000-00805f9b34fb");
+        dict_append(&props, "RSSI", DBUS_TYPE_INT16, &dev->rssi);
+        dict_append_bool(&props, "Connected", dev->connected);
+        dict_append_bool(&props, "ServicesResolved", dev->resolved);
+    }
+    else if (!strcmp(iface, IFACE_CHAR))
+    {
+        gboolean rd = g_str_has_suffix(path, CHAR_RD_SUFFIX);
+        const char *uuid = rd ? UUID_CHARACTERISTIC_RD : UUID_CHARACTERISTIC_WR;
+
+        dict_append(&props, "UUID", DBUS_TYPE_STRING, &uuid);
+        if (rd)
+            dict_append_bool(&props, "NotifyAcquired", mock->notifyFd >= 0);
+    }
+
+    dbus_message_iter_close_container(&entry, &props);
+    dbus_message_iter_close_container(ifaces, &entry);
+}
+
+// Appends one object as an entry of a{oa{sa{sv}}}.
+static void append_object(struct mock *mock, DBusMessageIter *objects,
+                          const char *path, const char *iface)
+{
+    DBusMessageIter entry, ifaces;
+
+    dbus_message_iter_open_container(objects, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_OBJECT_PATH, &path);
+    dbus_message_iter_open_container(&entry, DBUS_TYPE_ARRAY, "{sa{sv}}", &ifaces);
+    append_interface(mock, &ifaces, path, iface);
+    dbus_message_iter_close_container(&entry, &ifaces);
+    dbus_message_iter_close_container(objects, &entry);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Signals.
+
+static void emit_changed(struct mock *mock, const char *path, const char *iface,
+                         const char *name, int type, const void *value)
+{
+    DBusMessage *msg;
+    DBusMessageIter iter, dict, invalidated;
+
+    msg = dbus_message_new_signal(path, DBUS_INTERFACE_PROPERTIES, "PropertiesChanged");
+    dbus_message_iter_init_append(msg, &iter);
+    dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &iface);
+    open_dict(&iter, &dict);
+    dict_append(&dict, name, type, value);
+    dbus_message_iter_close_container(&iter, &dict);
+    dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "s", &invalidated);
+    dbus_message_iter_close_container(&iter, &invalidated);
+
+    dbus_connection_send(mock->conn, msg, NULL);
+    dbus_message_unref(msg);
+}
+
+static void emit_changed_bool(struct mock *mock, const char *path, const char *iface,
+                              const char *name, gboolean value)
+{
+    dbus_bool_t b = value;
+
+    emit_changed(mock, path, iface, name, DBUS_TYPE_BOOLEAN, &b);
+}
+
+static void emit_added(struct mock *mock, const char *path, const char *iface)
+{
+    DBusMessage *msg;
+    DBusMessageIter iter, ifaces;
+
+    msg = dbus_message_new_signal(ROOT_PATH, DBUS_INTERFACE_DBUS ".ObjectManager",
+                                  "InterfacesAdded");
+    dbus_message_iter_init_append(msg, &iter);
+    dbus_message_iter_append_basic(&iter, DBUS_TYPE_OBJECT_PATH, &path);
+    dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sa{sv}}", &ifaces);
+    append_interface(mock, &ifaces, path, iface);
+    dbus_message_iter_close_container(&iter, &ifaces);
+
+    dbus_connection_send(mock->conn, msg, NULL);
+    dbus_message_unref(msg);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Scenario timers.
+
+static gboolean advertise(gpointer user_data)
+{
+    struct mock *mock = user_data;
+    struct mock_device *dev;
+    int i;
+
+    for (i = 0; i < mock->advertisers; i++)
+    {
+        dev = &mock->device[i];
+
+        if (!dev->announced)
+        {
+            dev->announced = TRUE;
+            emit_added(mock, dev->path, IFACE_DEVICE);
+            continue;
+        }
+
+        dev->rssi = -40 - g_random_int_range(0, 50);
+        emit_changed(mock, dev->path, IFACE_DEVICE, "RSSI", DBUS_TYPE_INT16, &dev->rssi);
+    }
+
+    return TRUE;
+}
+
+static void notify_stop(struct mock *mock)
+{
+    char path[MOCK_PATH_MAX];
+
+    if (mock->notifyTimer)
+        g_source_remove(mock->notifyTimer);
+    mock->notifyTimer = 0;
+
+    if (mock->notifyFd < 0)
+        return;
+
+    close(mock->notifyFd);
+    mock->notifyFd = -1;
+
+    snprintf(path, sizeof(path), "%s" CHAR_RD_SUFFIX, mock->device[0].path);
+    emit_changed_bool(mock, path, IFACE_CHAR, "NotifyAcquired", FALSE);
+}
+
+// Sends however many notifications are due at the configured rate since
+// the stream started.  Ticks every millisecond, so rates above 1 kHz go
+// out in small bursts.
+static gboolean notify_tick(gpointer user_data)
+{
+    struct mock *mock = user_data;
+    uint64_t due;
+
+    due = (uint64_t)(g_get_monotonic_time() - mock->notifyStart) * mock->rate / G_USEC_PER_SEC;
+
+    while (mock->notifySent < due)
+    {
+        // Sequence number in the first bytes, so consumers can check
+        // ordering and loss.
+        memcpy(mock->notifyBuf, &mock->notifySent, MIN(mock->payload, 8));
+
+        if (send(mock->notifyFd, mock->notifyBuf, mock->payload, MSG_DONTWAIT) < 0)
+        {
+            if (errno == EAGAIN)
+                break;
+
+            notify_stop(mock);
+            return FALSE;
+        }
+
+        mock->notifySent++;
+    }
+
+    return TRUE;
+}
+
+static gboolean write_readable(gint fd, GIOCondition cond, gpointer user_data)
+{
+    struct mock *mock = user_data;
+    uint8_t buf[512];
+
+    if ((cond & G_IO_IN) && read(fd, buf, sizeof(buf)) > 0)
+    {
+        mock->writesReceived++;
+        return TRUE;
+    }
+
+    close(fd);
+    mock->writeFd = -1;
+    mock->writeWatch = 0;
+
+    return FALSE;
+}
+
+static gboolean resolve_services(gpointer user_data)
+{
+    struct mock *mock = user_data;
+    struct mock_device *dev = &mock->device[0];
+    char path[MOCK_PATH_MAX];
+
+    if (!mock->servicesAnnounced)
+    {
+        mock->servicesAnnounced = TRUE;
+
+        snprintf(path, sizeof(path), "%s" SERVICE_SUFFIX, dev->path);
+        emit_added(mock, path, IFACE_SERVICE);
+        snprintf(path, sizeof(path), "%s" CHAR_RD_SUFFIX, dev->path);
+        emit_added(mock, path, IFACE_CHAR);
+        snprintf(path, sizeof(path), "%s" CHAR_WR_SUFFIX, dev->path);
+        emit_added(mock, path, IFACE_CHAR);
+    }
+
+    dev->resolved = TRUE;
+    emit_changed_bool(mock, dev->path, IFACE_DEVICE, "ServicesResolved", TRUE);
+
+    return FALSE;
+}
+
+// Disconnect injection: the link drops without warning, as it does when a
+// peripheral goes out of range.
+static gboolean inject_disconnect(gpointer user_data)
+{
+    struct mock *mock = user_data;
+    struct mock_device *dev = &mock->device[0];
+
+    if (!dev->connected)
+        return TRUE;
+
+    fprintf(stderr, "bleMock: injecting disconnect\n");
+
+    notify_stop(mock);
+
+    dev->resolved = FALSE;
+    emit_changed_bool(mock, dev->path, IFACE_DEVICE, "ServicesResolved", FALSE);
+    dev->connected = FALSE;
+    emit_changed_bool(mock, dev->path, IFACE_DEVICE, "Connected", FALSE);
+
+    return TRUE;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Method calls.
+
+static DBusMessage *get_managed_objects(struct mock *mock, DBusMessage *msg)
+{
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    DBusMessageIter iter, objects;
+    char path[MOCK_PATH_MAX];
+    int i;
+
+    dbus_message_iter_init_append(reply, &iter);
+    dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{oa{sa{sv}}}", &objects);
+
+    append_object(mock, &objects, ADAPTER_PATH, IFACE_ADAPTER);
+
+    for (i = 0; i < mock->advertisers; i++)
+        if (mock->device[i].announced)
+            append_object(mock, &objects, mock->device[i].path, IFACE_DEVICE);
+
+    if (mock->servicesAnnounced)
+    {
+        snprintf(path, sizeof(path), "%s" CHAR_RD_SUFFIX, mock->device[0].path);
+        append_object(mock, &objects, path, IFACE_CHAR);
+        snprintf(path, sizeof(path), "%s" CHAR_WR_SUFFIX, mock->device[0].path);
+        append_object(mock, &objects, path, IFACE_CHAR);
+    }
+
+    dbus_message_iter_close_container(&iter, &objects);
+
+    return reply;
+}
+
+static DBusMessage *set_property(struct mock *mock, DBusMessage *msg)
+{
+    DBusMessageIter iter, variant;
+    const char *iface, *name;
+    dbus_bool_t value;
+
+    if (!dbus_message_iter_init(msg, &iter))
+        return NULL;
+
+    dbus_message_iter_get_basic(&iter, &iface);
+    dbus_message_iter_next(&iter);
+    dbus_message_iter_get_basic(&iter, &name);
+    dbus_message_iter_next(&iter);
+    dbus_message_iter_recurse(&iter, &variant);
+
+    if (strcmp(iface, IFACE_ADAPTER) || strcmp(name, "Powered") ||
+        dbus_message_iter_get_arg_type(&variant) != DBUS_TYPE_BOOLEAN)
+        return dbus_message_new_error(msg, "org.bluez.Error.NotSupported", name);
+
+    dbus_message_iter_get_basic(&variant, &value);
+    mock->powered = value;
+    emit_changed_bool(mock, ADAPTER_PATH, IFACE_ADAPTER, "Powered", mock->powered);
+
+    return dbus_message_new_method_return(msg);
+}
+
+static DBusMessage *adapter_method(struct mock *mock, DBusMessage *msg, const char *member)
+{
+    if (!strcmp(member, "StartDiscovery"))
+    {
+        if (!mock->discovering)
+        {
+            mock->discovering = TRUE;
+            emit_changed_bool(mock, ADAPTER_PATH, IFACE_ADAPTER, "Discovering", TRUE);
+            mock->advTimer = g_timeout_add(mock->advInterval, advertise, mock);
+        }
+    }
+    else if (!strcmp(member, "StopDiscovery"))
+    {
+        if (mock->discovering)
+        {
+            g_source_remove(mock->advTimer);
+            mock->advTimer = 0;
+            mock->discovering = FALSE;
+            emit_changed_bool(mock, ADAPTER_PATH, IFACE_ADAPTER, "Discovering", FALSE);
+        }
+    }
+    else if (strcmp(member, "SetDiscoveryFilter"))
+        return NULL;
+
+    return dbus_message_new_method_return(msg);
+}
+
+static DBusMessage *device_method(struct mock *mock, DBusMessage *msg, const char *member)
+{
+    struct mock_device *dev = &mock->device[0];
+
+    if (strcmp(member, "Connect"))
+        return NULL;
+
+    if (strcmp(dbus_message_get_path(msg), dev->path))
+        return dbus_message_new_error(msg, "org.bluez.Error.Failed", "Not connectable");
+
+    if (!dev->connected)
+    {
+        dev->connected = TRUE;
+        emit_changed_bool(mock, dev->path, IFACE_DEVICE, "Connected", TRUE);
+        g_timeout_add(10, resolve_services, mock);
+    }
+
+    return dbus_message_new_method_return(msg);
+}
+
+// Hands the client one end of a new socketpair and keeps the other.
+static DBusMessage *acquire(struct mock *mock, DBusMessage *msg, int *fd)
+{
+    DBusMessage *reply;
+    uint16_t mtu = MOCK_MTU;
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0)
+        return dbus_message_new_error(msg, "org.bluez.Error.Failed", strerror(errno));
+
+    reply = dbus_message_new_method_return(msg);
+    dbus_message_append_args(reply, DBUS_TYPE_UNIX_FD, &sv[1],
+                                    DBUS_TYPE_UINT16, &mtu,
+                                    DBUS_TYPE_INVALID);
+
+    // libdbus has duplicated the client's end.
+    close(sv[1]);
+    *fd = sv[0];
+
+    return reply;
+}
+
+static DBusMessage *characteristic_method(struct mock *mock, DBusMessage *msg,
+                                          const char *member)
+{
+    const char *path = dbus_message_get_path(msg);
+    DBusMessage *reply;
+
+    if (!strcmp(member, "AcquireNotify") && g_str_has_suffix(path, CHAR_RD_SUFFIX))
+    {
+        if (mock->notifyFd >= 0)
+            return dbus_message_new_error(msg, "org.bluez.Error.InProgress", "Notify acquired");
+
+        reply = acquire(mock, msg, &mock->notifyFd);
+        if (mock->notifyFd < 0)
+            return reply;
+
+        emit_changed_bool(mock, path, IFACE_CHAR, "NotifyAcquired", TRUE);
+
+        mock->notifyStart = g_get_monotonic_time();
+        mock->notifySent = 0;
+        mock->notifyTimer = g_timeout_add(1, notify_tick, mock);
+
+        return reply;
+    }
+
+    if (!strcmp(member, "AcquireWrite"))
+    {
+        if (mock->writeFd >= 0)
+            return dbus_message_new_error(msg, "org.bluez.Error.InProgress", "Write acquired");
+
+        reply = acquire(mock, msg, &mock->writeFd);
+        if (mock->writeFd >= 0)
+            mock->writeWatch = g_unix_fd_add(mock->writeFd, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                             write_readable, mock);
+        return reply;
+    }
+
+    if (!strcmp(member, "WriteValue"))
+    {
+        mock->writesReceived++;
+        return dbus_message_new_method_return(msg);
+    }
+
+    if (!strcmp(member, "ReadValue"))
+    {
+        DBusMessageIter iter, array;
+
+        reply = dbus_message_new_method_return(msg);
+        dbus_message_iter_init_append(reply, &iter);
+        dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "y", &array);
+        dbus_message_iter_append_fixed_array(&array, DBUS_TYPE_BYTE,
+                                             &mock->notifyBuf, mock->payload);
+        dbus_message_iter_close_container(&iter, &array);
+        return reply;
+    }
+
+    return NULL;
+}
+
+static DBusHandlerResult mock_filter(DBusConnection *conn, DBusMessage *msg, void *user_data)
+{
+    struct mock *mock = user_data;
+    const char *iface, *member;
+    DBusMessage *reply = NULL;
+
+    if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    iface = dbus_message_get_interface(msg);
+    member = dbus_message_get_member(msg);
+    if (iface == NULL || member == NULL)
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    if (!strcmp(iface, DBUS_INTERFACE_DBUS ".ObjectManager") && !strcmp(member, "GetManagedObjects"))
+        reply = get_managed_objects(mock, msg);
+    else if (!strcmp(iface, DBUS_INTERFACE_PROPERTIES) && !strcmp(member, "Set"))
+        reply = set_property(mock, msg);
+    else if (!strcmp(iface, IFACE_ADAPTER))
+        reply = adapter_method(mock, msg, member);
+    else if (!strcmp(iface, IFACE_DEVICE))
+        reply = device_method(mock, msg, member);
+    else if (!strcmp(iface, IFACE_CHAR))
+        reply = characteristic_method(mock, msg, member);
+
+    if (reply == NULL)
+        reply = dbus_message_new_error(msg, DBUS_ERROR_UNKNOWN_METHOD, member);
+
+    if (!dbus_message_get_no_reply(msg))
+        dbus_connection_send(conn, reply, NULL);
+
+    dbus_message_unref(reply);
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: bleMock [-a advertisers] [-r notifications/s] [-p payload bytes]\n"
+                    "               [-i advertising interval ms] [-d disconnect every s]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct mock mock = {
+        .advertisers = 1,
+        .rate = 100,
+        .payload = 20,
+        .advInterval = 100,
+        .notifyFd = -1,
+        .writeFd = -1
+    };
+    GMainLoop *loop;
+    DBusError error;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "a:r:p:i:d:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'a': mock.advertisers = atoi(optarg); break;
+            case 'r': mock.rate = atoi(optarg); break;
+            case 'p': mock.payload = atoi(optarg); break;
+            case 'i': mock.advInterval = atoi(optarg); break;
+            case 'd': mock.disconnectEvery = atoi(optarg); break;
+            default:  usage();
+        }
+    }
+
+    if (mock.advertisers < 1 || mock.rate < 1 || mock.payload < 1 ||
+        mock.payload > MOCK_MTU - 3 || mock.advInterval < 1)
+        usage();
+
+    // Device 0 is the one the client is looking for, the rest are noise.
+    mock.device = g_new0(struct mock_device, mock.advertisers);
+    for (i = 0; i < mock.advertisers; i++)
+    {
+        snprintf(mock.device[i].path, MOCK_PATH_MAX, ADAPTER_PATH "/dev_00_A0_50_%02X_%02X_%02X",
+                 (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+        mock.device[i].rssi = -60;
+        mock.device[i].target = (0 == i);
+    }
+
+    mock.notifyBuf = g_malloc0(mock.payload);
+
+    loop = g_main_loop_new(NULL, FALSE);
+
+    mock.conn = bluez_setup_bus(DBUS_BUS_SESSION, NULL);
+    if (mock.conn == NULL)
+        return 1;
+
+    dbus_connection_add_filter(mock.conn, mock_filter, &mock, NULL);
+
+    dbus_error_init(&error);
+    if (dbus_bus_request_name(mock.conn, BLUEZ_SERVICE, DBUS_NAME_FLAG_DO_NOT_QUEUE,
+                              &error) != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER)
+    {
+        fprintf(stderr, "bleMock: unable to own %s: %s\n", BLUEZ_SERVICE,
+                dbus_error_is_set(&error) ? error.message : "name taken");
+        return 1;
+    }
+
+    if (mock.disconnectEvery > 0)
+        g_timeout_add_seconds(mock.disconnectEvery, inject_disconnect, &mock);
+
+    g_main_loop_run(loop);
+
+    return 0;
+}
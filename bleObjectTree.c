@@ -0,0 +1,195 @@
+//
+// bleObjectTree.c
+//
+// Created  10/18/2026
+//
+// Path-trie mirror of the BlueZ object tree, see bleObjectTree.h.
+
+#include <string.h>
+#include <glib.h>
+
+#include "bleObjectTree.h"
+
+static struct object_node *node_new(const char *name, size_t len, struct object_node *parent)
+{
+    struct object_node *node = g_new0(struct object_node, 1);
+
+    node->name = g_strndup(name, len);
+    node->parent = parent;
+    node->role = -1;
+
+    return node;
+}
+
+static void node_free(gpointer data)
+{
+    struct object_node *node = data;
+
+    if (node->children != NULL)
+        g_hash_table_destroy(node->children);
+
+    g_free(node->name);
+    g_free(node);
+}
+
+// Walks 'path' one component at a time, creating missing nodes if
+// 'create' is TRUE.
+static struct object_node *walk(struct object_tree *tree, const char *path, gboolean create)
+{
+    struct object_node *node = tree->root, *child;
+    const char *start = path, *end;
+    char name[64];
+    size_t len;
+
+    while (*start != '\0')
+    {
+        while (*start == '/')
+            start++;
+        if (*start == '\0')
+            break;
+
+        end = strchr(start, '/');
+        len = (end != NULL) ? (size_t)(end - start) : strlen(start);
+        if (len >= sizeof(name))
+            return NULL;
+
+        memcpy(name, start, len);
+        name[len] = '\0';
+
+        child = (node->children != NULL) ? g_hash_table_lookup(node->children, name) : NULL;
+        if (child == NULL)
+        {
+            if (!create)
+                return NULL;
+
+            if (node->children == NULL)
+                node->children = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, node_free);
+
+            child = node_new(start, len, node);
+            g_hash_table_insert(node->children, child->name, child);
+            tree->count++;
+        }
+
+        node = child;
+        start += len;
+    }
+
+    return node;
+}
+
+void object_tree_init(struct object_tree *tree)
+{
+    tree->root = node_new("", 0, NULL);
+    tree->count = 0;
+}
+
+void object_tree_destroy(struct object_tree *tree)
+{
+    if (tree->root != NULL)
+        node_free(tree->root);
+
+    tree->root = NULL;
+    tree->count = 0;
+}
+
+void object_tree_clear(struct object_tree *tree)
+{
+    object_tree_destroy(tree);
+    object_tree_init(tree);
+}
+
+struct object_node *object_tree_lookup(struct object_tree *tree, const char *path)
+{
+    return walk(tree, path, FALSE);
+}
+
+// Returns the node for 'path', creating it and any missing ancestors.
+// Returns NULL if a path component is too long to be a BlueZ object.
+struct object_node *object_tree_insert(struct object_tree *tree, const char *path)
+{
+    return walk(tree, path, TRUE);
+}
+
+static void count_node(struct object_node *node, void *user_data)
+{
+    (*(unsigned *)user_data)++;
+}
+
+// Removes 'node' and everything below it, then prunes its ancestors.
+void object_tree_remove(struct object_tree *tree, struct object_node *node)
+{
+    struct object_node *parent = node->parent;
+    unsigned removed = 0;
+
+    if (node == tree->root)
+    {
+        object_tree_clear(tree);
+        return;
+    }
+
+    object_tree_foreach(node, count_node, &removed);
+    tree->count -= removed;
+
+    g_hash_table_remove(parent->children, node->name);
+    object_tree_prune(tree, parent);
+}
+
+// Removes 'node' if nothing is left at it, then each ancestor that has
+// become empty as a result.
+void object_tree_prune(struct object_tree *tree, struct object_node *node)
+{
+    struct object_node *parent;
+
+    while (node != NULL && node != tree->root)
+    {
+        if (node->ifaces != 0 || node->role >= 0)
+            return;
+
+        if (node->children != NULL && g_hash_table_size(node->children) > 0)
+            return;
+
+        parent = node->parent;
+        g_hash_table_remove(parent->children, node->name);
+        tree->count--;
+        node = parent;
+    }
+}
+
+struct foreach_data
+{
+    ObjectNodeFunction fn;
+    void *user_data;
+};
+
+static void foreach_child(gpointer key, gpointer value, gpointer user_data)
+{
+    struct foreach_data *data = user_data;
+
+    object_tree_foreach(value, data->fn, data->user_data);
+}
+
+// Calls 'fn' for 'node' and every node below it.  'fn' must not add or
+// remove nodes.
+void object_tree_foreach(struct object_node *node, ObjectNodeFunction fn, void *user_data)
+{
+    struct foreach_data data = { fn, user_data };
+
+    fn(node, user_data);
+
+    if (node->children != NULL)
+        g_hash_table_foreach(node->children, foreach_child, &data);
+}
+
+unsigned object_tree_iface(const char *interface)
+{
+    if (!strcmp(interface, "org.bluez.Adapter1"))
+        return OBJECT_IFACE_ADAPTER;
+    if (!strcmp(interface, "org.bluez.Device1"))
+        return OBJECT_IFACE_DEVICE;
+    if (!strcmp(interface, "org.bluez.GattService1"))
+        return OBJECT_IFACE_SERVICE;
+    if (!strcmp(interface, "org.bluez.GattCharacteristic1"))
+        return OBJECT_IFACE_CHARACTERISTIC;
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+//
+// bleObjectTree.h
+//
+// Created  10/18/2026
+//
+// Mirror of the part of the BlueZ object tree the client has accepted,
+// indexed as a trie of path components.  InterfacesAdded and
+// InterfacesRemoved are applied to it as deltas, each in time
+// proportional to the depth of the path.  Each node records which
+// interfaces its object has and which of the client's proxies, if any,
+// is bound to it.
+
+#ifndef BLE_OBJECT_TREE_H
+#define BLE_OBJECT_TREE_H
+
+// Interfaces tracked per object.
+#define OBJECT_IFACE_ADAPTER            0x01
+#define OBJECT_IFACE_DEVICE             0x02
+#define OBJECT_IFACE_SERVICE            0x04
+#define OBJECT_IFACE_CHARACTERISTIC     0x08
+
+struct object_node
+{
+    char *name;                 // path component, "" for the root
+    struct object_node *parent;
+    GHashTable *children;       // name to node, NULL until needed
+    unsigned ifaces;            // OBJECT_IFACE_ bits
+    int role;                   // BLUEZ_PROXY_ index bound here, or -1
+};
+
+struct object_tree
+{
+    struct object_node *root;
+    unsigned count;             // nodes, not counting the root
+};
+
+typedef void (* ObjectNodeFunction) (struct object_node *node, void *user_data);
+
+void                 object_tree_clear      (struct object_tree *tree);
+void                 object_tree_destroy    (struct object_tree *tree);
+void                 object_tree_foreach    (struct object_node *node, ObjectNodeFunction fn,
+                                             void *user_data);
+unsigned             object_tree_iface      (const char *interface);
+void                 object_tree_init       (struct object_tree *tree);
+struct object_node * object_tree_insert     (struct object_tree *tree, const char *path);
+struct object_node * object_tree_lookup     (struct object_tree *tree, const char *path);
+void                 object_tree_prune      (struct object_tree *tree, struct object_node *node);
+void                 object_tree_remove     (struct object_tree *tree, struct object_node *node);
+
+#endif // BLE_OBJECT_TREE_H
@@ -0,0 +1,415 @@
+//
+// blePoll.c
+//
+// Created  10/18/2026
+//
+// ReadValue polling for characteristics that cannot notify.  Each polled
+// characteristic has its own schedule, kept in a min-heap ordered by due
+// time, and a single source on the client's context wakes up when the
+// earliest one is due.  At most 'maxInFlight' reads are outstanding at a
+// time across all characteristics; the rest wait their turn in the heap.
+// A characteristic is rescheduled only when its read completes, so a slow
+// device never has more than one read queued.
+//
+// Results go through bluez_deliver_sample(), the same path as
+// notifications, with the ID returned by bluez_poll_add() as the source.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleClientPrivate.h"
+#include "bleTrace.h"
+
+#define POLL_DEFAULT_IN_FLIGHT 4
+
+struct poll_entry
+{
+    int id;
+    struct poll_engine *engine;     // NULL once the engine has been freed
+
+    // Unbound proxy addressing the characteristic, used only to issue
+    // ReadValue through g_dbus_proxy_method_call().
+    GDBusProxy proxy;
+
+    struct bluez_poll_config config;
+    int interval;                   // current interval, ms
+    gint64 due;
+    int heapIndex;                  // -1 while a read is in flight
+    gboolean removed;
+
+    gboolean haveValue;
+    size_t lastLen;
+    uint64_t lastHash;
+};
+
+struct poll_engine
+{
+    bluez_client_t *client;
+    GSource *source;
+
+    struct poll_entry **heap;
+    int heapCount;
+    int heapSize;
+
+    GHashTable *entries;            // ID to entry
+    int nextId;
+
+    int inFlight;
+    int maxInFlight;
+};
+
+static void poll_run(struct poll_engine *engine);
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Schedule heap.
+
+static void heap_set(struct poll_engine *engine, int i, struct poll_entry *entry)
+{
+    engine->heap[i] = entry;
+    entry->heapIndex = i;
+}
+
+static void heap_up(struct poll_engine *engine, int i)
+{
+    struct poll_entry *entry = engine->heap[i];
+
+    while (i > 0 && engine->heap[(i - 1) / 2]->due > entry->due)
+    {
+        heap_set(engine, i, engine->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+
+    heap_set(engine, i, entry);
+}
+
+static void heap_down(struct poll_engine *engine, int i)
+{
+    struct poll_entry *entry = engine->heap[i];
+    int child;
+
+    while ((child = 2 * i + 1) < engine->heapCount)
+    {
+        if (child + 1 < engine->heapCount &&
+            engine->heap[child + 1]->due < engine->heap[child]->due)
+            child++;
+
+        if (engine->heap[child]->due >= entry->due)
+            break;
+
+        heap_set(engine, i, engine->heap[child]);
+        i = child;
+    }
+
+    heap_set(engine, i, entry);
+}
+
+static void heap_push(struct poll_engine *engine, struct poll_entry *entry)
+{
+    if (engine->heapCount == engine->heapSize)
+    {
+        engine->heapSize = engine->heapSize ? engine->heapSize * 2 : 16;
+        engine->heap = g_renew(struct poll_entry *, engine->heap, engine->heapSize);
+    }
+
+    heap_set(engine, engine->heapCount++, entry);
+    heap_up(engine, entry->heapIndex);
+}
+
+static void heap_remove(struct poll_engine *engine, struct poll_entry *entry)
+{
+    int i = entry->heapIndex;
+
+    entry->heapIndex = -1;
+
+    if (--engine->heapCount == i)
+        return;
+
+    heap_set(engine, i, engine->heap[engine->heapCount]);
+    heap_up(engine, i);
+    heap_down(engine, engine->heap[i]->heapIndex);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Reads.
+
+// Schedules the next read 'interval' from now, varied by the jitter.
+static void poll_schedule(struct poll_entry *entry, gint64 now)
+{
+    gint64 wait = (gint64)entry->interval * 1000;
+    int jitter = entry->config.jitter;
+
+    if (jitter > 0)
+        wait += wait * g_random_int_range(-jitter, jitter + 1) / 100;
+
+    entry->due = now + wait;
+    heap_push(entry->engine, entry);
+}
+
+static uint64_t value_hash(const uint8_t *data, size_t len)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static void poll_reply(DBusMessage *message, void *user_data)
+{
+    struct poll_entry *entry = user_data;
+    struct poll_engine *engine = entry->engine;
+    DBusMessageIter iter, array;
+    const uint8_t *data = NULL;
+    int len = 0;
+    uint64_t hash;
+    gint64 now;
+
+    if (engine == NULL || entry->removed)
+    {
+        if (engine != NULL)
+        {
+            engine->inFlight--;
+            poll_run(engine);
+        }
+        g_free(entry);
+        return;
+    }
+
+    engine->inFlight--;
+
+    if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_ERROR)
+    {
+        BLE_TRACE(TRACE_WARN, "poll_error", entry->proxy.obj_path, entry->id, 0);
+        entry->interval = MIN(entry->interval * 2, entry->config.maxInterval);
+        poll_schedule(entry, g_get_monotonic_time());
+        poll_run(engine);
+        return;
+    }
+
+    if (dbus_message_iter_init(message, &iter) == TRUE &&
+        dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY)
+    {
+        dbus_message_iter_recurse(&iter, &array);
+        dbus_message_iter_get_fixed_array(&array, &data, &len);
+    }
+
+    // Back off while the value holds still, return to the base rate as
+    // soon as it moves.
+    hash = value_hash(data, len);
+    if (entry->haveValue && entry->lastLen == (size_t)len && entry->lastHash == hash)
+        entry->interval = MIN(entry->interval * 2, entry->config.maxInterval);
+    else
+        entry->interval = entry->config.interval;
+
+    entry->haveValue = TRUE;
+    entry->lastLen = len;
+    entry->lastHash = hash;
+
+    // Rescheduled before delivery, since a sink may remove the entry.
+    now = g_get_monotonic_time();
+    poll_schedule(entry, now);
+
+    bluez_deliver_sample(engine->client, entry->id, now, data, len);
+
+    poll_run(engine);
+}
+
+// Issues every read that is due, as far as the pipeline allows, then sets
+// the source to wake up when the next one is due.
+static void poll_run(struct poll_engine *engine)
+{
+    gint64 now = g_get_monotonic_time();
+    struct poll_entry *entry;
+
+    while (engine->inFlight < engine->maxInFlight && engine->heapCount > 0 &&
+           engine->heap[0]->due <= now)
+    {
+        entry = engine->heap[0];
+        heap_remove(engine, entry);
+
+        // Not connected to the bus yet.  Try again at the base rate, so the
+        // first read is not held back once the bus is up.
+        if (engine->client->gdbus.dbus_conn == NULL)
+        {
+            entry->interval = entry->config.interval;
+            poll_schedule(entry, now);
+            continue;
+        }
+
+        if (g_dbus_proxy_method_call(&entry->proxy, "ReadValue", bluez_options_setup,
+                                     poll_reply, entry, NULL) == TRUE)
+        {
+            engine->inFlight++;
+            continue;
+        }
+
+        // The call could not be made.  Back off as for a failed read.
+        entry->interval = MIN(entry->interval * 2, entry->config.maxInterval);
+        poll_schedule(entry, now);
+    }
+
+    if (engine->heapCount > 0 && engine->inFlight < engine->maxInFlight)
+        g_source_set_ready_time(engine->source, engine->heap[0]->due);
+    else
+        g_source_set_ready_time(engine->source, -1);
+}
+
+struct poll_source
+{
+    GSource source;
+    struct poll_engine *engine;
+};
+
+static gboolean poll_dispatch(GSource *source, GSourceFunc callback, gpointer user_data)
+{
+    g_source_set_ready_time(source, -1);
+    poll_run(((struct poll_source *)source)->engine);
+
+    return TRUE;
+}
+
+static GSourceFuncs poll_source_funcs = {
+    .dispatch = poll_dispatch
+};
+
+static struct poll_engine *poll_engine_get(bluez_client_t *client)
+{
+    struct poll_engine *engine = client->poll;
+
+    if (engine != NULL)
+        return engine;
+
+    engine = g_new0(struct poll_engine, 1);
+    engine->client = client;
+    engine->maxInFlight = POLL_DEFAULT_IN_FLIGHT;
+    engine->nextId = BLUEZ_SOURCE_NOTIFY + 1;
+    engine->entries = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    engine->source = g_source_new(&poll_source_funcs, sizeof(struct poll_source));
+    ((struct poll_source *)engine->source)->engine = engine;
+    g_source_attach(engine->source, client->context);
+
+    client->poll = engine;
+    return engine;
+}
+
+static void entry_release(gpointer key, gpointer value, gpointer user_data)
+{
+    struct poll_entry *entry = value;
+
+    // A read in flight frees its entry when it completes.
+    entry->engine = NULL;
+    if (entry->heapIndex >= 0)
+        g_free(entry);
+}
+
+void poll_engine_free(bluez_client_t *client)
+{
+    struct poll_engine *engine = client->poll;
+
+    if (engine == NULL)
+        return;
+
+    g_source_destroy(engine->source);
+    g_source_unref(engine->source);
+
+    g_hash_table_foreach(engine->entries, entry_release, NULL);
+    g_hash_table_destroy(engine->entries);
+
+    g_free(engine->heap);
+    g_free(engine);
+    client->poll = NULL;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Public interface.
+
+// Starts polling the characteristic at 'path' with ReadValue.  NULL
+// selects a one second interval backing off to one minute, with 10%
+// jitter.  Returns the ID its values are delivered with, or -1.
+int bluez_poll_add(bluez_client_t *client, const char *path,
+                   const struct bluez_poll_config *config)
+{
+    static const struct bluez_poll_config defaults = { 1000, 60000, 10 };
+    struct poll_engine *engine;
+    struct poll_entry *entry;
+
+    if (client == NULL || path == NULL || strlen(path) >= MAX_BLUEZ_PATH)
+        return -1;
+
+    if (config == NULL)
+        config = &defaults;
+
+    if (config->interval < 1 || config->jitter < 0 || config->jitter > 100)
+        return -1;
+
+    engine = poll_engine_get(client);
+
+    entry = g_new0(struct poll_entry, 1);
+    entry->id = engine->nextId++;
+    entry->engine = engine;
+    entry->config = *config;
+    entry->config.maxInterval = MAX(config->maxInterval, config->interval);
+    entry->interval = config->interval;
+
+    entry->proxy.client = &client->gdbus;
+    g_strlcpy(entry->proxy.obj_path, path, sizeof(entry->proxy.obj_path));
+    g_strlcpy(entry->proxy.interface, "org.bluez.GattCharacteristic1",
+              sizeof(entry->proxy.interface));
+
+    g_hash_table_insert(engine->entries, GINT_TO_POINTER(entry->id), entry);
+
+    // Start at a random phase within the first interval, so characteristics
+    // added together do not stay in lockstep.
+    entry->due = g_get_monotonic_time() +
+                 g_random_int_range(0, config->interval) * (gint64)1000;
+    heap_push(engine, entry);
+
+    poll_run(engine);
+
+    return entry->id;
+}
+
+void bluez_poll_remove(bluez_client_t *client, int id)
+{
+    struct poll_engine *engine = client->poll;
+    struct poll_entry *entry;
+
+    if (engine == NULL)
+        return;
+
+    entry = g_hash_table_lookup(engine->entries, GINT_TO_POINTER(id));
+    if (entry == NULL)
+        return;
+
+    g_hash_table_remove(engine->entries, GINT_TO_POINTER(id));
+
+    if (entry->heapIndex >= 0)
+    {
+        heap_remove(engine, entry);
+        g_free(entry);
+        poll_run(engine);
+    }
+    else
+        entry->removed = TRUE;
+}
+
+// Limits the number of ReadValue calls outstanding at once.  Defaults to
+// POLL_DEFAULT_IN_FLIGHT.
+void bluez_poll_set_pipeline(bluez_client_t *client, int maxInFlight)
+{
+    struct poll_engine *engine = poll_engine_get(client);
+
+    engine->maxInFlight = MAX(maxInFlight, 1);
+    poll_run(engine);
+}
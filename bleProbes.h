@@ -0,0 +1,50 @@
+//
+// bleProbes.h
+//
+// Created  10/18/2026
+//
+// USDT static probes for perf, bpftrace and SystemTap, all under the
+// provider name "bleclient".  Each probe is a single nop until a tracer
+// attaches to it.  List them with:
+//
+//    bpftrace -l 'usdt:./bleexample:bleclient:*'
+//
+// Probes, with their arguments:
+//
+//    notify_receive      obj_path, length, fd
+//    properties_changed  obj_path, interface
+//    add_property        obj_path, name, D-Bus type
+//    state_transition    old state, new state, event
+//    method_call         obj_path, interface, method
+//    method_reply        method, latency (us), 1 if error reply
+//    acquire_notify      obj_path, fd, mtu
+//    write_complete      obj_path, 0 or negative errno
+//
+// The probes are compiled in whenever <sys/sdt.h> (systemtap-sdt-dev) is
+// available.  Define BLE_NO_USDT to leave them out.
+
+#ifndef BLE_PROBES_H
+#define BLE_PROBES_H
+
+#if !defined(BLE_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define BLE_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef BLE_HAVE_USDT
+#include <sys/sdt.h>
+
+#define BLE_PROBE2(name, a, b)          DTRACE_PROBE2(bleclient, name, a, b)
+#define BLE_PROBE3(name, a, b, c)       DTRACE_PROBE3(bleclient, name, a, b, c)
+
+#else
+
+// Arguments are still evaluated, so values computed only for a probe do
+// not leave set-but-unused variables behind.
+#define BLE_PROBE2(name, a, b)          ((void)(a), (void)(b))
+#define BLE_PROBE3(name, a, b, c)       ((void)(a), (void)(b), (void)(c))
+
+#endif
+
+#endif // BLE_PROBES_H
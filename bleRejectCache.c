@@ -0,0 +1,257 @@
+//
+// bleRejectCache.c
+//
+// Created  10/18/2026
+//
+// Negative cache of rejected devices, see bleRejectCache.h.
+//
+// Entries live in a fixed table, chained into hash buckets and into an
+// LRU list, so adding and looking up never allocate.  The Bloom filter
+// cannot forget a path, so it is rebuilt from the live entries once
+// evictions have made enough of it stale.
+
+#include <string.h>
+#include <glib.h>
+
+#include "bleRejectCache.h"
+
+#define BLOOM_HASHES 3
+
+// Length of the key for 'path': the device component of the path, such as
+// "/org/bluez/hci0/dev_00_A0_50_3E_47_9D" for the device and everything
+// below it, or 0 if the path does not belong to a device.
+size_t reject_cache_key(const char *path)
+{
+    const char *dev = strstr(path, "/dev_");
+    const char *end;
+
+    if (dev == NULL)
+        return 0;
+
+    end = strchr(dev + 1, '/');
+    return (end != NULL) ? (size_t)(end - path) : strlen(path);
+}
+
+static uint64_t key_hash(const char *path, size_t len)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;          // FNV-1a
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        hash ^= (uint8_t)path[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static void bloom_set(struct reject_cache *cache, uint64_t hash)
+{
+    int i;
+
+    for (i = 0; i < BLOOM_HASHES; i++, hash >>= 16)
+    {
+        unsigned bit = hash & (REJECT_BLOOM_BITS - 1);
+        cache->bloom[bit / 64] |= 1ull << (bit % 64);
+    }
+}
+
+static gboolean bloom_test(const struct reject_cache *cache, uint64_t hash)
+{
+    int i;
+
+    for (i = 0; i < BLOOM_HASHES; i++, hash >>= 16)
+    {
+        unsigned bit = hash & (REJECT_BLOOM_BITS - 1);
+        if (!(cache->bloom[bit / 64] & (1ull << (bit % 64))))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void lru_unlink(struct reject_cache *cache, int i)
+{
+    struct reject_entry *e = &cache->entry[i];
+
+    if (e->prev >= 0)
+        cache->entry[e->prev].next = e->next;
+    else
+        cache->head = e->next;
+
+    if (e->next >= 0)
+        cache->entry[e->next].prev = e->prev;
+    else
+        cache->tail = e->prev;
+}
+
+static void lru_push_head(struct reject_cache *cache, int i)
+{
+    struct reject_entry *e = &cache->entry[i];
+
+    e->prev = -1;
+    e->next = cache->head;
+
+    if (cache->head >= 0)
+        cache->entry[cache->head].prev = i;
+    else
+        cache->tail = i;
+
+    cache->head = i;
+}
+
+static int *bucket_of(struct reject_cache *cache, uint64_t hash)
+{
+    return &cache->bucket[(hash >> 32) & (REJECT_CACHE_SIZE - 1)];
+}
+
+static int lookup(struct reject_cache *cache, const char *path, size_t len, uint64_t hash)
+{
+    int i;
+
+    for (i = *bucket_of(cache, hash); i >= 0; i = cache->entry[i].chain)
+    {
+        struct reject_entry *e = &cache->entry[i];
+
+        if (e->hash == hash && !strncmp(e->path, path, len) && e->path[len] == '\0')
+            return i;
+    }
+
+    return -1;
+}
+
+static void entry_drop(struct reject_cache *cache, int i)
+{
+    struct reject_entry *e = &cache->entry[i];
+    int *link = bucket_of(cache, e->hash);
+
+    while (*link != i)
+        link = &cache->entry[*link].chain;
+    *link = e->chain;
+
+    lru_unlink(cache, i);
+    e->used = FALSE;
+    cache->count--;
+}
+
+static void bloom_rebuild(struct reject_cache *cache)
+{
+    int i;
+
+    memset(cache->bloom, 0, sizeof(cache->bloom));
+
+    for (i = cache->head; i >= 0; i = cache->entry[i].next)
+        bloom_set(cache, cache->entry[i].hash);
+
+    cache->evictions = 0;
+}
+
+void reject_cache_clear(struct reject_cache *cache)
+{
+    int i;
+
+    memset(cache->bloom, 0, sizeof(cache->bloom));
+
+    for (i = 0; i < REJECT_CACHE_SIZE; i++)
+    {
+        cache->entry[i].used = FALSE;
+        cache->bucket[i] = -1;
+    }
+
+    cache->head = cache->tail = -1;
+    cache->count = 0;
+    cache->evictions = 0;
+}
+
+// TRUE if 'path' is, or lies below, a rejected device.
+int reject_cache_contains(struct reject_cache *cache, const char *path)
+{
+    size_t len = reject_cache_key(path);
+    uint64_t hash;
+    int i;
+
+    if (len == 0 || len >= REJECT_PATH_MAX)
+        return FALSE;
+
+    hash = key_hash(path, len);
+
+    if (bloom_test(cache, hash) == FALSE)
+        return FALSE;
+
+    i = lookup(cache, path, len, hash);
+    if (i < 0)
+        return FALSE;
+
+    if (i != cache->head)
+    {
+        lru_unlink(cache, i);
+        lru_push_head(cache, i);
+    }
+
+    return TRUE;
+}
+
+// Rejects the device that 'path' belongs to, evicting the least recently
+// seen device if the cache is full.
+void reject_cache_add(struct reject_cache *cache, const char *path)
+{
+    size_t len = reject_cache_key(path);
+    uint64_t hash;
+    int i;
+
+    if (len == 0 || len >= REJECT_PATH_MAX)
+        return;
+
+    hash = key_hash(path, len);
+
+    if (lookup(cache, path, len, hash) >= 0)
+        return;
+
+    if (cache->count == REJECT_CACHE_SIZE)
+    {
+        i = cache->tail;
+        entry_drop(cache, i);
+        cache->evictions++;
+    }
+    else
+    {
+        for (i = 0; cache->entry[i].used; i++)
+            ;
+    }
+
+    memcpy(cache->entry[i].path, path, len);
+    cache->entry[i].path[len] = '\0';
+    cache->entry[i].hash = hash;
+    cache->entry[i].used = TRUE;
+    cache->entry[i].chain = *bucket_of(cache, hash);
+    *bucket_of(cache, hash) = i;
+    lru_push_head(cache, i);
+    cache->count++;
+
+    bloom_set(cache, hash);
+
+    if (cache->evictions > REJECT_CACHE_SIZE / 2)
+        bloom_rebuild(cache);
+}
+
+// Forgets a device, for example once BlueZ has removed it, so that it is
+// screened again if it comes back.
+void reject_cache_remove(struct reject_cache *cache, const char *path)
+{
+    size_t len = reject_cache_key(path);
+    uint64_t hash;
+    int i;
+
+    if (len == 0 || len >= REJECT_PATH_MAX)
+        return;
+
+    hash = key_hash(path, len);
+
+    if (bloom_test(cache, hash) == FALSE)
+        return;
+
+    i = lookup(cache, path, len, hash);
+    if (i >= 0)
+        entry_drop(cache, i);
+}
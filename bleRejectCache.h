@@ -0,0 +1,52 @@
+//
+// bleRejectCache.h
+//
+// Created  10/18/2026
+//
+// Negative cache of devices the client has screened out.  Keyed on the
+// device's object path, so the device and every service and
+// characteristic below it can be dropped by a path-prefix check instead
+// of walking their property dictionaries again.  A Bloom filter answers
+// most lookups for devices never seen before without touching the LRU
+// table behind it.  Used only on the owning client's thread.
+
+#ifndef BLE_REJECT_CACHE_H
+#define BLE_REJECT_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Must be powers of two.
+#define REJECT_CACHE_SIZE       1024
+#define REJECT_BLOOM_BITS       16384
+
+#define REJECT_PATH_MAX         64
+
+struct reject_entry
+{
+    char path[REJECT_PATH_MAX];
+    uint64_t hash;
+    int prev;                   // LRU list, -1 terminated
+    int next;
+    int chain;                  // hash bucket chain, -1 terminated
+    int used;
+};
+
+struct reject_cache
+{
+    uint64_t bloom[REJECT_BLOOM_BITS / 64];
+    struct reject_entry entry[REJECT_CACHE_SIZE];
+    int bucket[REJECT_CACHE_SIZE];
+    int head;                   // most recently used
+    int tail;                   // least recently used, next to be evicted
+    int count;
+    int evictions;              // since the Bloom filter was last rebuilt
+};
+
+void    reject_cache_add        (struct reject_cache *cache, const char *path);
+void    reject_cache_clear      (struct reject_cache *cache);
+int     reject_cache_contains   (struct reject_cache *cache, const char *path);
+size_t  reject_cache_key        (const char *path);
+void    reject_cache_remove     (struct reject_cache *cache, const char *path);
+
+#endif // BLE_REJECT_CACHE_H
@@ -0,0 +1,163 @@
+//
+// bleShm.c
+//
+// Created  10/18/2026
+//
+// Writer side of the shared-memory value segment, see bleShm.h.  The
+// segment is created by bluez_shm_create() and filled either directly
+// with bluez_shm_publish() or by adding bluez_shm_sample() as a sample
+// sink:
+//
+//    shm = bluez_shm_create("/ble-values", 16);
+//    bluez_add_sample_sink(client, bluez_shm_sample, shm);
+//
+// There must be only one writer per segment.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleMetrics.h"
+#include "bleShm.h"
+
+struct bluez_shm
+{
+    char *name;
+    struct ble_shm_header *header;
+    struct ble_shm_slot *slot;
+    size_t size;
+};
+
+// Creates the segment 'name', replacing any left by an earlier run, with
+// room for 'slots' sources.  Returns NULL on failure.
+struct bluez_shm *bluez_shm_create(const char *name, int slots)
+{
+    struct bluez_shm *shm;
+    size_t size;
+    void *map;
+    int fd;
+
+    if (name == NULL || slots < 1)
+        return NULL;
+
+    size = BLE_SHM_SIZE(slots);
+
+    shm_unlink(name);
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Unable to create %s: %s\n", name, strerror(errno));
+        return NULL;
+    }
+
+    if (ftruncate(fd, size) < 0)
+    {
+        fprintf(stderr, "Unable to size %s: %s\n", name, strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "Unable to map %s: %s\n", name, strerror(errno));
+        shm_unlink(name);
+        return NULL;
+    }
+
+    shm = g_new0(struct bluez_shm, 1);
+    shm->name = g_strdup(name);
+    shm->header = map;
+    shm->slot = (struct ble_shm_slot *)(shm->header + 1);
+    shm->size = size;
+
+    // The segment starts zeroed, so every slot's sequence starts even.
+    // Readers check the magic number last.
+    shm->header->slots = slots;
+    shm->header->version = BLE_SHM_VERSION;
+    atomic_thread_fence(memory_order_release);
+    shm->header->magic = BLE_SHM_MAGIC;
+
+    return shm;
+}
+
+// Unmaps and removes the segment.  Readers that still have it mapped keep
+// their mapping of the final values.
+void bluez_shm_destroy(struct bluez_shm *shm)
+{
+    if (shm == NULL)
+        return;
+
+    munmap(shm->header, shm->size);
+    shm_unlink(shm->name);
+    g_free(shm->name);
+    g_free(shm);
+}
+
+static struct ble_shm_slot *shm_slot(struct bluez_shm *shm, int source)
+{
+    uint32_t used = atomic_load_explicit(&shm->header->used, memory_order_relaxed);
+    struct ble_shm_slot *s;
+    uint32_t i;
+
+    for (i = 0; i < used; i++)
+    {
+        if (shm->slot[i].source == source)
+            return &shm->slot[i];
+    }
+
+    if (used == shm->header->slots)
+        return NULL;
+
+    // The source is set before the slot is counted, so a reader that sees
+    // the slot also sees its source.
+    s = &shm->slot[used];
+    s->source = source;
+    atomic_store_explicit(&shm->header->used, used + 1, memory_order_release);
+
+    return s;
+}
+
+// Replaces the value of 'source'.  Values longer than BLE_SHM_DATA_MAX
+// are truncated.
+void bluez_shm_publish(struct bluez_shm *shm, int source, gint64 timestamp,
+                       const uint8_t *data, size_t len)
+{
+    struct ble_shm_slot *s = shm_slot(shm, source);
+    uint32_t seq;
+
+    if (s == NULL)
+    {
+        bluez_metrics_inc(METRIC_SHM_DROPPED);
+        return;
+    }
+
+    len = MIN(len, BLE_SHM_DATA_MAX);
+
+    seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    s->timestamp = timestamp;
+    s->len = len;
+    memcpy(s->data, data, len);
+
+    atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+}
+
+// Sample sink publishing each sample, with 'user_data' the segment.
+void bluez_shm_sample(bluez_client_t *client, const struct bluez_sample *sample, void *user_data)
+{
+    bluez_shm_publish(user_data, sample->source, sample->timestamp, sample->data, sample->len);
+}
@@ -0,0 +1,67 @@
+//
+// bleShm.h
+//
+// Created  10/18/2026
+//
+// Shared-memory publication of the latest value of each characteristic.
+// The client writes into a POSIX shared-memory segment, one slot per
+// source (BLUEZ_SOURCE_NOTIFY or a poll ID), and any number of local
+// processes read it through the reader functions below.  A read is a
+// copy out of the mapping with no system call and no lock.
+//
+// Each slot is guarded by a sequence lock.  The writer makes the sequence
+// odd, updates the slot and makes it even again.  A reader copies the
+// slot between two loads of the sequence and retries if the sequence was
+// odd or moved, so it never sees a torn value and never holds up the
+// writer.
+//
+// This header is all a reader needs.  It does not depend on GLib, D-Bus
+// or the rest of the client; link with libbleshm.a.
+
+#ifndef BLE_SHM_H
+#define BLE_SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define BLE_SHM_MAGIC       0x4d485342u     // "BSHM"
+#define BLE_SHM_VERSION     1
+
+// Largest value a slot holds, the maximum length of an attribute value.
+#define BLE_SHM_DATA_MAX    512
+
+#define BLE_SHM_CACHE_LINE  64
+
+struct ble_shm_slot
+{
+    _Atomic uint32_t seq;       // odd while the writer is updating the slot
+    int32_t source;
+    int64_t timestamp;          // CLOCK_MONOTONIC, microseconds
+    uint32_t len;
+    uint32_t pad;
+    uint8_t data[BLE_SHM_DATA_MAX];
+} __attribute__((aligned(BLE_SHM_CACHE_LINE)));
+
+struct ble_shm_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;             // slots in the segment
+    _Atomic uint32_t used;      // slots assigned to a source so far
+} __attribute__((aligned(BLE_SHM_CACHE_LINE)));
+
+// Segment layout: the header, then 'slots' slots.
+#define BLE_SHM_SIZE(slots) \
+    (sizeof(struct ble_shm_header) + (size_t)(slots) * sizeof(struct ble_shm_slot))
+
+struct bluez_shm_reader;
+
+void                        bluez_shm_reader_close  (struct bluez_shm_reader *reader);
+int                         bluez_shm_reader_find   (struct bluez_shm_reader *reader, int source);
+struct bluez_shm_reader *   bluez_shm_reader_open   (const char *name);
+int                         bluez_shm_reader_read   (struct bluez_shm_reader *reader, int slot,
+                                                     void *buf, size_t size, int64_t *timestamp);
+uint64_t                    bluez_shm_reader_retries(const struct bluez_shm_reader *reader);
+
+#endif // BLE_SHM_H
@@ -0,0 +1,230 @@
+//
+// bleShmBench.c
+//
+// Created  10/18/2026
+//
+// Contention benchmark for the shared-memory value segment.  One writer
+// thread publishes to every slot in turn as fast as it can, or at a fixed
+// rate, while reader threads each map the segment through the reader
+// library and read random slots.  Reports the following:
+//
+//    - values published per second
+//    - reads per second, per reader and in total
+//    - the fraction of reads that found the writer updating the slot
+//      and had to retry
+//    - read latency percentiles
+//
+// Usage:
+//    bleShmBench [-r readers] [-s slots] [-n value bytes] [-w writes per second] [-t seconds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleShm.h"
+
+#define SHM_BENCH_NAME      "/ble-shm-bench"
+
+// Read latencies kept per reader for the percentiles.
+#define LATENCY_SAMPLES     (1 << 16)
+
+struct reader
+{
+    pthread_t thread;
+    unsigned seed;
+    uint64_t reads;
+    uint64_t retries;
+    uint64_t *latency;
+    size_t latencyCount;
+};
+
+static struct {
+    int slots;
+    int len;
+    int rate;
+    int seconds;
+    atomic_int stop;
+    uint64_t writes;
+} bench = { .slots = 16, .len = 20, .rate = 0, .seconds = 5 };
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void *writer_thread(void *arg)
+{
+    struct bluez_shm *shm = arg;
+    uint8_t value[BLE_SHM_DATA_MAX];
+    uint64_t start = now_ns(), n = 0;
+    int i;
+
+    for (i = 0; i < bench.len; i++)
+        value[i] = i;
+
+    while (!atomic_load_explicit(&bench.stop, memory_order_relaxed))
+    {
+        value[0] = n;
+        bluez_shm_publish(shm, n % bench.slots, now_ns() / 1000, value, bench.len);
+        n++;
+
+        // Paced writes, to measure readers against a realistic load.
+        if (bench.rate > 0)
+        {
+            uint64_t due = start + n * 1000000000ull / bench.rate;
+            struct timespec ts = { due / 1000000000u, due % 1000000000u };
+
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        }
+    }
+
+    bench.writes = n;
+    return NULL;
+}
+
+static void *reader_thread(void *arg)
+{
+    struct reader *r = arg;
+    struct bluez_shm_reader *shm = bluez_shm_reader_open(SHM_BENCH_NAME);
+    int *slot = calloc(bench.slots, sizeof(int));
+    uint8_t buf[BLE_SHM_DATA_MAX];
+    uint64_t t;
+    int i, s;
+
+    if (shm == NULL || slot == NULL)
+        exit(1);
+
+    for (i = 0; i < bench.slots; i++)
+        slot[i] = -1;
+
+    while (!atomic_load_explicit(&bench.stop, memory_order_relaxed))
+    {
+        i = rand_r(&r->seed) % bench.slots;
+        if (slot[i] < 0 && (slot[i] = bluez_shm_reader_find(shm, i)) < 0)
+            continue;
+
+        s = slot[i];
+        t = now_ns();
+        bluez_shm_reader_read(shm, s, buf, sizeof(buf), NULL);
+        t = now_ns() - t;
+
+        r->reads++;
+        if (r->latencyCount < LATENCY_SAMPLES)
+            r->latency[r->latencyCount++] = t;
+        else
+            r->latency[rand_r(&r->seed) % LATENCY_SAMPLES] = t;
+    }
+
+    r->retries = bluez_shm_reader_retries(shm);
+    free(slot);
+    bluez_shm_reader_close(shm);
+    return NULL;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: bleShmBench [-r readers] [-s slots] [-n value bytes] "
+                    "[-w writes per second] [-t seconds]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct bluez_shm *shm;
+    struct reader *readers;
+    pthread_t writer;
+    uint64_t *all, reads = 0, retries = 0;
+    size_t n = 0;
+    int nreaders = 4, opt, i;
+
+    while ((opt = getopt(argc, argv, "r:s:n:w:t:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'r': nreaders = atoi(optarg); break;
+            case 's': bench.slots = atoi(optarg); break;
+            case 'n': bench.len = atoi(optarg); break;
+            case 'w': bench.rate = atoi(optarg); break;
+            case 't': bench.seconds = atoi(optarg); break;
+            default:  usage();
+        }
+    }
+
+    if (nreaders < 1 || bench.slots < 1 || bench.len < 1 || bench.len > BLE_SHM_DATA_MAX ||
+        bench.rate < 0 || bench.seconds < 1)
+        usage();
+
+    shm = bluez_shm_create(SHM_BENCH_NAME, bench.slots);
+    if (shm == NULL)
+        return 1;
+
+    // Every slot is assigned before the readers start.
+    for (i = 0; i < bench.slots; i++)
+        bluez_shm_publish(shm, i, 0, (const uint8_t *)"", 0);
+
+    readers = calloc(nreaders, sizeof(*readers));
+    for (i = 0; i < nreaders; i++)
+    {
+        readers[i].seed = i + 1;
+        readers[i].latency = calloc(LATENCY_SAMPLES, sizeof(uint64_t));
+        pthread_create(&readers[i].thread, NULL, reader_thread, &readers[i]);
+    }
+    pthread_create(&writer, NULL, writer_thread, shm);
+
+    sleep(bench.seconds);
+    atomic_store(&bench.stop, 1);
+
+    pthread_join(writer, NULL);
+    all = calloc((size_t)nreaders * LATENCY_SAMPLES, sizeof(uint64_t));
+    for (i = 0; i < nreaders; i++)
+    {
+        pthread_join(readers[i].thread, NULL);
+        reads += readers[i].reads;
+        retries += readers[i].retries;
+        memcpy(all + n, readers[i].latency, readers[i].latencyCount * sizeof(uint64_t));
+        n += readers[i].latencyCount;
+        printf("reader%d_reads_per_second %.0f\n", i, (double)readers[i].reads / bench.seconds);
+        free(readers[i].latency);
+    }
+
+    qsort(all, n, sizeof(uint64_t), compare_u64);
+
+    printf("readers %d\n", nreaders);
+    printf("slots %d\n", bench.slots);
+    printf("value_bytes %d\n", bench.len);
+    printf("writes_per_second %.0f\n", (double)bench.writes / bench.seconds);
+    printf("reads_per_second %.0f\n", (double)reads / bench.seconds);
+    printf("read_retry_ratio %.6f\n", reads > 0 ? (double)retries / reads : 0.0);
+    if (n > 0)
+    {
+        printf("read_ns_p50 %llu\n", (unsigned long long)all[n / 2]);
+        printf("read_ns_p99 %llu\n", (unsigned long long)all[(n * 99) / 100]);
+        printf("read_ns_max %llu\n", (unsigned long long)all[n - 1]);
+    }
+
+    free(all);
+    free(readers);
+    bluez_shm_destroy(shm);
+
+    return 0;
+}
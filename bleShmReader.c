@@ -0,0 +1,164 @@
+//
+// bleShmReader.c
+//
+// Created  10/18/2026
+//
+// Reader side of the shared-memory value segment, see bleShm.h.  Built
+// into libbleshm.a on its own, so that reading processes link with
+// neither GLib nor D-Bus.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bleShm.h"
+
+struct bluez_shm_reader
+{
+    const struct ble_shm_header *header;
+    const struct ble_shm_slot *slot;
+    size_t size;
+    uint64_t retries;
+};
+
+// Maps the segment 'name' read-only.  Returns NULL if it does not exist
+// or is not a segment of this version.
+struct bluez_shm_reader *bluez_shm_reader_open(const char *name)
+{
+    struct bluez_shm_reader *reader;
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Unable to open %s: %s\n", name, strerror(errno));
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct ble_shm_header))
+    {
+        fprintf(stderr, "%s is not a value segment\n", name);
+        close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "Unable to map %s: %s\n", name, strerror(errno));
+        return NULL;
+    }
+
+    reader = calloc(1, sizeof(*reader));
+    if (reader == NULL)
+    {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    reader->header = map;
+    reader->slot = (const struct ble_shm_slot *)(reader->header + 1);
+    reader->size = st.st_size;
+
+    if (reader->header->magic != BLE_SHM_MAGIC || reader->header->version != BLE_SHM_VERSION ||
+        BLE_SHM_SIZE(reader->header->slots) > reader->size)
+    {
+        fprintf(stderr, "%s is not a version %d value segment\n", name, BLE_SHM_VERSION);
+        bluez_shm_reader_close(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+void bluez_shm_reader_close(struct bluez_shm_reader *reader)
+{
+    if (reader == NULL)
+        return;
+
+    munmap((void *)reader->header, reader->size);
+    free(reader);
+}
+
+// Number of reads through 'reader' that found the writer updating the
+// slot and had to wait for it.
+uint64_t bluez_shm_reader_retries(const struct bluez_shm_reader *reader)
+{
+    return reader->retries;
+}
+
+// Returns the slot holding 'source', or -1 if it has not been published
+// yet.  A source keeps its slot for the life of the segment, so the
+// result can be kept and passed to every later read.
+int bluez_shm_reader_find(struct bluez_shm_reader *reader, int source)
+{
+    uint32_t used = atomic_load_explicit(&((struct ble_shm_header *)reader->header)->used,
+                                         memory_order_acquire);
+    uint32_t i;
+
+    for (i = 0; i < used && i < reader->header->slots; i++)
+    {
+        if (reader->slot[i].source == source)
+            return i;
+    }
+
+    return -1;
+}
+
+// Copies the latest value in 'slot' to 'buf', truncated to 'size', and
+// its timestamp to 'timestamp' if that is not NULL.  Returns the full
+// length of the value, or -1 for an invalid slot.
+int bluez_shm_reader_read(struct bluez_shm_reader *reader, int slot,
+                          void *buf, size_t size, int64_t *timestamp)
+{
+    struct ble_shm_slot *s;
+    uint32_t before, after, len;
+    int64_t ts;
+    int retried = 0;
+
+    if (slot < 0 || (uint32_t)slot >= reader->header->slots)
+        return -1;
+
+    s = (struct ble_shm_slot *)&reader->slot[slot];
+
+    for ( ; ; )
+    {
+        before = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if (before & 1)
+        {
+            retried = 1;
+            continue;
+        }
+
+        ts = s->timestamp;
+        len = s->len;
+        if (len > BLE_SHM_DATA_MAX)
+            len = BLE_SHM_DATA_MAX;
+        memcpy(buf, s->data, len < size ? len : size);
+
+        // Orders the copy before the second load of the sequence.
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&s->seq, memory_order_relaxed);
+
+        if (before == after)
+            break;
+
+        retried = 1;
+    }
+
+    reader->retries += retried;
+
+    if (timestamp != NULL)
+        *timestamp = ts;
+
+    return len;
+}
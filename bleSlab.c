@@ -0,0 +1,105 @@
+//
+// bleSlab.c
+//
+// Created  10/18/2026
+//
+// Fixed-size object pool, see bleSlab.h.
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <glib.h>
+
+#include "bleSlab.h"
+
+struct slab_chunk
+{
+    struct slab_chunk *next;
+    max_align_t objects[];
+};
+
+#define SLAB_ALIGN _Alignof(max_align_t)
+
+void bluez_slab_init(struct bluez_slab *slab, size_t size, unsigned perChunk)
+{
+    memset(slab, 0, sizeof(*slab));
+
+    // A free object holds the free list link.
+    if (size < sizeof(void *))
+        size = sizeof(void *);
+
+    slab->size = (size + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1);
+    slab->perChunk = perChunk;
+}
+
+static gboolean slab_grow(struct bluez_slab *slab)
+{
+    struct slab_chunk *chunk;
+    char *object;
+    unsigned i;
+
+    chunk = g_try_malloc(sizeof(*chunk) + (size_t)slab->perChunk * slab->size);
+    if (chunk == NULL)
+        return FALSE;
+
+    chunk->next = slab->chunks;
+    slab->chunks = chunk;
+
+    object = (char *)chunk->objects;
+    for (i = 0; i < slab->perChunk; i++, object += slab->size)
+    {
+        *(void **)object = slab->freeList;
+        slab->freeList = object;
+    }
+
+    return TRUE;
+}
+
+// Returns a zeroed object, or NULL if memory is exhausted.
+void *bluez_slab_alloc(struct bluez_slab *slab)
+{
+    void *object;
+
+    if (slab->freeList == NULL && slab_grow(slab) == FALSE)
+        return NULL;
+
+    object = slab->freeList;
+    slab->freeList = *(void **)object;
+    slab->inUse++;
+
+    memset(object, 0, slab->size);
+
+    return object;
+}
+
+void bluez_slab_free(struct bluez_slab *slab, void *object)
+{
+    if (object == NULL)
+        return;
+
+    *(void **)object = slab->freeList;
+    slab->freeList = object;
+    slab->inUse--;
+}
+
+// Releases the chunks.  If objects are still in use, for example owned by
+// pending calls on a connection that has not been finalized, the chunks
+// are left allocated rather than leave those objects dangling.
+void bluez_slab_destroy(struct bluez_slab *slab)
+{
+    struct slab_chunk *chunk;
+
+    if (slab->inUse != 0)
+    {
+        fprintf(stderr, "Slab destroyed with %zu objects in use\n", slab->inUse);
+        return;
+    }
+
+    while ((chunk = slab->chunks) != NULL)
+    {
+        slab->chunks = chunk->next;
+        g_free(chunk);
+    }
+
+    slab->freeList = NULL;
+}
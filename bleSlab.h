@@ -0,0 +1,33 @@
+//
+// bleSlab.h
+//
+// Created  10/18/2026
+//
+// Fixed-size object pool.  Objects are carved out of chunks allocated on
+// demand and recycled through a free list, so once a client has reached
+// its peak number of calls in flight it stops touching the heap.  Not
+// thread-safe: each pool belongs to one client and is used only on that
+// client's thread.
+
+#ifndef BLE_SLAB_H
+#define BLE_SLAB_H
+
+#include <stddef.h>
+
+struct slab_chunk;
+
+struct bluez_slab
+{
+    size_t size;                // object size, rounded up for alignment
+    unsigned perChunk;
+    void *freeList;
+    struct slab_chunk *chunks;
+    size_t inUse;
+};
+
+void    bluez_slab_init     (struct bluez_slab *slab, size_t size, unsigned perChunk);
+void *  bluez_slab_alloc    (struct bluez_slab *slab);
+void    bluez_slab_free     (struct bluez_slab *slab, void *object);
+void    bluez_slab_destroy  (struct bluez_slab *slab);
+
+#endif // BLE_SLAB_H
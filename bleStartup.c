@@ -0,0 +1,186 @@
+//
+// bleStartup.c
+//
+// Created  10/18/2026
+//
+// Startup profile.  Each client times the steps from bluez_client_init()
+// to its first notification, and writes them out as one line of JSON
+// when that notification arrives, for example
+//
+//    {"event":"startup","kernel":"6.1.21-v8+","total_us":2481933,
+//     "phases":{"bus_setup":{"start_us":0,"duration_us":1210},...,
+//               "power_on":null,...}}
+//
+// 'start_us' is from the start of bluez_client_init().  Phases that did
+// not run, such as power_on with the adapter already powered, are null.
+// Only the first startup is timed; reconnects are counted in the metrics.
+//
+//    bus_setup           opening the D-Bus connection
+//    service_connect     until the BlueZ daemon is seen on the bus
+//    get_managed_objects the GetManagedObjects round trip
+//    objects_parse       parsing the reply, up to the ready callback
+//    power_on            bluez_power_on() until Powered
+//    scan                bluez_scan() on until off, the device being found
+//    scan_stop           bluez_scan() off until Discovering goes false
+//    connect             bluez_connect() until Connected
+//    services_resolved   Connected until ServicesResolved
+//    acquire_notify      bluez_acquire_notify() until the socket arrives
+//    first_notification  from then until the first notification
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleClientPrivate.h"
+#include "bleTrace.h"
+
+static const char *const phase_names[STARTUP_PHASES] =
+{
+    [STARTUP_BUS_SETUP]          = "bus_setup",
+    [STARTUP_SERVICE_CONNECT]    = "service_connect",
+    [STARTUP_OBJECTS_CALL]       = "get_managed_objects",
+    [STARTUP_OBJECTS_PARSE]      = "objects_parse",
+    [STARTUP_POWER_ON]           = "power_on",
+    [STARTUP_SCAN]               = "scan",
+    [STARTUP_SCAN_STOP]          = "scan_stop",
+    [STARTUP_CONNECT]            = "connect",
+    [STARTUP_SERVICES_RESOLVED]  = "services_resolved",
+    [STARTUP_ACQUIRE_NOTIFY]     = "acquire_notify",
+    [STARTUP_FIRST_NOTIFICATION] = "first_notification"
+};
+
+static void startup_report(bluez_client_t *client)
+{
+    struct startup_profile *s = &client->startup;
+    struct utsname uts;
+    GString *out;
+    const char *sep = "";
+    ssize_t n;
+    gsize done;
+    int i;
+
+    out = g_string_sized_new(1024);
+
+    if (uname(&uts) < 0)
+        strcpy(uts.release, "unknown");
+
+    g_string_append_printf(out, "{\"event\":\"startup\",\"kernel\":\"%s\",\"total_us\":%lld,"
+                                "\"phases\":{",
+                           uts.release, (long long)(s->end[STARTUP_FIRST_NOTIFICATION] - s->origin));
+
+    for (i = 0; i < STARTUP_PHASES; i++)
+    {
+        if (s->end[i] == 0)
+            g_string_append_printf(out, "%s\"%s\":null", sep, phase_names[i]);
+        else
+            g_string_append_printf(out, "%s\"%s\":{\"start_us\":%lld,\"duration_us\":%lld}",
+                                   sep, phase_names[i],
+                                   (long long)(s->begin[i] - s->origin),
+                                   (long long)(s->end[i] - s->begin[i]));
+        sep = ",";
+    }
+
+    g_string_append(out, "}}\n");
+
+    for (done = 0; done < out->len; done += n)
+    {
+        n = write(s->fd, out->str + done, out->len - done);
+        if (n < 0 && errno == EINTR)
+            n = 0;
+        else if (n < 0)
+        {
+            fprintf(stderr, "Unable to write startup report: %s\n", strerror(errno));
+            break;
+        }
+    }
+
+    g_string_free(out, TRUE);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Interface to the rest of the client.
+
+// Starts timing the whole startup.  Called from bluez_client_init().
+void startup_start(bluez_client_t *client)
+{
+    struct startup_profile *s = &client->startup;
+    int fd = s->fd;
+
+    memset(s, 0, sizeof(*s));
+    s->fd = fd;
+    s->origin = g_get_monotonic_time();
+}
+
+// Marks the start of 'phase'.  Only the first start counts.
+void startup_begin(bluez_client_t *client, int phase)
+{
+    struct startup_profile *s = &client->startup;
+
+    if (s->origin == 0 || s->done || s->begin[phase] != 0)
+        return;
+
+    s->begin[phase] = g_get_monotonic_time();
+}
+
+// Marks the end of 'phase', if it has started and not already ended.  The
+// end of the first notification phase completes the profile and writes the
+// report.
+void startup_end(bluez_client_t *client, int phase)
+{
+    struct startup_profile *s = &client->startup;
+
+    if (s->done || s->begin[phase] == 0 || s->end[phase] != 0)
+        return;
+
+    s->end[phase] = g_get_monotonic_time();
+
+    BLE_TRACE(TRACE_INFO, "startup", phase_names[phase], phase,
+              (int)(s->end[phase] - s->begin[phase]));
+
+    if (phase != STARTUP_FIRST_NOTIFICATION)
+        return;
+
+    s->done = TRUE;
+    if (s->fd >= 0)
+        startup_report(client);
+}
+
+// Ends the phases that finish on a property change, and starts those that
+// begin on one.
+void startup_property(bluez_client_t *client, const char *name,
+                      const struct bluez_property_value *value)
+{
+    gboolean yes = (value->type == DBUS_TYPE_BOOLEAN && value->value.bool_val);
+
+    if (client->startup.done)
+        return;
+
+    if (!strcmp(name, "Powered") && yes)
+        startup_end(client, STARTUP_POWER_ON);
+    else if (!strcmp(name, "Discovering") && !yes)
+        startup_end(client, STARTUP_SCAN_STOP);
+    else if (!strcmp(name, "Connected") && yes)
+    {
+        startup_end(client, STARTUP_CONNECT);
+        startup_begin(client, STARTUP_SERVICES_RESOLVED);
+    }
+    else if (!strcmp(name, "ServicesResolved") && yes)
+        startup_end(client, STARTUP_SERVICES_RESOLVED);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Public interface.
+
+// Writes the startup report to 'fd' when the first notification arrives,
+// or nowhere if 'fd' is -1, the default.  Phases are timed either way.
+void bluez_set_startup_report(bluez_client_t *client, int fd)
+{
+    client->startup.fd = fd;
+}
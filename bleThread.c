@@ -0,0 +1,372 @@
+//
+// bleThread.c
+//
+// Created  10/18/2026
+//
+// Background thread embedding.  bluez_client_start() runs the client's main
+// loop on an internal low-priority thread.  Other threads, such as a
+// real-time control loop, hand reads and writes to it through a bounded
+// lock-free queue without blocking or taking a lock.  The queue is drained
+// on the client's thread by an eventfd source, and results come back
+// through each command's completion callback.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleClientPrivate.h"
+#include "bleProbes.h"
+
+// Nice value for the client thread, so it never competes with the
+// application's own threads.
+#define CLIENT_THREAD_NICE 10
+
+enum {
+    COMMAND_READ = 1,
+    COMMAND_WRITE
+};
+
+// In-flight command, from method call until its reply.  Starts with the
+// iovec expected by bluez_write_setup().
+struct command_call
+{
+    struct iovec iov;
+    bluez_client_t *client;
+    GDBusProxy *proxy;
+    int type;
+    CommandCallback cb;
+    void *user_data;
+};
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Lock-free queue.
+
+// Any thread.  Returns FALSE if the queue is full.
+static gboolean command_enqueue(struct command_queue *q, const struct bluez_command *cmd)
+{
+    struct command_cell *cell;
+    size_t pos, seq;
+    uint64_t one = 1;
+
+    pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    for ( ; ; )
+    {
+        cell = &q->cell[pos & (COMMAND_QUEUE_SIZE - 1)];
+        seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+
+        if (seq == pos)
+        {
+            // Cell is free, try to claim this position.
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1,
+                                memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if ((intptr_t)(seq - pos) < 0)
+            return FALSE;
+        else
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    }
+
+    cell->cmd = *cmd;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+
+    // Wake the client thread only once per drain.
+    if (atomic_exchange(&q->signalled, 1) == 0)
+    {
+        if (write(q->efd, &one, sizeof(one)) < 0)
+            atomic_store(&q->signalled, 0);
+    }
+
+    return TRUE;
+}
+
+// Client thread only.
+static gboolean command_dequeue(struct command_queue *q, struct bluez_command *cmd)
+{
+    struct command_cell *cell = &q->cell[q->head & (COMMAND_QUEUE_SIZE - 1)];
+    size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+
+    if (seq != q->head + 1)
+        return FALSE;
+
+    *cmd = cell->cmd;
+    atomic_store_explicit(&cell->seq, q->head + COMMAND_QUEUE_SIZE, memory_order_release);
+    q->head++;
+
+    return TRUE;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Command execution, on the client thread.
+
+static void command_complete(struct command_call *call, DBusMessage *message)
+{
+    DBusError error;
+    DBusMessageIter iter, array;
+    const uint8_t *data = NULL;
+    int len = 0;
+
+    dbus_error_init(&error);
+
+    if (dbus_set_error_from_message(&error, message) == TRUE)
+    {
+        fprintf(stderr, "Command failed: %s\n", error.name);
+        dbus_error_free(&error);
+        if (call->cb != NULL)
+            call->cb(call->client, -EIO, NULL, 0, call->user_data);
+        return;
+    }
+
+    // ReadValue returns the value as an array of bytes, WriteValue
+    // returns nothing.
+    if (dbus_message_iter_init(message, &iter) == TRUE &&
+        dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY)
+    {
+        dbus_message_iter_recurse(&iter, &array);
+        dbus_message_iter_get_fixed_array(&array, &data, &len);
+    }
+
+    if (call->cb != NULL)
+        call->cb(call->client, 0, data, len, call->user_data);
+}
+
+static void command_reply(DBusMessage *message, void *user_data)
+{
+    struct command_call *call = user_data;
+
+    if (COMMAND_WRITE == call->type)
+        BLE_PROBE2(write_complete, call->proxy->obj_path,
+                   dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_ERROR ? -EIO : 0);
+
+    command_complete(call, message);
+}
+
+static void command_call_free(void *user_data)
+{
+    struct command_call *call = user_data;
+
+    bluez_slab_free(&call->client->commandSlab, call);
+}
+
+size_t command_call_size(void)
+{
+    return sizeof(struct command_call);
+}
+
+static void command_execute(bluez_client_t *client, struct bluez_command *cmd)
+{
+    struct command_call *call;
+    GDBusProxy *proxy;
+    gboolean sent;
+
+    proxy = bluez_client_get_proxy(client, cmd->which);
+    if (proxy == NULL || proxy->client == NULL)
+    {
+        if (cmd->cb != NULL)
+            cmd->cb(client, -ENODEV, NULL, 0, cmd->user_data);
+        return;
+    }
+
+    call = bluez_slab_alloc(&client->commandSlab);
+    if (call == NULL)
+    {
+        if (cmd->cb != NULL)
+            cmd->cb(client, -ENOMEM, NULL, 0, cmd->user_data);
+        return;
+    }
+
+    call->client = client;
+    call->proxy = proxy;
+    call->type = cmd->type;
+    call->cb = cmd->cb;
+    call->user_data = cmd->user_data;
+    call->iov.iov_base = cmd->data;
+    call->iov.iov_len = cmd->len;
+
+    // The command's data is only needed while the message is built, which
+    // happens before g_dbus_proxy_method_call() returns.
+    if (COMMAND_WRITE == cmd->type)
+        sent = g_dbus_proxy_method_call(proxy, "WriteValue", bluez_write_setup,
+                                        command_reply, call, command_call_free);
+    else
+        sent = g_dbus_proxy_method_call(proxy, "ReadValue", bluez_options_setup,
+                                        command_reply, call, command_call_free);
+
+    if (sent == FALSE)
+    {
+        command_call_free(call);
+        if (cmd->cb != NULL)
+            cmd->cb(client, -EIO, NULL, 0, cmd->user_data);
+    }
+}
+
+static gboolean command_drain(gint fd, GIOCondition cond, gpointer user_data)
+{
+    bluez_client_t *client = user_data;
+    struct command_queue *q = &client->commands;
+    struct bluez_command cmd;
+    uint64_t count;
+
+    if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        return TRUE;
+
+    // Clear the flag before draining, so a command queued while draining
+    // writes the eventfd again and is not left behind.
+    atomic_store(&q->signalled, 0);
+
+    while (command_dequeue(q, &cmd) == TRUE)
+        command_execute(client, &cmd);
+
+    return TRUE;
+}
+
+void command_queue_init(bluez_client_t *client)
+{
+    struct command_queue *q = &client->commands;
+    size_t i;
+
+    for (i = 0; i < COMMAND_QUEUE_SIZE; i++)
+        atomic_init(&q->cell[i].seq, i);
+
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->signalled, 0);
+    q->head = 0;
+
+    q->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (q->efd < 0)
+    {
+        fprintf(stderr, "Unable to create command eventfd: %s\n", strerror(errno));
+        return;
+    }
+
+    q->source = g_unix_fd_source_new(q->efd, G_IO_IN);
+    g_source_set_callback(q->source, (GSourceFunc) command_drain, client, NULL);
+    g_source_attach(q->source, client->context);
+}
+
+void command_queue_destroy(bluez_client_t *client)
+{
+    struct command_queue *q = &client->commands;
+
+    if (q->source != NULL)
+    {
+        g_source_destroy(q->source);
+        g_source_unref(q->source);
+        q->source = NULL;
+    }
+
+    if (q->efd >= 0)
+        close(q->efd);
+    q->efd = -1;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Public interface.
+
+// Reads the current value of one of the client's characteristics, such as
+// BLUEZ_PROXY_CHARACTERISTIC_RD.  Returns FALSE if the queue is full.
+gboolean bluez_submit_read(bluez_client_t *client, int which,
+                           CommandCallback cb, void *user_data)
+{
+    struct bluez_command cmd;
+
+    if (client == NULL || client->commands.efd < 0)
+        return FALSE;
+
+    cmd.type = COMMAND_READ;
+    cmd.which = which;
+    cmd.cb = cb;
+    cmd.user_data = user_data;
+    cmd.len = 0;
+
+    return command_enqueue(&client->commands, &cmd);
+}
+
+// Writes up to BLUEZ_COMMAND_MAX_DATA bytes to one of the client's
+// characteristics.  The bytes are copied, so 'data' may be reused as soon
+// as this returns.  Returns FALSE if the queue is full.
+gboolean bluez_submit_write(bluez_client_t *client, int which,
+                            const uint8_t *data, size_t len,
+                            CommandCallback cb, void *user_data)
+{
+    struct bluez_command cmd;
+
+    if (client == NULL || client->commands.efd < 0)
+        return FALSE;
+
+    if (data == NULL || len > BLUEZ_COMMAND_MAX_DATA)
+        return FALSE;
+
+    cmd.type = COMMAND_WRITE;
+    cmd.which = which;
+    cmd.cb = cb;
+    cmd.user_data = user_data;
+    cmd.len = len;
+    memcpy(cmd.data, data, len);
+
+    return command_enqueue(&client->commands, &cmd);
+}
+
+static gpointer client_thread(gpointer user_data)
+{
+    bluez_client_t *client = user_data;
+
+    // Lower only this thread's priority.  On Linux, setpriority() with a
+    // thread ID applies to that thread alone.
+    if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), CLIENT_THREAD_NICE) < 0)
+        fprintf(stderr, "Unable to lower client thread priority: %s\n", strerror(errno));
+
+    bluez_client_run(client);
+
+    return NULL;
+}
+
+// Runs the client's main loop on an internal thread.  Every client
+// callback is called on that thread from then on.
+gboolean bluez_client_start(bluez_client_t *client)
+{
+    if (client == NULL || client->thread != NULL)
+        return FALSE;
+
+    client->thread = g_thread_new("bluez-client", client_thread, client);
+
+    return TRUE;
+}
+
+static gboolean client_stop_idle(gpointer user_data)
+{
+    bluez_client_quit(user_data);
+
+    return FALSE;
+}
+
+// Stops the internal thread and waits for it to exit.  The quit request is
+// queued to the client's context, so it cannot be lost if the thread has
+// not yet entered its main loop.
+void bluez_client_stop(bluez_client_t *client)
+{
+    GSource *source;
+
+    if (client == NULL || client->thread == NULL)
+        return;
+
+    source = g_idle_source_new();
+    g_source_set_callback(source, client_stop_idle, client, NULL);
+    g_source_attach(source, client->context);
+    g_source_unref(source);
+
+    g_thread_join(client->thread);
+    client->thread = NULL;
+}
@@ -0,0 +1,234 @@
+//
+// bleTrace.c
+//
+// Created  10/18/2026
+//
+// Per-thread trace rings for the flight recorder.  Each thread records
+// into a ring of its own, allocated on first use and pushed onto a
+// lock-free list, so recording takes no lock.  The newest
+// TRACE_RING_SIZE events of each thread are kept.
+//
+// The dump code runs from signal handlers, so it uses only
+// async-signal-safe calls: no stdio, no allocation, no locks.  A record
+// being written while the dump runs may appear torn.  That is acceptable
+// for a post-mortem log.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "bleTrace.h"
+
+// Must be a power of two.
+#define TRACE_RING_SIZE 1024
+
+struct trace_record
+{
+    uint64_t ns;
+    const char *event;
+    int64_t a;
+    int64_t b;
+    uint8_t level;
+    char text[TRACE_TEXT_MAX];
+};
+
+struct trace_ring
+{
+    struct trace_record record[TRACE_RING_SIZE];
+    atomic_uint_fast64_t next;          // total records ever written
+    int thread;
+    struct trace_ring *next_ring;
+};
+
+static _Atomic(struct trace_ring *) rings;
+static atomic_int ring_count;
+static __thread struct trace_ring *my_ring;
+
+static int dump_fd = 2;
+
+static const int crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+
+static struct trace_ring *ring_get(void)
+{
+    struct trace_ring *ring = my_ring;
+
+    if (G_LIKELY(ring != NULL))
+        return ring;
+
+    ring = g_new0(struct trace_ring, 1);
+    ring->thread = atomic_fetch_add(&ring_count, 1);
+
+    ring->next_ring = atomic_load(&rings);
+    while (!atomic_compare_exchange_weak(&rings, &ring->next_ring, ring))
+        ;
+
+    my_ring = ring;
+    return ring;
+}
+
+void bluez_trace_record(int level, const char *event, const char *text,
+                        int64_t a, int64_t b)
+{
+    struct trace_ring *ring = ring_get();
+    uint64_t n = atomic_load_explicit(&ring->next, memory_order_relaxed);
+    struct trace_record *r = &ring->record[n & (TRACE_RING_SIZE - 1)];
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    r->ns = (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+    r->event = event;
+    r->a = a;
+    r->b = b;
+    r->level = level;
+
+    if (text != NULL)
+    {
+        size_t len = strnlen(text, TRACE_TEXT_MAX - 1);
+        memcpy(r->text, text, len);
+        r->text[len] = '\0';
+    }
+    else
+        r->text[0] = '\0';
+
+    atomic_store_explicit(&ring->next, n + 1, memory_order_release);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Dump, async-signal-safe.
+
+struct line
+{
+    char buf[160];
+    size_t len;
+};
+
+static void put_str(struct line *l, const char *s)
+{
+    while (*s && l->len < sizeof(l->buf) - 1)
+        l->buf[l->len++] = *s++;
+}
+
+static void put_u64(struct line *l, uint64_t v, int width)
+{
+    char digits[21];
+    int n = 0;
+
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+
+    while (n < width)
+        digits[n++] = '0';
+
+    while (n > 0 && l->len < sizeof(l->buf) - 1)
+        l->buf[l->len++] = digits[--n];
+}
+
+static void put_i64(struct line *l, int64_t v)
+{
+    if (v < 0)
+    {
+        put_str(l, "-");
+        put_u64(l, -(uint64_t)v, 0);
+    }
+    else
+        put_u64(l, v, 0);
+}
+
+static void dump_record(int fd, int thread, const struct trace_record *r)
+{
+    static const char levels[] = "EWID";
+    struct line l = { .len = 0 };
+    char level[2] = { levels[r->level & 3], '\0' };
+
+    put_u64(&l, r->ns / 1000000000u, 0);
+    put_str(&l, ".");
+    put_u64(&l, (r->ns / 1000u) % 1000000u, 6);
+    put_str(&l, " T");
+    put_u64(&l, thread, 0);
+    put_str(&l, " ");
+    put_str(&l, level);
+    put_str(&l, " ");
+    put_str(&l, r->event);
+    if (r->text[0])
+    {
+        put_str(&l, " ");
+        put_str(&l, r->text);
+    }
+    put_str(&l, " ");
+    put_i64(&l, r->a);
+    put_str(&l, " ");
+    put_i64(&l, r->b);
+    l.buf[l.len++] = '\n';
+
+    if (write(fd, l.buf, l.len) < 0)
+        return;
+}
+
+// Writes every thread's ring to 'fd', oldest record first.
+void bluez_trace_dump(int fd)
+{
+    struct trace_ring *ring;
+    uint64_t next, i;
+
+    for (ring = atomic_load(&rings); ring != NULL; ring = ring->next_ring)
+    {
+        next = atomic_load_explicit(&ring->next, memory_order_acquire);
+        i = (next > TRACE_RING_SIZE) ? next - TRACE_RING_SIZE : 0;
+
+        for ( ; i < next; i++)
+            dump_record(fd, ring->thread, &ring->record[i & (TRACE_RING_SIZE - 1)]);
+    }
+}
+
+static gboolean trace_sigusr1(gpointer user_data)
+{
+    bluez_trace_dump(dump_fd);
+
+    return TRUE;
+}
+
+static void trace_crash(int sig)
+{
+    static const char banner[] = "--- flight recorder ---\n";
+
+    if (write(dump_fd, banner, sizeof(banner) - 1) >= 0)
+        bluez_trace_dump(dump_fd);
+
+    // The handler was installed with SA_RESETHAND, so re-raising the
+    // signal now terminates the program the way it would have without us.
+    raise(sig);
+}
+
+// Dumps the trace to 'fd' when SIGUSR1 is received, handled on the given
+// main context (NULL for the default context), and from a signal handler
+// when the program crashes.
+void bluez_trace_install(GMainContext *context, int fd)
+{
+    struct sigaction sa;
+    GSource *source;
+    size_t i;
+
+    dump_fd = fd;
+
+    source = g_unix_signal_source_new(SIGUSR1);
+    g_source_set_callback(source, trace_sigusr1, NULL, NULL);
+    g_source_attach(source, context);
+    g_source_unref(source);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = trace_crash;
+    sa.sa_flags = SA_RESETHAND | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+
+    for (i = 0; i < G_N_ELEMENTS(crash_signals); i++)
+        sigaction(crash_signals[i], &sa, NULL);
+}
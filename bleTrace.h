@@ -0,0 +1,52 @@
+//
+// bleTrace.h
+//
+// Created  10/18/2026
+//
+// In-process flight recorder.  Events are recorded in binary form into a
+// per-thread ring, at the cost of a clock read and a few stores, instead
+// of a write() to stderr.  The rings are dumped as text on SIGUSR1 and
+// when the program crashes.
+//
+// Events above BLE_TRACE_LEVEL are removed at compile time.  Build with,
+// for example, -DBLE_TRACE_LEVEL=TRACE_INFO to strip the debug events.
+
+#ifndef BLE_TRACE_H
+#define BLE_TRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACE_ERROR 0
+#define TRACE_WARN  1
+#define TRACE_INFO  2
+#define TRACE_DEBUG 3
+
+#ifndef BLE_TRACE_LEVEL
+#define BLE_TRACE_LEVEL TRACE_DEBUG
+#endif
+
+// 'event' must be a string literal.  'text' is copied, truncated to
+// TRACE_TEXT_MAX - 1 characters, and may be NULL.
+#define BLE_TRACE(level, event, text, a, b)                                 \
+    do {                                                                    \
+        if ((level) <= BLE_TRACE_LEVEL)                                     \
+            bluez_trace_record((level), (event), (text),                    \
+                               (int64_t)(a), (int64_t)(b));                 \
+    } while (0)
+
+#define TRACE_TEXT_MAX 24
+
+void    bluez_trace_dump        (int fd);
+void    bluez_trace_install     (GMainContext *context, int fd);
+void    bluez_trace_record      (int level, const char *event, const char *text,
+                                 int64_t a, int64_t b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLE_TRACE_H
@@ -0,0 +1,133 @@
+//
+// bleTransport.c
+//
+// Created  10/18/2026
+//
+// Transport selection, and the libdbus transport, which hands everything
+// to BlueZ's gdbus helpers on the client's own connection.  See
+// bleTransport.h.
+
+#include <stdio.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleClientPrivate.h"
+#include "bleTransport.h"
+
+static void *libdbus_open(DBusBusType bus, GMainContext *context, DBusConnection *shared)
+{
+    return shared;
+}
+
+static void libdbus_close(void *conn)
+{
+}
+
+static gboolean libdbus_send(void *conn, DBusMessage *msg)
+{
+    // g_dbus_send_message() consumes the message.
+    return g_dbus_send_message(conn, dbus_message_ref(msg));
+}
+
+static void libdbus_reply(DBusPendingCall *pending, void *user_data)
+{
+    struct transport_call *call = user_data;
+    DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+
+    call->reply(reply, call);
+
+    dbus_message_unref(reply);
+}
+
+static void libdbus_call_free(void *user_data)
+{
+    struct transport_call *call = user_data;
+
+    call->free(call);
+}
+
+static gboolean libdbus_call(void *conn, DBusMessage *msg, int timeout,
+                             struct transport_call *call)
+{
+    DBusPendingCall *pending;
+
+    if (g_dbus_send_message_with_reply(conn, msg, &pending, timeout) == FALSE)
+        return FALSE;
+
+    dbus_pending_call_set_notify(pending, libdbus_reply, call, libdbus_call_free);
+    dbus_pending_call_unref(pending);
+
+    return TRUE;
+}
+
+static guint libdbus_add_signal_watch(void *conn, const char *sender, const char *path,
+                                      const char *interface, const char *member,
+                                      GDBusSignalFunction function, void *user_data,
+                                      GDBusDestroyFunction destroy)
+{
+    return g_dbus_add_signal_watch(conn, sender, path, interface, member,
+                                   function, user_data, destroy);
+}
+
+static guint libdbus_add_properties_watch(void *conn, const char *sender, const char *path,
+                                          const char *interface,
+                                          GDBusSignalFunction function, void *user_data,
+                                          GDBusDestroyFunction destroy)
+{
+    return g_dbus_add_properties_watch(conn, sender, path, interface,
+                                       function, user_data, destroy);
+}
+
+static guint libdbus_add_service_watch(void *conn, const char *name,
+                                       GDBusWatchFunction connect,
+                                       GDBusWatchFunction disconnect,
+                                       void *user_data, GDBusDestroyFunction destroy)
+{
+    return g_dbus_add_service_watch(conn, name, connect, disconnect, user_data, destroy);
+}
+
+static gboolean libdbus_remove_watch(void *conn, guint id)
+{
+    return g_dbus_remove_watch(conn, id);
+}
+
+static const struct bluez_transport libdbus_transport = {
+    .name = "libdbus",
+    .open = libdbus_open,
+    .close = libdbus_close,
+    .send = libdbus_send,
+    .call = libdbus_call,
+    .add_signal_watch = libdbus_add_signal_watch,
+    .add_properties_watch = libdbus_add_properties_watch,
+    .add_service_watch = libdbus_add_service_watch,
+    .remove_watch = libdbus_remove_watch
+};
+
+const struct bluez_transport *bluez_transport_get(int which)
+{
+    switch (which)
+    {
+        case BLUEZ_TRANSPORT_LIBDBUS:
+            return &libdbus_transport;
+
+        default:
+            return NULL;
+    }
+}
+
+// Selects the transport, BLUEZ_TRANSPORT_LIBDBUS.
+// Call before bluez_client_init().  Returns FALSE if the transport was not
+// built in.
+gboolean bluez_client_set_transport(bluez_client_t *client, int which)
+{
+    const struct bluez_transport *transport = bluez_transport_get(which);
+
+    if (transport == NULL || client->gdbus.dbus_conn != NULL)
+        return FALSE;
+
+    client->transport = transport;
+
+    return TRUE;
+}
@@ -0,0 +1,79 @@
+//
+// bleTransport.h
+//
+// Created  10/18/2026
+//
+// D-Bus transports.  Method calls made through g_dbus_proxy_method_call(),
+// the properties watches on the bound proxies and the signal and service
+// watches set up by bluez_client_init() all go through the client's
+// transport, selected with bluez_client_set_transport().  Messages are
+// built and parsed with libdbus whichever transport carries them, so the
+// rest of the client is the same for all of them.
+//
+//    libdbus   the client's own libdbus connection, through BlueZ's gdbus
+//              helpers, as before transports were added
+//
+// A transport on another bus library has to parse at least the hot
+// signals natively: copying each message into libdbus cost sd-bus five
+// times the CPU per PropertiesChanged of libdbus itself.
+//
+// GetManagedObjects and property writes go through the transport too.
+// D-Bus orders messages only within one connection, so a reply carried
+// on another connection than the signals could be applied after a newer
+// signal.
+//
+// Include after bleClient.h.
+
+#ifndef BLE_TRANSPORT_H
+#define BLE_TRANSPORT_H
+
+// Context of a method call waiting for its reply.  The caller embeds it
+// as the first member of its own context, and gets that back in 'reply',
+// which is called once with the reply or an error, and then in 'free'.
+struct transport_call;
+
+typedef void (* TransportReplyFunction) (DBusMessage *reply, struct transport_call *call);
+typedef void (* TransportFreeFunction) (struct transport_call *call);
+
+struct transport_call
+{
+    TransportReplyFunction reply;
+    TransportFreeFunction free;
+};
+
+// 'conn' is whatever open() returned.  Watch callbacks are passed the
+// libdbus connection on the libdbus transport and NULL on others.
+// Messages passed in are not consumed.
+struct bluez_transport
+{
+    const char *name;
+
+    // 'shared' is the libdbus connection already open on 'bus', which the
+    // libdbus transport uses as is.
+    void *   (* open)                   (DBusBusType bus, GMainContext *context,
+                                         DBusConnection *shared);
+    void     (* close)                  (void *conn);
+
+    gboolean (* send)                   (void *conn, DBusMessage *msg);
+    gboolean (* call)                   (void *conn, DBusMessage *msg, int timeout,
+                                         struct transport_call *call);
+
+    guint    (* add_signal_watch)       (void *conn, const char *sender, const char *path,
+                                         const char *interface, const char *member,
+                                         GDBusSignalFunction function, void *user_data,
+                                         GDBusDestroyFunction destroy);
+    guint    (* add_properties_watch)   (void *conn, const char *sender, const char *path,
+                                         const char *interface,
+                                         GDBusSignalFunction function, void *user_data,
+                                         GDBusDestroyFunction destroy);
+    guint    (* add_service_watch)      (void *conn, const char *name,
+                                         GDBusWatchFunction connect,
+                                         GDBusWatchFunction disconnect,
+                                         void *user_data, GDBusDestroyFunction destroy);
+    gboolean (* remove_watch)           (void *conn, guint id);
+};
+
+// NULL for a transport not built in.
+const struct bluez_transport *bluez_transport_get(int which);
+
+#endif // BLE_TRANSPORT_H
@@ -0,0 +1,300 @@
+//
+// bleTransportBench.c
+//
+// Created  10/18/2026
+//
+// Compares the D-Bus transports, see bleTransport.h, on a local bus.  For
+// each transport built in, reports the following:
+//
+//    - PropertiesChanged signals received per second, and the receiving
+//      thread's CPU time per signal.  An emitter thread on its own
+//      connection sends Device1 RSSI changes, keeping a fixed number in
+//      flight so the bus never has to queue more than that.
+//    - Method calls completed per second, and CPU time per call, with a
+//      fixed number pipelined.  The calls are GetId on the bus itself, so
+//      no server is needed and the time is all transport and bus.
+//
+// Run it with "make transportbench", which starts a private session bus.
+//
+// Usage:
+//    bleTransportBench [-n signals] [-c calls] [-w in flight]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleTransport.h"
+
+#define BENCH_PATH          "/org/bluez/hci0/dev_00_11_22_33_44_55"
+#define BENCH_INTERFACE     "org.bluez.Device1"
+
+static struct {
+    int signals;
+    int calls;
+    int window;
+    GMainContext *context;
+    atomic_int received;
+    atomic_int emitterStop;
+    int completed;
+    int issued;
+    int16_t rssi;
+} bench = { .signals = 100000, .calls = 50000, .window = 64 };
+
+static uint64_t clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static DBusMessage *rssi_changed(int16_t rssi)
+{
+    const char *interface = BENCH_INTERFACE, *name = "RSSI";
+    DBusMessageIter iter, dict, entry, variant, invalidated;
+    DBusMessage *msg;
+
+    msg = dbus_message_new_signal(BENCH_PATH, DBUS_INTERFACE_PROPERTIES, "PropertiesChanged");
+
+    dbus_message_iter_init_append(msg, &iter);
+    dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &interface);
+
+    dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &dict);
+    dbus_message_iter_open_container(&dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &name);
+    dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT, "n", &variant);
+    dbus_message_iter_append_basic(&variant, DBUS_TYPE_INT16, &rssi);
+    dbus_message_iter_close_container(&entry, &variant);
+    dbus_message_iter_close_container(&dict, &entry);
+    dbus_message_iter_close_container(&iter, &dict);
+
+    dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "s", &invalidated);
+    dbus_message_iter_close_container(&iter, &invalidated);
+
+    return msg;
+}
+
+static void *emitter_thread(void *arg)
+{
+    DBusConnection *conn = arg;
+    DBusMessage *msg;
+    struct timespec pause = { 0, 20000 };
+    int sent = 0;
+
+    while (sent < bench.signals && !atomic_load(&bench.emitterStop))
+    {
+        if (sent - atomic_load(&bench.received) >= bench.window)
+        {
+            dbus_connection_flush(conn);
+            nanosleep(&pause, NULL);
+            continue;
+        }
+
+        msg = rssi_changed(-(sent % 100));
+        dbus_connection_send(conn, msg, NULL);
+        dbus_message_unref(msg);
+        sent++;
+    }
+
+    dbus_connection_flush(conn);
+    return NULL;
+}
+
+// Parses the RSSI out of each change, as a client would.
+static gboolean properties_changed(DBusConnection *conn, DBusMessage *msg, void *user_data)
+{
+    DBusMessageIter iter, dict, entry, variant;
+
+    if (dbus_message_iter_init(msg, &iter) && dbus_message_iter_next(&iter))
+    {
+        dbus_message_iter_recurse(&iter, &dict);
+        dbus_message_iter_recurse(&dict, &entry);
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_recurse(&entry, &variant);
+        if (dbus_message_iter_get_arg_type(&variant) == DBUS_TYPE_INT16)
+            dbus_message_iter_get_basic(&variant, &bench.rssi);
+    }
+
+    atomic_fetch_add(&bench.received, 1);
+
+    return TRUE;
+}
+
+static void call_reply(DBusMessage *reply, struct transport_call *call)
+{
+    if (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR)
+        fprintf(stderr, "GetId failed: %s\n", dbus_message_get_error_name(reply));
+
+    bench.completed++;
+}
+
+static void call_free(struct transport_call *call)
+{
+}
+
+static struct transport_call bench_call = { call_reply, call_free };
+
+static gboolean call_next(const struct bluez_transport *transport, void *conn)
+{
+    DBusMessage *msg;
+    gboolean sent;
+
+    msg = dbus_message_new_method_call(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS,
+                                       DBUS_INTERFACE_DBUS, "GetId");
+    sent = transport->call(conn, msg, -1, &bench_call);
+    dbus_message_unref(msg);
+
+    bench.issued++;
+
+    return sent;
+}
+
+static void run_signals(const struct bluez_transport *transport, void *conn)
+{
+    DBusConnection *emitter;
+    pthread_t thread;
+    uint64_t wall, cpu;
+    guint id;
+
+    id = transport->add_properties_watch(conn, NULL, BENCH_PATH, BENCH_INTERFACE,
+                                         properties_changed, NULL, NULL);
+
+    emitter = dbus_bus_get_private(DBUS_BUS_SESSION, NULL);
+    if (id == 0 || emitter == NULL)
+    {
+        fprintf(stderr, "%s: unable to set up the signal run\n", transport->name);
+        exit(1);
+    }
+
+    // Make sure the match is in place at the bus before the first signal.
+    bench.issued = bench.completed = 0;
+    call_next(transport, conn);
+    while (bench.completed < 1)
+        g_main_context_iteration(bench.context, TRUE);
+
+    atomic_store(&bench.received, 0);
+    atomic_store(&bench.emitterStop, 0);
+
+    wall = clock_ns(CLOCK_MONOTONIC);
+    cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+    pthread_create(&thread, NULL, emitter_thread, emitter);
+    while (atomic_load(&bench.received) < bench.signals)
+        g_main_context_iteration(bench.context, TRUE);
+
+    cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu;
+    wall = clock_ns(CLOCK_MONOTONIC) - wall;
+
+    atomic_store(&bench.emitterStop, 1);
+    pthread_join(thread, NULL);
+    dbus_connection_close(emitter);
+    dbus_connection_unref(emitter);
+
+    transport->remove_watch(conn, id);
+
+    printf("%s_signals_per_second %.0f\n", transport->name, bench.signals * 1e9 / wall);
+    printf("%s_cpu_us_per_signal %.3f\n", transport->name, cpu / 1e3 / bench.signals);
+}
+
+static void run_calls(const struct bluez_transport *transport, void *conn)
+{
+    uint64_t wall, cpu;
+
+    bench.issued = bench.completed = 0;
+
+    wall = clock_ns(CLOCK_MONOTONIC);
+    cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+    while (bench.completed < bench.calls)
+    {
+        while (bench.issued < bench.calls && bench.issued - bench.completed < bench.window)
+        {
+            if (call_next(transport, conn) == FALSE)
+            {
+                fprintf(stderr, "%s: unable to send GetId\n", transport->name);
+                exit(1);
+            }
+        }
+
+        g_main_context_iteration(bench.context, TRUE);
+    }
+
+    cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu;
+    wall = clock_ns(CLOCK_MONOTONIC) - wall;
+
+    printf("%s_calls_per_second %.0f\n", transport->name, bench.calls * 1e9 / wall);
+    printf("%s_cpu_us_per_call %.3f\n", transport->name, cpu / 1e3 / bench.calls);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: bleTransportBench [-n signals] [-c calls] [-w in flight]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    static const int transports[] = { BLUEZ_TRANSPORT_LIBDBUS };
+    const struct bluez_transport *transport;
+    DBusConnection *shared;
+    void *conn;
+    guint i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:c:w:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': bench.signals = atoi(optarg); break;
+            case 'c': bench.calls = atoi(optarg); break;
+            case 'w': bench.window = atoi(optarg); break;
+            default:  usage();
+        }
+    }
+
+    if (bench.signals < 1 || bench.calls < 1 || bench.window < 1)
+        usage();
+
+    bench.context = g_main_context_new();
+
+    printf("signals %d\n", bench.signals);
+    printf("calls %d\n", bench.calls);
+    printf("in_flight %d\n", bench.window);
+
+    for (i = 0; i < G_N_ELEMENTS(transports); i++)
+    {
+        transport = bluez_transport_get(transports[i]);
+        if (transport == NULL)
+        {
+            printf("# transport %d not built in\n", transports[i]);
+            continue;
+        }
+
+        shared = bluez_setup_bus(DBUS_BUS_SESSION, bench.context);
+        if (shared == NULL)
+            return 1;
+
+        conn = transport->open(DBUS_BUS_SESSION, bench.context, shared);
+        if (conn == NULL)
+            return 1;
+
+        run_signals(transport, conn);
+        run_calls(transport, conn);
+
+        transport->close(conn);
+        bluez_close_bus(shared);
+    }
+
+    g_main_context_unref(bench.context);
+
+    return 0;
+}
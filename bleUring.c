@@ -0,0 +1,771 @@
+//
+// bleUring.c
+//
+// Created  10/18/2026
+//
+// io_uring event backend, built with URING=1 and selected with
+// bluez_client_set_backend().  With the GLib backend every ready
+// descriptor costs the client thread a poll wakeup and at least one read
+// or write system call.  Here the client's descriptors are serviced by one
+// io_uring instance instead:
+//
+//    - AcquireNotify sockets get a multishot receive into a ring of
+//      provided buffers, so the kernel keeps receiving without being
+//      asked again, and each notification is just a completion.
+//    - Writes on AcquireWrite sockets are sends.  They wait in a queue and
+//      go to the kernel as linked chains, one chain at a time, so that
+//      they go out in order.
+//    - The D-Bus connection's watches become poll requests, re-armed after
+//      each event, which is what the GLib unix fd sources did.
+//
+// Requests are queued as they are made and submitted together, with one
+// io_uring_enter() call, just before the main loop sleeps.  The ring's
+// descriptor is watched by a single source on the client's context, whose
+// dispatch handles every completion waiting.  D-Bus timeouts and the
+// client's other sources stay on the GLib loop.
+//
+// Only the raw system calls are used, so liburing is not needed.  Provided
+// buffer rings need Linux 5.19, and multishot receive 6.0.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleClientPrivate.h"
+
+// Submission queue entries.  The completion queue is four times larger,
+// since one multishot receive can complete many times per submission.
+#define URING_ENTRIES       256
+
+// Provided receive buffers, a power of two, each holding the largest
+// attribute value.
+#define URING_BUFFERS       256
+#define URING_BUFFER_SIZE   512
+#define URING_BGID          0
+
+enum {
+    URING_POLL,
+    URING_RECV,
+    URING_SEND
+};
+
+struct uring_op
+{
+    int type;
+    int fd;
+    unsigned int events;        // URING_POLL
+    UringCallback cb;
+    void *user_data;
+    gboolean queued;            // submitted or waiting to be, until its last completion
+    gboolean cancelled;         // released by its owner, freed when no longer queued
+    gboolean completing;        // in op_complete(), which frees it if need be
+    struct uring_op *prev;      // every request of the ring, for uring_free()
+    struct uring_op *next;
+    struct uring_op *sendNext;  // URING_SEND, waiting for the chain ahead of it
+    size_t len;                 // URING_SEND
+    uint8_t data[];
+};
+
+struct uring_source
+{
+    GSource source;
+    struct bluez_uring *ring;
+};
+
+struct bluez_uring
+{
+    int fd;
+    GSource *source;
+
+    // Submission queue, shared with the kernel.
+    unsigned int *sqHead;
+    unsigned int *sqTail;
+    unsigned int sqMask;
+    unsigned int *sqArray;
+    unsigned int *sqFlags;
+    struct io_uring_sqe *sqes;
+    unsigned int tail;          // our tail, ahead of *sqTail by the unsubmitted count
+
+    // Completion queue.
+    unsigned int *cqHead;
+    unsigned int *cqTail;
+    unsigned int cqMask;
+    struct io_uring_cqe *cqes;
+
+    void *ringMap;
+    size_t ringMapSize;
+    size_t sqesSize;
+
+    // Provided receive buffers.
+    struct io_uring_buf_ring *bufRing;
+    uint8_t *buffers;
+    uint16_t bufTail;
+    gboolean hold;              // set by uring_hold_buffer() in a receive callback
+
+    struct uring_op *ops;
+
+    // Sends not yet queued, oldest first, and the number of the chain
+    // queued before them still to complete.
+    struct uring_op *sendHead;
+    struct uring_op *sendTail;
+    unsigned int sendsInFlight;
+
+    struct bluez_uring_stats stats;
+};
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Rings.
+
+static int uring_enter(int fd, unsigned int submit, unsigned int wait, unsigned int flags)
+{
+    return syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+}
+
+// Hands queued entries to the kernel.
+static void uring_submit(struct bluez_uring *ring)
+{
+    unsigned int pending = ring->tail - *ring->sqTail;
+    int n;
+
+    if (pending == 0)
+        return;
+
+    __atomic_store_n(ring->sqTail, ring->tail, __ATOMIC_RELEASE);
+
+    do
+    {
+        n = uring_enter(ring->fd, pending, 0, 0);
+    }
+    while (n < 0 && errno == EINTR);
+
+    ring->stats.enters++;
+    if (n < 0)
+        fprintf(stderr, "io_uring submit failed: %s\n", strerror(errno));
+}
+
+// Free submission queue entries, after submitting if there are none.
+static unsigned int uring_room(struct bluez_uring *ring)
+{
+    unsigned int room = ring->sqMask + 1 - (ring->tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE));
+
+    if (room == 0)
+    {
+        uring_submit(ring);
+        room = ring->sqMask + 1 - (ring->tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE));
+    }
+
+    return room;
+}
+
+static struct io_uring_sqe *uring_get_sqe(struct bluez_uring *ring)
+{
+    struct io_uring_sqe *sqe;
+
+    if (uring_room(ring) == 0)
+        return NULL;
+
+    sqe = &ring->sqes[ring->tail & ring->sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sqArray[ring->tail & ring->sqMask] = ring->tail & ring->sqMask;
+    ring->tail++;
+    ring->stats.requests++;
+
+    return sqe;
+}
+
+static void buffer_put(struct bluez_uring *ring, unsigned int bid)
+{
+    struct io_uring_buf *buf = &ring->bufRing->bufs[ring->bufTail & (URING_BUFFERS - 1)];
+
+    buf->addr = (uintptr_t)(ring->buffers + bid * URING_BUFFER_SIZE);
+    buf->len = URING_BUFFER_SIZE;
+    buf->bid = bid;
+
+    ring->bufTail++;
+    __atomic_store_n(&ring->bufRing->tail, ring->bufTail, __ATOMIC_RELEASE);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Requests.
+
+// Queues the request for 'op'.  Returns FALSE if the queue is full even
+// after submitting.
+static gboolean op_queue(struct bluez_uring *ring, struct uring_op *op)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(ring);
+
+    if (sqe == NULL)
+        return FALSE;
+
+    sqe->fd = op->fd;
+    sqe->user_data = (uintptr_t)op;
+
+    switch (op->type)
+    {
+        case URING_POLL:
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->poll32_events = op->events;
+            break;
+
+        case URING_RECV:
+            sqe->opcode = IORING_OP_RECV;
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = URING_BGID;
+            break;
+
+        case URING_SEND:
+            sqe->opcode = IORING_OP_SEND;
+            sqe->addr = (uintptr_t)op->data;
+            sqe->len = op->len;
+            sqe->msg_flags = MSG_NOSIGNAL;
+            break;
+    }
+
+    op->queued = TRUE;
+
+    return TRUE;
+}
+
+static struct uring_op *op_new(struct bluez_uring *ring, int type, int fd, size_t len,
+                               UringCallback cb, void *user_data)
+{
+    struct uring_op *op = g_malloc0(sizeof(struct uring_op) + len);
+
+    op->type = type;
+    op->fd = fd;
+    op->cb = cb;
+    op->user_data = user_data;
+    op->len = len;
+
+    op->next = ring->ops;
+    if (ring->ops != NULL)
+        ring->ops->prev = op;
+    ring->ops = op;
+
+    return op;
+}
+
+static void op_free(struct bluez_uring *ring, struct uring_op *op)
+{
+    if (op->prev != NULL)
+        op->prev->next = op->next;
+    else
+        ring->ops = op->next;
+    if (op->next != NULL)
+        op->next->prev = op->prev;
+
+    g_free(op);
+}
+
+// Queues the sends waiting for the first one's socket, as one chain, once
+// the chain before has completed.  Requests are not ordered unless
+// linked, and a link holds only between adjacent entries, so the chain is
+// queued with nothing in between.  A failed send cancels the rest of its
+// chain.
+static void sends_flush(struct bluez_uring *ring)
+{
+    struct io_uring_sqe *prev = NULL;
+    struct uring_op *op;
+    unsigned int room;
+    int fd;
+
+    if (ring->sendsInFlight > 0 || ring->sendHead == NULL)
+        return;
+
+    room = uring_room(ring);
+    fd = ring->sendHead->fd;
+
+    while ((op = ring->sendHead) != NULL && op->fd == fd && room-- > 0)
+    {
+        op_queue(ring, op);
+        if (prev != NULL)
+            prev->flags |= IOSQE_IO_LINK;
+        prev = &ring->sqes[(ring->tail - 1) & ring->sqMask];
+
+        ring->sendHead = op->sendNext;
+        ring->sendsInFlight++;
+    }
+
+    if (ring->sendHead == NULL)
+        ring->sendTail = NULL;
+}
+
+// Watches 'fd' for the poll(2) 'events', calling 'cb' with the events that
+// occurred each time it is ready, until uring_cancel().
+struct uring_op *uring_poll(struct bluez_uring *ring, int fd, unsigned int events,
+                            UringCallback cb, void *user_data)
+{
+    struct uring_op *op = op_new(ring, URING_POLL, fd, 0, cb, user_data);
+
+    op->events = events;
+    if (op_queue(ring, op) == FALSE)
+    {
+        op_free(ring, op);
+        return NULL;
+    }
+
+    return op;
+}
+
+// Receives from the socket 'fd' until uring_cancel(), calling 'cb' with
+// the length and data of each message, with zero at end of file, or with
+// a negative errno.  Messages already received when the request is
+// cancelled are still passed on, so that none are lost.
+struct uring_op *uring_recv(struct bluez_uring *ring, int fd, UringCallback cb, void *user_data)
+{
+    struct uring_op *op = op_new(ring, URING_RECV, fd, 0, cb, user_data);
+
+    if (op_queue(ring, op) == FALSE)
+    {
+        op_free(ring, op);
+        return NULL;
+    }
+
+    return op;
+}
+
+// Sends a copy of 'data' on the socket 'fd', after every send already
+// queued.  'cb', if not NULL, is called with the result, -ECANCELED if a
+// send before it in its chain failed.
+void uring_send(struct bluez_uring *ring, int fd, const void *data, size_t len,
+                UringCallback cb, void *user_data)
+{
+    struct uring_op *op = op_new(ring, URING_SEND, fd, len, cb, user_data);
+
+    memcpy(op->data, data, len);
+
+    // Released now: it is freed after its completion.
+    op->cancelled = TRUE;
+
+    if (ring->sendTail != NULL)
+        ring->sendTail->sendNext = op;
+    else
+        ring->sendHead = op;
+    ring->sendTail = op;
+}
+
+// Drops the sends for 'fd' that are still waiting to be queued, without
+// callbacks.  Called before closing it, since they would otherwise go to
+// whatever reuses the descriptor.  Sends already with the kernel hold
+// their own reference to the socket.
+void uring_send_drop(struct bluez_uring *ring, int fd)
+{
+    struct uring_op **link = &ring->sendHead;
+    struct uring_op *op;
+
+    ring->sendTail = NULL;
+
+    while ((op = *link) != NULL)
+    {
+        if (op->fd == fd)
+        {
+            *link = op->sendNext;
+            op_free(ring, op);
+        }
+        else
+        {
+            ring->sendTail = op;
+            link = &op->sendNext;
+        }
+    }
+}
+
+// Stops a poll or receive.  No callbacks are made for it afterwards,
+// except as described at uring_recv().
+void uring_cancel(struct bluez_uring *ring, struct uring_op *op)
+{
+    struct io_uring_sqe *sqe;
+
+    if (op == NULL)
+        return;
+
+    op->cancelled = TRUE;
+    if (op->queued == FALSE)
+    {
+        if (op->completing == FALSE)
+            op_free(ring, op);
+        return;
+    }
+
+    sqe = uring_get_sqe(ring);
+    if (sqe == NULL)
+        return;         // completes when its descriptor is closed
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = (uintptr_t)op;
+    sqe->user_data = 0;
+}
+
+// Called from a receive callback, keeps the buffer it was passed out of
+// the ring until uring_release_buffer().  While buffers are held the
+// kernel has fewer to receive into, and ends a multishot receive when
+// it has none.
+void uring_hold_buffer(struct bluez_uring *ring)
+{
+    ring->hold = TRUE;
+}
+
+// Returns a buffer kept with uring_hold_buffer() to the ring.  'data' is
+// the pointer the receive callback was given.
+void uring_release_buffer(struct bluez_uring *ring, const uint8_t *data)
+{
+    buffer_put(ring, (data - ring->buffers) / URING_BUFFER_SIZE);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Completions.
+
+static void op_complete(struct bluez_uring *ring, struct uring_op *op, int res,
+                        unsigned int flags)
+{
+    gboolean more = (flags & IORING_CQE_F_MORE) != 0;
+    unsigned int bid;
+
+    if (more == FALSE)
+        op->queued = FALSE;
+
+    // The callback may cancel the request, or close its descriptor.
+    op->completing = TRUE;
+
+    switch (op->type)
+    {
+        case URING_RECV:
+            if (flags & IORING_CQE_F_BUFFER)
+            {
+                bid = flags >> IORING_CQE_BUFFER_SHIFT;
+                ring->hold = FALSE;
+                if (res > 0)
+                    op->cb(op->user_data, res, ring->buffers + bid * URING_BUFFER_SIZE);
+                if (ring->hold == FALSE)
+                    buffer_put(ring, bid);
+                ring->hold = FALSE;
+            }
+            else if (op->cancelled == FALSE && res != -ENOBUFS && res != -ECANCELED)
+                op->cb(op->user_data, res, NULL);
+
+            // The kernel ends a multishot receive when it runs out of
+            // buffers.  Ask again, now that they have been returned.
+            if (more == FALSE && op->cancelled == FALSE && (res > 0 || res == -ENOBUFS))
+                op_queue(ring, op);
+            break;
+
+        case URING_POLL:
+            if (op->cancelled == FALSE && res != -ECANCELED)
+            {
+                op->cb(op->user_data, res, NULL);
+                if (op->cancelled == FALSE && op->queued == FALSE && res >= 0)
+                    op_queue(ring, op);
+            }
+            break;
+
+        case URING_SEND:
+            ring->sendsInFlight--;
+            if (op->cb != NULL)
+                op->cb(op->user_data, res, NULL);
+            break;
+    }
+
+    op->completing = FALSE;
+    if (op->cancelled && op->queued == FALSE)
+        op_free(ring, op);
+}
+
+// Completions that did not fit in the completion queue are held by the
+// kernel until io_uring_enter() is called to get events.
+static gboolean uring_overflow(struct bluez_uring *ring)
+{
+    return (__atomic_load_n(ring->sqFlags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) != 0;
+}
+
+static gboolean uring_pending(struct bluez_uring *ring)
+{
+    return *ring->cqHead != __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE) ||
+           uring_overflow(ring);
+}
+
+static gboolean uring_source_prepare(GSource *source, gint *timeout)
+{
+    struct bluez_uring *ring = ((struct uring_source *)source)->ring;
+
+    sends_flush(ring);
+    uring_submit(ring);
+    *timeout = -1;
+
+    return uring_pending(ring);
+}
+
+static gboolean uring_source_check(GSource *source)
+{
+    return uring_pending(((struct uring_source *)source)->ring);
+}
+
+static gboolean uring_source_dispatch(GSource *source, GSourceFunc callback, gpointer user_data)
+{
+    struct bluez_uring *ring = ((struct uring_source *)source)->ring;
+    struct io_uring_cqe *cqe;
+    unsigned int head = *ring->cqHead;
+    unsigned int tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+    uint64_t op;
+    int res;
+    unsigned int flags;
+
+    for (;;)
+    {
+        if (head == tail)
+        {
+            if (uring_overflow(ring) == FALSE)
+                break;
+
+            uring_enter(ring->fd, 0, 0, IORING_ENTER_GETEVENTS);
+            ring->stats.enters++;
+            tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+            if (head == tail)
+                break;
+        }
+
+        cqe = &ring->cqes[head & ring->cqMask];
+        op = cqe->user_data;
+        res = cqe->res;
+        flags = cqe->flags;
+
+        // Free the entry before the callback, which may queue requests.
+        __atomic_store_n(ring->cqHead, ++head, __ATOMIC_RELEASE);
+        ring->stats.completions++;
+
+        if (op != 0)
+            op_complete(ring, (struct uring_op *)(uintptr_t)op, res, flags);
+
+        if (head == tail)
+            tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+    }
+
+    return TRUE;
+}
+
+static GSourceFuncs uring_source_funcs = {
+    .prepare = uring_source_prepare,
+    .check = uring_source_check,
+    .dispatch = uring_source_dispatch
+};
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Setup.
+
+static gboolean uring_map(struct bluez_uring *ring, const struct io_uring_params *p)
+{
+    size_t sqSize = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+    size_t cqSize = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    uint8_t *map;
+
+    if ((p->features & IORING_FEAT_SINGLE_MMAP) == 0)
+    {
+        fprintf(stderr, "io_uring: kernel too old\n");
+        return FALSE;
+    }
+
+    ring->ringMapSize = MAX(sqSize, cqSize);
+    map = mmap(NULL, ring->ringMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+               ring->fd, IORING_OFF_SQ_RING);
+    if (map == MAP_FAILED)
+        return FALSE;
+    ring->ringMap = map;
+
+    ring->sqesSize = p->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        ring->sqes = NULL;
+        return FALSE;
+    }
+
+    ring->sqHead = (unsigned int *)(map + p->sq_off.head);
+    ring->sqTail = (unsigned int *)(map + p->sq_off.tail);
+    ring->sqMask = *(unsigned int *)(map + p->sq_off.ring_mask);
+    ring->sqArray = (unsigned int *)(map + p->sq_off.array);
+    ring->sqFlags = (unsigned int *)(map + p->sq_off.flags);
+    ring->tail = *ring->sqTail;
+
+    ring->cqHead = (unsigned int *)(map + p->cq_off.head);
+    ring->cqTail = (unsigned int *)(map + p->cq_off.tail);
+    ring->cqMask = *(unsigned int *)(map + p->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(map + p->cq_off.cqes);
+
+    return TRUE;
+}
+
+static gboolean uring_buffers(struct bluez_uring *ring)
+{
+    struct io_uring_buf_reg reg;
+    unsigned int i;
+
+    ring->bufRing = mmap(NULL, URING_BUFFERS * sizeof(struct io_uring_buf),
+                         PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->bufRing == MAP_FAILED)
+    {
+        ring->bufRing = NULL;
+        return FALSE;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uintptr_t)ring->bufRing;
+    reg.ring_entries = URING_BUFFERS;
+    reg.bgid = URING_BGID;
+
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        fprintf(stderr, "io_uring: no provided buffer rings: %s\n", strerror(errno));
+        return FALSE;
+    }
+
+    ring->buffers = g_malloc(URING_BUFFERS * URING_BUFFER_SIZE);
+    for (i = 0; i < URING_BUFFERS; i++)
+        buffer_put(ring, i);
+
+    return TRUE;
+}
+
+// Creates a ring whose completions are handled on 'context'.  Returns NULL
+// if the kernel does not support everything needed.
+struct bluez_uring *uring_new(GMainContext *context)
+{
+    struct bluez_uring *ring;
+    struct io_uring_params p;
+
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = URING_ENTRIES * 4;
+
+    ring = g_new0(struct bluez_uring, 1);
+    ring->fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if (ring->fd < 0)
+    {
+        fprintf(stderr, "io_uring unavailable: %s\n", strerror(errno));
+        g_free(ring);
+        return NULL;
+    }
+
+    if (uring_map(ring, &p) == FALSE || uring_buffers(ring) == FALSE)
+    {
+        uring_free(ring);
+        return NULL;
+    }
+
+    ring->source = g_source_new(&uring_source_funcs, sizeof(struct uring_source));
+    ((struct uring_source *)ring->source)->ring = ring;
+    g_source_add_unix_fd(ring->source, ring->fd, G_IO_IN);
+    g_source_attach(ring->source, context);
+
+    return ring;
+}
+
+// Takes completions without calling back, noting the requests that are
+// finished.  Used only when closing the ring.
+static void uring_reap(struct bluez_uring *ring)
+{
+    struct io_uring_cqe *cqe;
+    struct uring_op *op;
+    unsigned int head = *ring->cqHead;
+
+    while (head != __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE))
+    {
+        cqe = &ring->cqes[head & ring->cqMask];
+        op = (struct uring_op *)(uintptr_t)cqe->user_data;
+        if (op != NULL && (cqe->flags & IORING_CQE_F_MORE) == 0)
+            op->queued = FALSE;
+
+        __atomic_store_n(ring->cqHead, ++head, __ATOMIC_RELEASE);
+    }
+}
+
+static gboolean uring_busy(struct bluez_uring *ring)
+{
+    struct uring_op *op;
+
+    for (op = ring->ops; op != NULL; op = op->next)
+    {
+        if (op->queued)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+// Closes the ring.  Requests still in it are cancelled, and sends not yet
+// queued dropped, without callbacks.
+void uring_free(struct bluez_uring *ring)
+{
+    struct io_uring_sqe *sqe;
+
+    if (ring == NULL)
+        return;
+
+    if (ring->source != NULL)
+    {
+        g_source_destroy(ring->source);
+        g_source_unref(ring->source);
+    }
+
+    // Every request is freed below, so wait for the last completion of
+    // each: until then the kernel may still use it.
+    if (ring->cqes != NULL && uring_busy(ring))
+    {
+        sqe = uring_get_sqe(ring);
+        if (sqe != NULL)
+        {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+        }
+        uring_submit(ring);
+
+        for (;;)
+        {
+            uring_reap(ring);
+            if (uring_busy(ring) == FALSE)
+                break;
+
+            if (uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+            {
+                fprintf(stderr, "io_uring: failed to cancel requests: %s\n", strerror(errno));
+                break;
+            }
+        }
+    }
+
+    while (ring->ops != NULL)
+        op_free(ring, ring->ops);
+
+    if (ring->sqes != NULL)
+        munmap(ring->sqes, ring->sqesSize);
+    if (ring->ringMap != NULL)
+        munmap(ring->ringMap, ring->ringMapSize);
+    if (ring->bufRing != NULL)
+        munmap(ring->bufRing, URING_BUFFERS * sizeof(struct io_uring_buf));
+
+    close(ring->fd);
+    g_free(ring->buffers);
+    g_free(ring);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Interface to the client.
+
+void uring_get_stats(struct bluez_uring *ring, struct bluez_uring_stats *stats)
+{
+    *stats = ring->stats;
+}
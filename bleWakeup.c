@@ -0,0 +1,318 @@
+//
+// bleWakeup.c
+//
+// Created  10/18/2026
+//
+// Timer batching of deliveries, for gateways that run on batteries.
+// Normally each notification wakes the client thread as it arrives and is
+// delivered straight away.  With a latency budget set, the client instead
+// wakes at most once per budget while notifications keep coming:
+//
+//    - The first notification after a quiet spell wakes the thread, which
+//      stops watching the pipe and arms a timerfd for the budget.  Later
+//      notifications queue in the pipe without waking anything.
+//    - When the timer expires, everything waiting in the pipe is read and
+//      delivered in one go, along with any polled values held meanwhile,
+//      and the timer is armed again.
+//    - A timer expiry that finds nothing to deliver goes back to watching
+//      the pipe, so an idle client does not wake at all.
+//
+// So no value waits much longer than the budget, and a steady stream costs
+// one wakeup per budget instead of one per notification.  Sources marked
+// urgent with bluez_set_urgent() bypass the batching and are delivered as
+// they arrive.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleClientPrivate.h"
+#include "bleMetrics.h"
+
+// Largest value held, the maximum length of an attribute value.
+#define WAKEUP_ENTRY_MAX    512
+
+// Polled values held between wakeups.  When full, they are delivered
+// early rather than dropped.
+#define WAKEUP_QUEUE        64
+
+// Most notifications read from the pipe per wakeup.  Anything left over is
+// read on the next.
+#define WAKEUP_READ_MAX     1024
+
+struct wakeup_entry
+{
+    int source;
+    gint64 timestamp;
+    uint16_t len;
+    uint8_t data[WAKEUP_ENTRY_MAX];
+};
+
+struct wakeup_batch
+{
+    bluez_client_t *client;
+    int budget;                 // ms
+    int fd;                     // timerfd
+    GSource *source;
+    gboolean armed;
+    gboolean holding;           // pipe left unwatched until the timer expires
+    gboolean flushing;
+
+    GHashTable *urgent;         // sources delivered without waiting
+
+    struct wakeup_entry queue[WAKEUP_QUEUE];
+    int queued;
+
+    gint64 started;
+    struct bluez_wakeup_stats stats;
+};
+
+static void timer_arm(struct wakeup_batch *w)
+{
+    struct itimerspec spec;
+
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = w->budget / 1000;
+    spec.it_value.tv_nsec = (long)(w->budget % 1000) * 1000000;
+
+    if (timerfd_settime(w->fd, 0, &spec, NULL) < 0)
+        fprintf(stderr, "Unable to arm wakeup timer: %s\n", strerror(errno));
+    else
+        w->armed = TRUE;
+}
+
+static void timer_disarm(struct wakeup_batch *w)
+{
+    struct itimerspec spec;
+
+    memset(&spec, 0, sizeof(spec));
+    timerfd_settime(w->fd, 0, &spec, NULL);
+    w->armed = FALSE;
+}
+
+// Delivers the held polled values.  Returns the number delivered.
+static int queue_flush(struct wakeup_batch *w)
+{
+    struct wakeup_entry *e;
+    int i, n = w->queued;
+
+    w->flushing = TRUE;
+    for (i = 0; i < n; i++)
+    {
+        e = &w->queue[i];
+        bluez_deliver_sample(w->client, e->source, e->timestamp, e->data, e->len);
+    }
+    w->flushing = FALSE;
+
+    w->queued = 0;
+    w->stats.batched += n;
+
+    return n;
+}
+
+static gboolean timer_expired(gint fd, GIOCondition cond, gpointer user_data)
+{
+    struct wakeup_batch *w = user_data;
+    bluez_client_t *client = w->client;
+    uint64_t expirations;
+    gboolean watch = TRUE;
+    int n = 0;
+
+    if (read(fd, &expirations, sizeof(expirations)) < 0 && errno == EAGAIN)
+        return TRUE;
+
+    w->armed = FALSE;
+    w->stats.wakeups++;
+    w->stats.ticks++;
+    bluez_metrics_inc(METRIC_WAKEUPS);
+
+    if (w->holding)
+    {
+        w->holding = FALSE;
+        watch = notify_io_read(client, WAKEUP_READ_MAX, &n);
+        w->stats.batched += n;
+    }
+
+    n += queue_flush(w);
+
+    // Still busy: stay off the pipe and wake again after the budget.  The
+    // pipe stays unwatched too if it failed, or if a full notification
+    // buffer stopped the read, in which case the buffer resumes it.
+    if (n > 0 && watch && client->notify_io.paused)
+    {
+        w->holding = TRUE;
+        timer_arm(w);
+    }
+    else if (watch)
+        notify_io_resume(client);
+
+    return TRUE;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Interface to notification and poll delivery.
+
+// Called when the pipe becomes readable.  Returns TRUE if the caller should
+// stop watching it and leave the notifications for the timer.
+gboolean wakeup_hold(bluez_client_t *client)
+{
+    struct wakeup_batch *w = client->wakeup;
+
+    w->stats.wakeups++;
+
+    if (g_hash_table_contains(w->urgent, GINT_TO_POINTER(BLUEZ_SOURCE_NOTIFY)))
+        return FALSE;
+
+    w->holding = TRUE;
+    if (w->armed == FALSE)
+        timer_arm(w);
+
+    return TRUE;
+}
+
+// Holds a polled value for the next wakeup.  Returns FALSE if it should be
+// delivered now: notifications, which are batched in the pipe instead,
+// urgent sources, and values the timer itself is delivering.
+gboolean wakeup_defer(bluez_client_t *client, int source, gint64 timestamp,
+                      const uint8_t *data, size_t len)
+{
+    struct wakeup_batch *w = client->wakeup;
+    struct wakeup_entry *e;
+
+    if (w->flushing || source == BLUEZ_SOURCE_NOTIFY ||
+        g_hash_table_contains(w->urgent, GINT_TO_POINTER(source)))
+        return FALSE;
+
+    if (w->queued == WAKEUP_QUEUE)
+        queue_flush(w);
+
+    e = &w->queue[w->queued++];
+    e->source = source;
+    e->timestamp = timestamp;
+    e->len = MIN(len, WAKEUP_ENTRY_MAX);
+    memcpy(e->data, data, e->len);
+
+    if (w->armed == FALSE)
+        timer_arm(w);
+
+    return TRUE;
+}
+
+// Frees the batching state.  Anything still held is dropped.
+void wakeup_free(bluez_client_t *client)
+{
+    struct wakeup_batch *w = client->wakeup;
+
+    if (w == NULL)
+        return;
+
+    g_source_destroy(w->source);
+    g_source_unref(w->source);
+    close(w->fd);
+
+    g_hash_table_destroy(w->urgent);
+    g_free(w);
+    client->wakeup = NULL;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Public interface.
+
+// Batches deliveries as described at the top of this file, waking at most
+// once every 'budget' ms while values keep arriving.  Zero turns batching
+// off, delivering anything held first.  Changing the budget keeps the
+// urgent sources.  Returns FALSE if the timer cannot be created.
+//
+// Notifications wait in the AcquireNotify socket between wakeups, so the
+// budget times the notification rate should stay well within what the
+// socket holds.  With a notification buffer, each wakeup moves them all
+// into the buffer.
+gboolean bluez_set_wakeup_budget(bluez_client_t *client, int budget)
+{
+    struct wakeup_batch *w = client->wakeup;
+
+    if (budget < 0)
+        return FALSE;
+
+    if (budget == 0)
+    {
+        if (w != NULL)
+        {
+            queue_flush(w);
+            if (w->holding)
+                notify_io_resume(client);
+            wakeup_free(client);
+        }
+        return TRUE;
+    }
+
+    if (w != NULL)
+    {
+        w->budget = budget;
+        return TRUE;
+    }
+
+    w = g_new0(struct wakeup_batch, 1);
+    w->client = client;
+    w->budget = budget;
+    w->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (w->fd < 0)
+    {
+        fprintf(stderr, "Unable to create wakeup timer: %s\n", strerror(errno));
+        g_free(w);
+        return FALSE;
+    }
+
+    w->urgent = g_hash_table_new(g_direct_hash, g_direct_equal);
+    w->started = g_get_monotonic_time();
+
+    w->source = g_unix_fd_source_new(w->fd, G_IO_IN);
+    g_source_set_callback(w->source, (GSourceFunc) timer_expired, w, NULL);
+    g_source_attach(w->source, client->context);
+
+    client->wakeup = w;
+
+    return TRUE;
+}
+
+// Marks 'source', BLUEZ_SOURCE_NOTIFY or a poll ID, as delivered without
+// waiting for the next wakeup.  Returns FALSE if batching is off.
+gboolean bluez_set_urgent(bluez_client_t *client, int source, gboolean urgent)
+{
+    struct wakeup_batch *w = client->wakeup;
+
+    if (w == NULL)
+        return FALSE;
+
+    if (urgent)
+        g_hash_table_add(w->urgent, GINT_TO_POINTER(source));
+    else
+        g_hash_table_remove(w->urgent, GINT_TO_POINTER(source));
+
+    return TRUE;
+}
+
+// Copies the wakeup counters.  All zero while batching is off.
+void bluez_get_wakeup_stats(bluez_client_t *client, struct bluez_wakeup_stats *stats)
+{
+    struct wakeup_batch *w = client->wakeup;
+    gint64 elapsed;
+
+    memset(stats, 0, sizeof(*stats));
+    if (w == NULL)
+        return;
+
+    *stats = w->stats;
+
+    elapsed = g_get_monotonic_time() - w->started;
+    if (elapsed > 0)
+        stats->perSecond = stats->wakeups * 1e6 / elapsed;
+}
@@ -0,0 +1,304 @@
+//
+// bleWatchdog.c
+//
+// Created  10/18/2026
+//
+// Liveness watchdog for notifications.  A peripheral that stalls without
+// disconnecting cleanly leaves the notification socket open and silent:
+// no hangup, no Connected=false, just no more data.  The watchdog learns
+// the usual gap between notifications and declares a stall when none has
+// arrived for several gaps.  It then escalates one step at a time, giving
+// each step a while to bring notifications back before trying the next:
+//
+//    1. Close the notification socket and AcquireNotify again.
+//    2. Disconnect the device.  The application reconnects as it would
+//       after any disconnect.
+//    3. Power the adapter off and on again.
+//
+// If notifications are still missing after the adapter restart, it starts
+// over at step 1.  The time from the last notification to the stall being
+// detected, and from detection to the next notification, are exported as
+// histograms.
+//
+// The timer is not moved on every notification.  It is armed for the full
+// timeout after the last one seen, and on expiry re-armed for whatever is
+// left if more have come since, so steady traffic costs a timer expiry per
+// timeout rather than a system call per notification.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <dbus/dbus.h>
+
+#include "gdbus/gdbus.h"
+#include "bleClient.h"
+#include "bleClientPrivate.h"
+#include "bleMetrics.h"
+#include "bleTrace.h"
+
+enum {
+    WATCHDOG_IDLE = 0,          // no notifications expected
+    WATCHDOG_WATCHING,
+    WATCHDOG_REACQUIRE,
+    WATCHDOG_RECONNECT,
+    WATCHDOG_RESTART_ADAPTER
+};
+
+struct notify_watchdog
+{
+    bluez_client_t *client;
+    struct bluez_watchdog config;
+    int fd;                     // timerfd
+    GSource *source;
+
+    int step;                   // WATCHDOG_IDLE etc.
+    gint64 last;                // last notification
+    gint64 gap;                 // smoothed gap between notifications, us
+    gint64 stalledAt;
+    gboolean powerCycling;      // adapter powered off, to be powered on
+    NotificationCallback cb;    // for AcquireNotify again
+};
+
+static const char *const step_names[] = {
+    [WATCHDOG_REACQUIRE] = "reacquire",
+    [WATCHDOG_RECONNECT] = "reconnect",
+    [WATCHDOG_RESTART_ADAPTER] = "restart_adapter"
+};
+
+static void timer_arm(struct notify_watchdog *w, gint64 usec)
+{
+    struct itimerspec spec;
+
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = usec / G_USEC_PER_SEC;
+    spec.it_value.tv_nsec = (usec % G_USEC_PER_SEC) * 1000;
+
+    if (timerfd_settime(w->fd, 0, &spec, NULL) < 0)
+        fprintf(stderr, "Unable to arm watchdog timer: %s\n", strerror(errno));
+}
+
+static void timer_disarm(struct notify_watchdog *w)
+{
+    struct itimerspec spec;
+
+    memset(&spec, 0, sizeof(spec));
+    timerfd_settime(w->fd, 0, &spec, NULL);
+}
+
+// Time without a notification after which the peripheral is taken to have
+// stalled.
+static gint64 stall_timeout(struct notify_watchdog *w)
+{
+    gint64 gap = w->config.interval > 0 ? (gint64)w->config.interval * 1000 : w->gap;
+
+    return MAX(gap * w->config.factor, (gint64)w->config.minTimeout * 1000);
+}
+
+static void recover(struct notify_watchdog *w)
+{
+    bluez_client_t *client = w->client;
+    dbus_bool_t power = FALSE;
+
+    BLE_TRACE(TRACE_WARN, "watchdog", step_names[w->step], w->step,
+              (int)((g_get_monotonic_time() - w->stalledAt) / 1000));
+    fprintf(stderr, "Notifications stalled, watchdog step: %s\n", step_names[w->step]);
+
+    bluez_metrics_inc(METRIC_WATCHDOG_STEPS);
+
+    switch (w->step)
+    {
+        case WATCHDOG_REACQUIRE:
+            notify_io_release(client);
+            bluez_acquire_notify(client, w->cb);
+            break;
+
+        case WATCHDOG_RECONNECT:
+            bluez_disconnect(client);
+            break;
+
+        case WATCHDOG_RESTART_ADAPTER:
+            // Powered on again once the daemon reports it off.
+            w->powerCycling = TRUE;
+            if (bluez_set_property(&client->proxy[BLUEZ_PROXY_ADAPTER], "Powered",
+                                   DBUS_TYPE_BOOLEAN, &power) == FALSE)
+            {
+                w->powerCycling = FALSE;
+                fprintf(stderr, "Failed to power adapter off.\n");
+            }
+            break;
+    }
+
+    timer_arm(w, (gint64)w->config.stepTimeout * 1000);
+}
+
+static gboolean timer_expired(gint fd, GIOCondition cond, gpointer user_data)
+{
+    struct notify_watchdog *w = user_data;
+    uint64_t expirations;
+    gint64 now, timeout;
+
+    if (read(fd, &expirations, sizeof(expirations)) < 0 && errno == EAGAIN)
+        return TRUE;
+
+    if (w->step == WATCHDOG_IDLE)
+        return TRUE;
+
+    now = g_get_monotonic_time();
+
+    if (w->step == WATCHDOG_WATCHING)
+    {
+        timeout = stall_timeout(w);
+        if (now - w->last < timeout)
+        {
+            timer_arm(w, w->last + timeout - now);
+            return TRUE;
+        }
+
+        w->stalledAt = now;
+        bluez_metrics_inc(METRIC_NOTIFY_STALLS);
+        bluez_metrics_observe(HISTOGRAM_STALL_DETECT_SECONDS, now - w->last);
+    }
+
+    // Next step, back to the first after restarting the adapter.
+    w->step = w->step == WATCHDOG_RESTART_ADAPTER ? WATCHDOG_REACQUIRE : w->step + 1;
+    recover(w);
+
+    return TRUE;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Interface to notification delivery.
+
+// Called for each notification.  Starts watching on the first, and ends
+// any recovery in progress.
+void watchdog_feed(bluez_client_t *client)
+{
+    struct notify_watchdog *w = client->watchdog;
+    gint64 now = g_get_monotonic_time();
+
+    if (w->step == WATCHDOG_WATCHING)
+    {
+        // Smoothed like RSSI, an eighth of the way towards each new gap.
+        if (w->gap == 0)
+            w->gap = now - w->last;
+        else
+            w->gap += (now - w->last - w->gap) / 8;
+
+        w->last = now;
+        return;
+    }
+
+    if (w->step != WATCHDOG_IDLE)
+    {
+        bluez_metrics_observe(HISTOGRAM_STALL_RECOVERY_SECONDS, now - w->stalledAt);
+        BLE_TRACE(TRACE_INFO, "watchdog", "recovered", w->step,
+                  (int)((now - w->stalledAt) / 1000));
+        fprintf(stderr, "Notifications resumed after watchdog step: %s\n", step_names[w->step]);
+    }
+
+    w->cb = client->notify_io.cb;
+    w->step = WATCHDOG_WATCHING;
+    w->last = now;
+    w->powerCycling = FALSE;
+    timer_arm(w, stall_timeout(w));
+}
+
+// Called when the notification socket is closed at the other end or the
+// device disconnects.  The application is expected to recover from those
+// itself, unless the watchdog brought them about.
+void watchdog_stop(bluez_client_t *client)
+{
+    struct notify_watchdog *w = client->watchdog;
+
+    if (w->step != WATCHDOG_WATCHING)
+        return;
+
+    w->step = WATCHDOG_IDLE;
+    timer_disarm(w);
+}
+
+// Stops watching when the device disconnects, and powers the adapter
+// back on once it is reported off during a restart.
+void watchdog_property(bluez_client_t *client, const char *name,
+                       const struct bluez_property_value *value)
+{
+    struct notify_watchdog *w = client->watchdog;
+    gboolean yes = (value->type == DBUS_TYPE_BOOLEAN && value->value.bool_val);
+
+    if (!strcmp(name, "Connected") && !yes)
+        watchdog_stop(client);
+    else if (w->powerCycling && !strcmp(name, "Powered") && !yes)
+    {
+        w->powerCycling = FALSE;
+        bluez_power_on(client);
+    }
+}
+
+// Frees the watchdog.
+void watchdog_free(bluez_client_t *client)
+{
+    struct notify_watchdog *w = client->watchdog;
+
+    if (w == NULL)
+        return;
+
+    g_source_destroy(w->source);
+    g_source_unref(w->source);
+    close(w->fd);
+
+    g_free(w);
+    client->watchdog = NULL;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Public interface.
+
+// Watches for notifications stopping, as described at the top of this file.
+// Zero fields in 'config' take the defaults: gap learnt from the traffic,
+// a stall after 5 gaps but not under 2 s, and 15 s for each recovery step.
+// NULL turns the watchdog off.  Returns FALSE if the timer cannot be
+// created.
+gboolean bluez_set_watchdog(bluez_client_t *client, const struct bluez_watchdog *config)
+{
+    struct notify_watchdog *w = client->watchdog;
+
+    if (config == NULL)
+    {
+        watchdog_free(client);
+        return TRUE;
+    }
+
+    if (w == NULL)
+    {
+        w = g_new0(struct notify_watchdog, 1);
+        w->client = client;
+        w->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (w->fd < 0)
+        {
+            fprintf(stderr, "Unable to create watchdog timer: %s\n", strerror(errno));
+            g_free(w);
+            return FALSE;
+        }
+
+        w->source = g_unix_fd_source_new(w->fd, G_IO_IN);
+        g_source_set_callback(w->source, (GSourceFunc) timer_expired, w, NULL);
+        g_source_attach(w->source, client->context);
+
+        client->watchdog = w;
+    }
+
+    w->config = *config;
+    if (w->config.factor <= 0)
+        w->config.factor = 5;
+    if (w->config.minTimeout <= 0)
+        w->config.minTimeout = 2000;
+    if (w->config.stepTimeout <= 0)
+        w->config.stepTimeout = 15000;
+
+    return TRUE;
+}